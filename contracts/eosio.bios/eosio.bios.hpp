@@ -43,6 +43,11 @@ namespace eosio {
             require_auth( from );
          }
 
+         void activate( account_name feature ) {
+            require_auth( _self );
+            activate_feature( feature );
+         }
+
       private:
    };
 
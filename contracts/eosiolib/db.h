@@ -223,6 +223,39 @@ int32_t db_upperbound_i64(account_name code, account_name scope, table_name tabl
   */
 int32_t db_end_i64(account_name code, account_name scope, table_name table);
 
+/**
+  *  Header of a record copied by db_scan_i64, immediately followed by the `size` bytes of the row
+  */
+struct db_scan_record {
+   int32_t  iterator;
+   uint32_t size;
+   uint64_t primary;
+};
+
+/**
+  *
+  *  Copy the table rows following the referenced table row in a primary 64-bit integer index table
+  *
+  *  @brief Copy the table rows following the referenced table row in a primary 64-bit integer index table, in a single call
+  *  Contracts importing this intrinsic can only be deployed on chains that activated it.
+  *  @param iterator - The iterator to the referenced table row
+  *  @param data - Pointer to the buffer which will be filled with the records
+  *  @param len - Size of the buffer
+  *  @param max_rows - Maximum number of rows to copy, at most 64 rows are copied whatever the value
+  *  @return number of records copied into the buffer, including the terminating record if the end of the table was reached
+  *  @pre `iterator` points to an existing table row in the table
+  *  @post `data` holds, without padding, a `db_scan_record` followed by the row for each row copied. The rows are those db_next_i64 and db_get_i64 would return one after another, with the same iterators.
+  *  @post Copying stops after `max_rows` rows or before the first row that does not fit in the buffer. When the end of the table is reached and the buffer has room for it, a record with the end iterator of the table and a zero size terminates the rows.
+  *
+  *  Example:
+  *
+  *  @code
+  *  char buffer[512];
+  *  int32_t records = db_scan_i64(itr, buffer, sizeof(buffer), 16);
+  *  @endcode
+  */
+int32_t db_scan_i64(int32_t iterator, void* data, uint32_t len, uint32_t max_rows);
+
 /**
   *
   *  Store an association of a 64-bit integer secondary key to a primary key in a secondary 64-bit integer index table
@@ -231,6 +231,7 @@ class multi_index
       }
 
       constexpr static size_t max_stack_buffer_size = 512;
+      constexpr static uint32_t max_scan_rows = 16;
 
       static_assert( validate_table_name(TableName), "multi_index does not support table names with a length greater than 12");
 
@@ -548,14 +549,18 @@ class multi_index
 
       indices_type _indices;
 
-      const item& load_object_by_primary_iterator( int32_t itr )const {
-         using namespace _multi_index_detail;
-
+      const item* find_cached_object( int32_t itr )const {
          auto itr2 = std::find_if(_items_vector.rbegin(), _items_vector.rend(), [&](const item_ptr& ptr) {
             return ptr._primary_itr == itr;
          });
          if( itr2 != _items_vector.rend() )
-            return *itr2->_item;
+            return itr2->_item.get();
+         return nullptr;
+      }
+
+      const item& load_object_by_primary_iterator( int32_t itr )const {
+         if( auto cached = find_cached_object( itr ) )
+            return *cached;
 
          auto size = db_get_i64( itr, nullptr, 0 );
          eosio_assert( size >= 0, "error reading iterator" );
@@ -565,12 +570,49 @@ class multi_index
 
          db_get_i64( itr, buffer, uint32_t(size) );
 
-         datastream<const char*> ds( (char*)buffer, uint32_t(size) );
+         const item& obj = cache_object( itr, (const char*)buffer, size_t(size) );
 
          if ( max_stack_buffer_size < size_t(size) ) {
             free(buffer);
          }
 
+         return obj;
+      } /// load_object_by_primary_iterator
+
+#ifdef EOSIO_MULTI_INDEX_DB_SCAN
+      /**
+       * Loads the object following the one at itr, which is at next_itr, together with the uncached objects after it
+       * that db_scan_i64 fits in a stack buffer, so that iterating through the table reads them in a single call.
+       * Only contracts defining EOSIO_MULTI_INDEX_DB_SCAN use it, since db_scan_i64 can only be deployed on chains
+       * that activated it
+       */
+      const item& load_objects_after( int32_t itr, int32_t next_itr )const {
+         if( auto cached = find_cached_object( next_itr ) )
+            return *cached;
+
+         char buffer[max_stack_buffer_size];
+         auto records = db_scan_i64( itr, buffer, sizeof(buffer), max_scan_rows );
+
+         const char* pos = buffer;
+         for( int32_t r = 0; r < records; ++r ) {
+            db_scan_record rec;
+            memcpy( &rec, pos, sizeof(rec) );
+            pos += sizeof(rec);
+            if( rec.iterator >= 0 && find_cached_object( rec.iterator ) == nullptr )
+               cache_object( rec.iterator, pos, rec.size );
+            pos += rec.size;
+         }
+
+         // falls back to reading the object alone when it does not fit in the buffer
+         return load_object_by_primary_iterator( next_itr );
+      }
+#endif
+
+      const item& cache_object( int32_t itr, const char* data, size_t size )const {
+         using namespace _multi_index_detail;
+
+         datastream<const char*> ds( data, size );
+
          auto itm = std::make_unique<item>( this, [&]( auto& i ) {
             T& val = static_cast<T&>(i);
             ds >> val;
@@ -590,7 +632,7 @@ class multi_index
          _items_vector.emplace_back( std::move(itm), pk, pitr );
 
          return *ptr;
-      } /// load_object_by_primary_iterator
+      } /// cache_object
 
    public:
       /**
@@ -748,7 +790,11 @@ class multi_index
             if( next_itr < 0 )
                _item = nullptr;
             else
+#ifdef EOSIO_MULTI_INDEX_DB_SCAN
+               _item = &_multidx->load_objects_after( _item->__primary_itr, next_itr );
+#else
                _item = &_multidx->load_object_by_primary_iterator( next_itr );
+#endif
             return *this;
          }
          const_iterator& operator--() {
@@ -80,6 +80,7 @@ struct test_db {
    static void primary_i64_general(uint64_t receiver, uint64_t code, uint64_t action);
    static void primary_i64_lowerbound(uint64_t receiver, uint64_t code, uint64_t action);
    static void primary_i64_upperbound(uint64_t receiver, uint64_t code, uint64_t action);
+   static void primary_i64_scan(uint64_t receiver, uint64_t code, uint64_t action);
 
    static void idx64_general(uint64_t receiver, uint64_t code, uint64_t action);
    static void idx64_lowerbound(uint64_t receiver, uint64_t code, uint64_t action);
@@ -13,6 +13,7 @@ extern "C" {
       WASM_TEST_HANDLER_EX(test_db, primary_i64_general);
       WASM_TEST_HANDLER_EX(test_db, primary_i64_lowerbound);
       WASM_TEST_HANDLER_EX(test_db, primary_i64_upperbound);
+      WASM_TEST_HANDLER_EX(test_db, primary_i64_scan);
       WASM_TEST_HANDLER_EX(test_db, idx64_general);
       WASM_TEST_HANDLER_EX(test_db, idx64_lowerbound);
       WASM_TEST_HANDLER_EX(test_db, idx64_upperbound);
@@ -242,6 +242,60 @@ void test_db::primary_i64_upperbound(uint64_t receiver, uint64_t code, uint64_t
    }
 }
 
+void test_db::primary_i64_scan(uint64_t receiver, uint64_t code, uint64_t action)
+{
+   (void)code;(void)action;
+   auto table = N(mytable);
+   const std::string err = "primary_i64_scan";
+
+   char buffer[512];
+   db_scan_record rec;
+
+   // the rows stored by primary_i64_lowerbound after alice: allyson, bob, charlie, emily and joe
+   {
+      int itr = db_find_i64(receiver, receiver, table, N(alice));
+      int records = db_scan_i64(itr, buffer, sizeof(buffer), 16);
+      eosio_assert(records == 6, err.c_str());
+
+      const char* pos = buffer;
+      for (int r = 0; r < 5; ++r) {
+         uint64_t next_pk;
+         itr = db_next_i64(itr, &next_pk);
+         memcpy(&rec, pos, sizeof(rec));
+         pos += sizeof(rec);
+         eosio_assert(rec.iterator == itr && rec.primary == next_pk, err.c_str());
+
+         char value[32];
+         int size = db_get_i64(itr, value, sizeof(value));
+         eosio_assert(rec.size == uint32_t(size) && memcmp(pos, value, rec.size) == 0, err.c_str());
+         pos += rec.size;
+      }
+
+      memcpy(&rec, pos, sizeof(rec));
+      eosio_assert(rec.iterator == db_end_i64(receiver, receiver, table) && rec.size == 0, err.c_str());
+   }
+   {
+      int itr = db_find_i64(receiver, receiver, table, N(alice));
+      int records = db_scan_i64(itr, buffer, sizeof(buffer), 2);
+      eosio_assert(records == 2, err.c_str());
+      memcpy(&rec, buffer + sizeof(rec) + strlen("allyson's info"), sizeof(rec));
+      eosio_assert(rec.iterator == db_find_i64(receiver, receiver, table, N(bob)), err.c_str());
+   }
+   {
+      int itr = db_find_i64(receiver, receiver, table, N(alice));
+      int records = db_scan_i64(itr, buffer, sizeof(rec) + 1, 16);
+      eosio_assert(records == 0, err.c_str());
+   }
+   {
+      int itr = db_find_i64(receiver, receiver, table, N(joe));
+      int records = db_scan_i64(itr, buffer, sizeof(buffer), 16);
+      eosio_assert(records == 1, err.c_str());
+      memcpy(&rec, buffer, sizeof(rec));
+      eosio_assert(rec.iterator == db_end_i64(receiver, receiver, table) && rec.size == 0, err.c_str());
+      eosio_assert(db_scan_i64(rec.iterator, buffer, sizeof(buffer), 16) == -1, err.c_str());
+   }
+}
+
 void test_db::idx64_general(uint64_t receiver, uint64_t code, uint64_t action)
 {
    (void)code;(void)action;
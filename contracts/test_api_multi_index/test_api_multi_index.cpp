@@ -2,6 +2,8 @@
  *  @file
  *  @copyright defined in eos/LICENSE
  */
+// iterate through db_scan_i64, the test chains activate it from genesis
+#define EOSIO_MULTI_INDEX_DB_SCAN
 #include <eosiolib/eosio.hpp>
 #include "../test_api/test_api.hpp"
 
@@ -0,0 +1,134 @@
+/**
+ *  @file
+ *  @copyright defined in eos/LICENSE
+ */
+#include <eosio/chain/access_set.hpp>
+
+#include <algorithm>
+
+namespace eosio { namespace chain {
+
+   static bool index_less( const table_key_range& a, const table_key_range& b ) {
+      return std::tie( a.code, a.scope, a.table, a.index ) < std::tie( b.code, b.scope, b.table, b.index );
+   }
+
+   /// Both vectors are normalized
+   static bool any_overlap( const vector<table_key_range>& a, const vector<table_key_range>& b ) {
+      auto i = a.begin(), j = b.begin();
+      while( i != a.end() && j != b.end() ) {
+         if( index_less( *i, *j ) )        ++i;
+         else if( index_less( *j, *i ) )   ++j;
+         else if( i->upper < j->lower )    ++i;
+         else if( j->upper < i->lower )    ++j;
+         else                              return true;
+      }
+      return false;
+   }
+
+   void access_set::add( vector<table_key_range>& ranges, const table_key_range& r ) {
+      if( !ranges.empty() ) {
+         auto& last = ranges.back();
+         if( last.same_index( r ) && (last.upper == table_key_range::max_key || r.lower <= last.upper + 1)
+                                  && (r.upper == table_key_range::max_key || last.lower <= r.upper + 1) ) {
+            last.lower = std::min( last.lower, r.lower );
+            last.upper = std::max( last.upper, r.upper );
+            return;
+         }
+      }
+      ranges.push_back( r );
+   }
+
+   void access_set::normalize() {
+      for( auto* ranges : { &reads, &writes } ) {
+         std::sort( ranges->begin(), ranges->end() );
+         vector<table_key_range> merged;
+         merged.reserve( ranges->size() );
+         for( const auto& r : *ranges )
+            add( merged, r );
+         *ranges = std::move( merged );
+      }
+   }
+
+   bool access_set::conflicts_with( const access_set& other )const {
+      if( any_overlap( writes, other.writes ) || any_overlap( writes, other.reads ) || any_overlap( reads, other.writes ) )
+         return true;
+      for( const auto& a : resource_accounts ) {
+         if( other.resource_accounts.count( a ) )
+            return true;
+      }
+      return false;
+   }
+
+   conflict_graph conflict_graph::build( uint32_t block_num, vector<access_set>& sets ) {
+      conflict_graph g;
+      g.block_num = block_num;
+      g.transactions = sets.size();
+
+      struct access {
+         const table_key_range* range;
+         uint32_t               trx;
+         bool                   write;
+      };
+
+      vector<access> accesses;
+      flat_map<account_name, vector<uint32_t>> resource_users;
+      for( uint32_t t = 0; t < sets.size(); ++t ) {
+         auto& s = sets[t];
+         s.normalize();
+         for( const auto& r : s.reads )
+            accesses.push_back( access{ &r, t, false } );
+         for( const auto& r : s.writes )
+            accesses.push_back( access{ &r, t, true } );
+         for( const auto& a : s.resource_accounts )
+            resource_users[a].push_back( t );
+      }
+
+      std::sort( accesses.begin(), accesses.end(), []( const access& a, const access& b ) {
+         if( index_less( *a.range, *b.range ) ) return true;
+         if( index_less( *b.range, *a.range ) ) return false;
+         return a.range->lower < b.range->lower;
+      } );
+
+      // sweeps each index in key order, comparing every range with the earlier ones still covering its lower key
+      vector<std::pair<uint32_t,uint32_t>> data_edges;
+      vector<access> active;
+      for( const auto& a : accesses ) {
+         if( !active.empty() && !active.front().range->same_index( *a.range ) )
+            active.clear();
+         active.erase( std::remove_if( active.begin(), active.end(), [&]( const access& o ) {
+            return o.range->upper < a.range->lower;
+         } ), active.end() );
+         for( const auto& o : active ) {
+            if( o.trx != a.trx && (o.write || a.write) )
+               data_edges.emplace_back( std::min( o.trx, a.trx ), std::max( o.trx, a.trx ) );
+         }
+         active.push_back( a );
+      }
+      std::sort( data_edges.begin(), data_edges.end() );
+      data_edges.erase( std::unique( data_edges.begin(), data_edges.end() ), data_edges.end() );
+
+      vector<std::pair<uint32_t,uint32_t>> resource_edges;
+      for( const auto& u : resource_users ) {
+         for( size_t i = 0; i < u.second.size(); ++i ) {
+            for( size_t j = i + 1; j < u.second.size(); ++j )
+               resource_edges.emplace_back( u.second[i], u.second[j] );
+         }
+      }
+      std::sort( resource_edges.begin(), resource_edges.end() );
+      resource_edges.erase( std::unique( resource_edges.begin(), resource_edges.end() ), resource_edges.end() );
+
+      std::set_union( data_edges.begin(), data_edges.end(), resource_edges.begin(), resource_edges.end(),
+                      std::back_inserter( g.edges ) );
+      g.resource_edges = g.edges.size() - data_edges.size();
+
+      // edges are ordered by their first transaction, which precedes the second, so depths are final when used
+      vector<uint32_t> depth( sets.size(), 1 );
+      for( const auto& e : g.edges )
+         depth[e.second] = std::max( depth[e.second], depth[e.first] + 1 );
+      for( auto d : depth )
+         g.critical_path = std::max( g.critical_path, d );
+
+      return g;
+   }
+
+} } // eosio::chain
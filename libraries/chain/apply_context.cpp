@@ -4,6 +4,7 @@
 #include <eosio/chain/transaction_context.hpp>
 #include <eosio/chain/exceptions.hpp>
 #include <eosio/chain/wasm_interface.hpp>
+#include <eosio/chain/native_token_contract.hpp>
 #include <eosio/chain/generated_transaction_object.hpp>
 #include <eosio/chain/authorization_manager.hpp>
 #include <eosio/chain/resource_limits.hpp>
@@ -29,10 +30,58 @@ static inline void print_debug(account_name receiver, const action_trace& ar) {
    }
 }
 
+void apply_context::iterator_caches::clear() {
+   keyval.clear();
+   idx64.clear();
+   idx128.clear();
+   idx256.clear();
+   idx_double.clear();
+   idx_long_double.clear();
+}
+
+/// caches of completed actions, kept for the next actions of the thread, one set per level of inline action nesting
+static thread_local vector<std::unique_ptr<apply_context::iterator_caches>> free_iterator_caches;
+static constexpr size_t max_free_iterator_caches = 8;
+
+std::unique_ptr<apply_context::iterator_caches> apply_context::acquire_iterator_caches() {
+   if( free_iterator_caches.empty() )
+      return std::make_unique<iterator_caches>();
+   auto caches = std::move( free_iterator_caches.back() );
+   free_iterator_caches.pop_back();
+   return caches;
+}
+
+void apply_context::release_iterator_caches( std::unique_ptr<iterator_caches> caches ) {
+   if( !caches || free_iterator_caches.size() >= max_free_iterator_caches )
+      return;
+   try {
+      caches->clear();
+      free_iterator_caches.push_back( std::move( caches ) );
+   } catch( ... ) {
+      // called from the destructor, the caches are simply dropped
+   }
+}
+
 void apply_context::exec_one( action_trace& trace )
 {
    auto start = fc::time_point::now();
 
+   execution_profiler* profiler = control.get_execution_profiler();
+   action_profile sample;
+   profile = profiler ? &sample : nullptr;
+   accesses = trx_context.accesses.get();
+   auto record_profile = [&]( bool failed ) {
+      if( !profiler ) return;
+      profile = nullptr;
+      sample.calls = 1;
+      sample.failures = failed ? 1 : 0;
+      sample.wall_time = trace.elapsed;
+      sample.billed_cpu = trace.elapsed - sample.compile_time;
+      for( const auto& d : trace.account_ram_deltas )
+         sample.ram_delta += d.delta;
+      profiler->record( receiver, act.name, sample );
+   };
+
    action_receipt r;
    r.receiver         = receiver;
    r.act_digest       = digest_type::hash(act);
@@ -66,7 +115,8 @@ void apply_context::exec_one( action_trace& trace )
                control.check_action_list( act.account, act.name );
             }
             try {
-               control.get_wasm_interface().apply( a.code_version, a.code, *this );
+               if( !control.is_native_token_code( a.code_version ) || !apply_native_token_transfer( *this ) )
+                  control.get_wasm_interface().apply( a.code_version, a.code, *this );
             } catch( const wasm_exit& ) {}
          }
       } FC_RETHROW_EXCEPTIONS( warn, "pending console output: ${console}", ("console", _pending_console_output.str()) )
@@ -74,6 +124,7 @@ void apply_context::exec_one( action_trace& trace )
       trace.receipt = r; // fill with known data
       trace.except = e;
       finalize_trace( trace, start );
+      record_profile( true );
       throw;
    }
 
@@ -93,6 +144,7 @@ void apply_context::exec_one( action_trace& trace )
    trx_context.executed.emplace_back( move(r) );
 
    finalize_trace( trace, start );
+   record_profile( false );
 
    if ( control.contracts_console() ) {
       print_debug(receiver, trace);
@@ -410,15 +462,18 @@ bool apply_context::cancel_deferred_transaction( const uint128_t& sender_id, acc
 }
 
 const table_id_object* apply_context::find_table( name code, name scope, name table ) {
+   if( accesses ) accesses->read( code, scope, table, table_key_range::table_index, 0, 0 );
    return db.find<table_id_object, by_code_scope_table>(boost::make_tuple(code, scope, table));
 }
 
 const table_id_object& apply_context::find_or_create_table( name code, name scope, name table, const account_name &payer ) {
    const auto* existing_tid =  db.find<table_id_object, by_code_scope_table>(boost::make_tuple(code, scope, table));
    if (existing_tid != nullptr) {
+      if( accesses ) accesses->read( code, scope, table, table_key_range::table_index, 0, 0 );
       return *existing_tid;
    }
 
+   if( accesses ) accesses->write( code, scope, table, table_key_range::table_index, 0, 0 );
    update_db_usage(payer, config::billable_size_v<table_id_object>);
 
    return db.create<table_id_object>([&](table_id_object &t_id){
@@ -430,6 +485,7 @@ const table_id_object& apply_context::find_or_create_table( name code, name scop
 }
 
 void apply_context::remove_table( const table_id_object& tid ) {
+   record_write( tid, table_key_range::table_index, 0, 0 );
    update_db_usage(tid.payer, - config::billable_size_v<table_id_object>);
    db.remove(tid);
 }
@@ -515,6 +571,7 @@ int apply_context::db_store_i64( uint64_t code, uint64_t scope, uint64_t table,
 //   require_write_lock( scope );
    const auto& tab = find_or_create_table( code, scope, table, payer );
    auto tableid = tab.id;
+   record_write( tab, table_key_range::primary_index, id, id );
 
    EOS_ASSERT( payer != account_name(), invalid_table_payer, "must specify a valid account to pay for new record" );
 
@@ -541,6 +598,7 @@ void apply_context::db_update_i64( int iterator, account_name payer, const char*
 
    const auto& table_obj = keyval_cache.get_table( obj.t_id );
    EOS_ASSERT( table_obj.code == receiver, table_access_violation, "db access violation" );
+   record_write( table_obj, table_key_range::primary_index, obj.primary_key, obj.primary_key );
 
 //   require_write_lock( table_obj.scope );
 
@@ -571,6 +629,7 @@ void apply_context::db_remove_i64( int iterator ) {
 
    const auto& table_obj = keyval_cache.get_table( obj.t_id );
    EOS_ASSERT( table_obj.code == receiver, table_access_violation, "db access violation" );
+   record_write( table_obj, table_key_range::primary_index, obj.primary_key, obj.primary_key );
 
 //   require_write_lock( table_obj.scope );
 
@@ -609,8 +668,14 @@ int apply_context::db_next_i64( int iterator, uint64_t& primary ) {
    auto itr = idx.iterator_to( obj );
    ++itr;
 
-   if( itr == idx.end() || itr->t_id != obj.t_id ) return keyval_cache.get_end_iterator_by_table_id(obj.t_id);
+   if( itr == idx.end() || itr->t_id != obj.t_id ) {
+      if( accesses )
+         record_read( keyval_cache.get_table( obj.t_id ), table_key_range::primary_index, obj.primary_key, table_key_range::max_key );
+      return keyval_cache.get_end_iterator_by_table_id(obj.t_id);
+   }
 
+   if( accesses )
+      record_read( keyval_cache.get_table( obj.t_id ), table_key_range::primary_index, obj.primary_key, itr->primary_key );
    primary = itr->primary_key;
    return keyval_cache.add( *itr );
 }
@@ -624,12 +689,12 @@ int apply_context::db_previous_i64( int iterator, uint64_t& primary ) {
       EOS_ASSERT( tab, invalid_table_iterator, "not a valid end iterator" );
 
       auto itr = idx.upper_bound(tab->id);
-      if( idx.begin() == idx.end() || itr == idx.begin() ) return -1; // Empty table
-
-      --itr;
-
-      if( itr->t_id != tab->id ) return -1; // Empty table
+      if( idx.begin() == idx.end() || itr == idx.begin() || (--itr)->t_id != tab->id ) {
+         record_read( *tab, table_key_range::primary_index, 0, table_key_range::max_key );
+         return -1; // Empty table
+      }
 
+      record_read( *tab, table_key_range::primary_index, itr->primary_key, table_key_range::max_key );
       primary = itr->primary_key;
       return keyval_cache.add(*itr);
    }
@@ -637,12 +702,14 @@ int apply_context::db_previous_i64( int iterator, uint64_t& primary ) {
    const auto& obj = keyval_cache.get(iterator); // Check for iterator != -1 happens in this call
 
    auto itr = idx.iterator_to(obj);
-   if( itr == idx.begin() ) return -1; // cannot decrement past beginning iterator of table
-
-   --itr;
-
-   if( itr->t_id != obj.t_id ) return -1; // cannot decrement past beginning iterator of table
+   if( itr == idx.begin() || (--itr)->t_id != obj.t_id ) {
+      if( accesses )
+         record_read( keyval_cache.get_table( obj.t_id ), table_key_range::primary_index, 0, obj.primary_key );
+      return -1; // cannot decrement past beginning iterator of table
+   }
 
+   if( accesses )
+      record_read( keyval_cache.get_table( obj.t_id ), table_key_range::primary_index, itr->primary_key, obj.primary_key );
    primary = itr->primary_key;
    return keyval_cache.add(*itr);
 }
@@ -654,6 +721,7 @@ int apply_context::db_find_i64( uint64_t code, uint64_t scope, uint64_t table, u
    if( !tab ) return -1;
 
    auto table_end_itr = keyval_cache.cache_table( *tab );
+   record_read( *tab, table_key_range::primary_index, id, id );
 
    const key_value_object* obj = db.find<key_value_object, by_scope_primary>( boost::make_tuple( tab->id, id ) );
    if( !obj ) return table_end_itr;
@@ -671,9 +739,12 @@ int apply_context::db_lowerbound_i64( uint64_t code, uint64_t scope, uint64_t ta
 
    const auto& idx = db.get_index<key_value_index, by_scope_primary>();
    auto itr = idx.lower_bound( boost::make_tuple( tab->id, id ) );
-   if( itr == idx.end() ) return table_end_itr;
-   if( itr->t_id != tab->id ) return table_end_itr;
+   if( itr == idx.end() || itr->t_id != tab->id ) {
+      record_read( *tab, table_key_range::primary_index, id, table_key_range::max_key );
+      return table_end_itr;
+   }
 
+   record_read( *tab, table_key_range::primary_index, id, itr->primary_key );
    return keyval_cache.add( *itr );
 }
 
@@ -687,9 +758,12 @@ int apply_context::db_upperbound_i64( uint64_t code, uint64_t scope, uint64_t ta
 
    const auto& idx = db.get_index<key_value_index, by_scope_primary>();
    auto itr = idx.upper_bound( boost::make_tuple( tab->id, id ) );
-   if( itr == idx.end() ) return table_end_itr;
-   if( itr->t_id != tab->id ) return table_end_itr;
+   if( itr == idx.end() || itr->t_id != tab->id ) {
+      record_read( *tab, table_key_range::primary_index, id, table_key_range::max_key );
+      return table_end_itr;
+   }
 
+   record_read( *tab, table_key_range::primary_index, id, itr->primary_key );
    return keyval_cache.add( *itr );
 }
 
@@ -702,6 +776,54 @@ int apply_context::db_end_i64( uint64_t code, uint64_t scope, uint64_t table ) {
    return keyval_cache.cache_table( *tab );
 }
 
+int apply_context::db_scan_i64( int iterator, char* buffer, size_t buffer_size, uint32_t max_rows ) {
+   if( iterator < -1 ) return -1; // cannot scan past end iterator of table
+
+   const auto& obj = keyval_cache.get( iterator ); // Check for iterator != -1 happens in this call
+   const auto& idx = db.get_index<key_value_index, by_scope_primary>();
+
+   constexpr size_t header_size = sizeof(int32_t) + sizeof(uint32_t) + sizeof(uint64_t);
+   auto write_header = [&]( size_t pos, int32_t itr, uint32_t size, uint64_t primary ) {
+      memcpy( buffer + pos, &itr, sizeof(itr) );
+      memcpy( buffer + pos + sizeof(itr), &size, sizeof(size) );
+      memcpy( buffer + pos + sizeof(itr) + sizeof(size), &primary, sizeof(primary) );
+   };
+
+   // every copied row takes an iterator, so bound the rows a single call can walk whatever the buffer size
+   max_rows = std::min( max_rows, config::max_db_scan_rows );
+
+   auto itr = idx.iterator_to( obj );
+   uint64_t last_primary = obj.primary_key;
+   size_t used = 0;
+   int records = 0;
+   for( ++itr; records < int(max_rows); ++itr ) {
+      trx_context.checktime();
+      if( itr == idx.end() || itr->t_id != obj.t_id ) {
+         if( accesses )
+            record_read( keyval_cache.get_table( obj.t_id ), table_key_range::primary_index, obj.primary_key, table_key_range::max_key );
+         if( used + header_size <= buffer_size ) {
+            write_header( used, keyval_cache.get_end_iterator_by_table_id( obj.t_id ), 0, 0 );
+            ++records;
+         }
+         return records;
+      }
+
+      last_primary = itr->primary_key; // the size of a row that does not fit is observed as well
+      const auto size = itr->value.size();
+      if( used + header_size + size > buffer_size )
+         break;
+
+      write_header( used, keyval_cache.add( *itr ), uint32_t(size), itr->primary_key );
+      memcpy( buffer + used + header_size, itr->value.data(), size );
+      used += header_size + size;
+      ++records;
+   }
+
+   if( accesses )
+      record_read( keyval_cache.get_table( obj.t_id ), table_key_range::primary_index, obj.primary_key, last_primary );
+   return records;
+}
+
 uint64_t apply_context::next_global_sequence() {
    const auto& p = control.get_dynamic_global_properties();
    db.modify( p, [&]( auto& dgp ) {
@@ -7,6 +7,28 @@
 #include <fstream>
 #include <fc/io/raw.hpp>
 
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+#include <boost/iostreams/device/back_inserter.hpp>
+#include <boost/iostreams/filter/zlib.hpp>
+#include <boost/iostreams/filtering_stream.hpp>
+#include <boost/multi_index_container.hpp>
+#include <boost/multi_index/hashed_index.hpp>
+#include <boost/multi_index/member.hpp>
+#include <boost/multi_index/sequenced_index.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <future>
+#include <mutex>
+#include <thread>
+
+#include <fcntl.h>
+#include <unistd.h>
+
 #define LOG_READ  (std::ios::in | std::ios::binary)
 #define LOG_WRITE (std::ios::out | std::ios::binary | std::ios::app)
 
@@ -19,10 +41,411 @@ namespace eosio { namespace chain {
     * Version 1: complete block log from genesis
     * Version 2: adds optional partial block log, cannot be used for replay without snapshot
     *            this is in the form of an first_block_num that is written immediately after the version
+    * Version 3: adds optional compression of the blocks, a block_log_compression byte after first_block_num
     */
-   const uint32_t block_log::max_supported_version = 2;
+   const uint32_t block_log::max_supported_version = 3;
 
    namespace detail {
+      namespace bip = boost::interprocess;
+      namespace bio = boost::iostreams;
+
+      struct log_header {
+         uint32_t               version = 0;
+         uint32_t               first_block_num = 1;
+         block_log_compression  compression = block_log_compression::none;
+         genesis_state          genesis;
+      };
+
+      /// parses a block number made of decimal digits only, false if it is empty, has other characters or overflows
+      bool parse_block_num( const std::string& s, uint32_t& num ) {
+         if( s.empty() || s.size() > std::numeric_limits<uint32_t>::digits10 + 1 )
+            return false;
+         uint64_t n = 0;
+         for( char c : s ) {
+            if( c < '0' || c > '9' )
+               return false;
+            n = n * 10 + (c - '0');
+         }
+         if( n > std::numeric_limits<uint32_t>::max() )
+            return false;
+         num = static_cast<uint32_t>( n );
+         return true;
+      }
+
+      /// version of the files started with a compression, uncompressed logs stay readable by older nodes
+      uint32_t log_version( block_log_compression compression ) {
+         return compression == block_log_compression::none ? 2 : 3;
+      }
+
+      /// packs the header up to the genesis state, the totem that follows it is written by the caller
+      vector<char> pack_header( const log_header& h ) {
+         auto data = fc::raw::pack( h.version );
+         auto append = [&]( const vector<char>& v ) { data.insert( data.end(), v.begin(), v.end() ); };
+         append( fc::raw::pack( h.first_block_num ) );
+         if( h.version > 2 )
+            append( fc::raw::pack( static_cast<uint8_t>(h.compression) ) );
+         append( fc::raw::pack( h.genesis ) );
+         return data;
+      }
+
+      /// unpacks the header up to the genesis state, the stream is left at the totem of version 2 and later logs
+      template<typename Stream>
+      log_header unpack_header( Stream& ds ) {
+         log_header h;
+         fc::raw::unpack( ds, h.version );
+         EOS_ASSERT( h.version > 0, block_log_exception, "Block log was not setup properly" );
+         EOS_ASSERT( h.version >= block_log::min_supported_version && h.version <= block_log::max_supported_version, block_log_unsupported_version,
+                    "Unsupported version of block log. Block log version is ${version} while code supports version(s) [${min},${max}]",
+                    ("version", h.version)("min", block_log::min_supported_version)("max", block_log::max_supported_version) );
+         if( h.version != 1 )
+            fc::raw::unpack( ds, h.first_block_num );
+         if( h.version > 2 ) {
+            uint8_t compression = 0;
+            fc::raw::unpack( ds, compression );
+            EOS_ASSERT( compression <= static_cast<uint8_t>(block_log_compression::zlib), block_log_unsupported_version,
+                        "Unsupported compression ${c} of block log", ("c", compression) );
+            h.compression = static_cast<block_log_compression>(compression);
+         }
+         fc::raw::unpack( ds, h.genesis );
+         return h;
+      }
+
+      /// compression of a file from the start of its header
+      block_log_compression mapped_compression( const char* data, uint64_t size ) {
+         uint32_t version = 0;
+         if( size >= sizeof(version) )
+            memcpy( &version, data, sizeof(version) );
+         if( version <= 2 || size <= 2 * sizeof(uint32_t) )
+            return block_log_compression::none;
+         return static_cast<block_log_compression>( data[2 * sizeof(uint32_t)] );
+      }
+
+      /// packs a block as the entry of a file with the compression, without the position that follows it
+      vector<char> pack_entry( const signed_block& b, block_log_compression compression ) {
+         auto data = fc::raw::pack( b );
+         if( compression == block_log_compression::none )
+            return data;
+         bytes out;
+         bio::filtering_ostream comp;
+         comp.push( bio::zlib_compressor( bio::zlib::default_compression ) );
+         comp.push( bio::back_inserter( out ) );
+         bio::write( comp, data.data(), data.size() );
+         bio::close( comp );
+         return fc::raw::pack( out );
+      }
+
+      /// the packed block of a compressed entry
+      template<typename Stream>
+      bytes decompress_entry( Stream& ds ) {
+         bytes in;
+         fc::raw::unpack( ds, in );
+         bytes data;
+         try {
+            bio::filtering_ostream decomp;
+            decomp.push( bio::zlib_decompressor() );
+            decomp.push( bio::back_inserter( data ) );
+            bio::write( decomp, in.data(), in.size() );
+            bio::close( decomp );
+         } catch( ... ) {
+            EOS_THROW( block_log_exception, "block in the block log could not be decompressed" );
+         }
+         return data;
+      }
+
+      /// unpacks the block of an entry, or only its header when `T` is signed_block_header
+      template<typename Stream, typename T>
+      void unpack_entry( Stream& ds, T& b, block_log_compression compression ) {
+         if( compression == block_log_compression::none ) {
+            fc::raw::unpack( ds, b );
+            return;
+         }
+         auto data = decompress_entry( ds );
+         fc::datastream<const char*> bds( data.data(), data.size() );
+         fc::raw::unpack( bds, b );
+      }
+
+      /// moves past an entry without decoding the block, where the compression allows it
+      template<typename Stream>
+      void skip_entry( Stream& ds, block_log_compression compression ) {
+         if( compression == block_log_compression::none ) {
+            signed_block tmp;
+            fc::raw::unpack( ds, tmp );
+            return;
+         }
+         fc::unsigned_int size;
+         fc::raw::unpack( ds, size );
+         ds.skip( size.value );
+      }
+
+      /**
+       * Read-only mapping of a file that only grows by appends. A read that needs data past the end of the
+       * current mapping maps the file again, readers keep the region they use alive, so remapping never blocks
+       * a read in progress.
+       */
+      class mapped_log_file {
+         public:
+            using region_ptr = std::shared_ptr<const bip::mapped_region>;
+
+            explicit mapped_log_file( const fc::path& p ) : path(p) {}
+
+            /// drops the mapping of a file that was truncated or replaced
+            void invalidate() {
+               std::lock_guard<std::mutex> g( mtx );
+               region.reset();
+            }
+
+            /// a mapping of at least the first `size` bytes of the file, null if the file is smaller
+            region_ptr map( uint64_t size ) {
+               std::lock_guard<std::mutex> g( mtx );
+               if( region && region->get_size() >= size )
+                  return region;
+               if( size == 0 || file_size() < size )
+                  return region_ptr();
+               bip::file_mapping file( path.generic_string().c_str(), bip::read_only );
+               region = std::make_shared<const bip::mapped_region>( file, bip::read_only );
+               return region;
+            }
+
+            /// size of the file, 0 if it does not exist (anymore)
+            uint64_t file_size()const {
+               return fc::exists( path ) ? fc::file_size( path ) : 0;
+            }
+
+         private:
+            std::mutex  mtx;
+            fc::path    path;
+            region_ptr  region;
+      };
+
+      /**
+       * A block log file with its index, either the current blocks.log or one retained after the log was split.
+       * Splitting the log replaces the current segment instead of modifying it.
+       */
+      struct log_segment {
+         log_segment( uint32_t first, uint32_t last, const fc::path& blocks_path, const fc::path& index_path )
+         :first_block_num(first), last_block_num(last), block_file(blocks_path), index_file(index_path),
+          blocks(blocks_path), index(index_path) {}
+
+         const uint32_t   first_block_num;
+         const uint32_t   last_block_num; ///< of retained segments, the current one may grow
+         const fc::path   block_file;
+         const fc::path   index_file;
+         mapped_log_file  blocks;
+         mapped_log_file  index;
+
+         uint64_t read_index( uint32_t block_num );
+         std::pair<signed_block_ptr, uint64_t> read_block( uint64_t pos, uint64_t end );
+         signed_block_ptr read_block_by_num( uint32_t block_num );
+         optional<signed_block_header> read_block_header_by_num( uint32_t block_num );
+      };
+      using log_segment_ptr = std::shared_ptr<log_segment>;
+
+      /// position of a written block, block_log::npos if the index does not cover it
+      uint64_t log_segment::read_index( uint32_t block_num ) {
+         if( block_num < first_block_num )
+            return block_log::npos;
+         uint64_t offset = sizeof(uint64_t) * (block_num - first_block_num);
+         auto region = index.map( offset + sizeof(uint64_t) );
+         if( !region )
+            return block_log::npos;
+         uint64_t pos;
+         memcpy( &pos, (const char*)region->get_address() + offset, sizeof(pos) );
+         return pos;
+      }
+
+      /// unpacks the block at `pos` of a log entry ending at `end`, also returns the position of the next entry
+      std::pair<signed_block_ptr, uint64_t> log_segment::read_block( uint64_t pos, uint64_t end ) {
+         auto region = blocks.map( end );
+         EOS_ASSERT( region && pos < end, block_log_exception, "block at position ${pos} is not in the block log", ("pos", pos) );
+         const char* data = (const char*)region->get_address();
+         fc::datastream<const char*> ds( data + pos, end - pos );
+         std::pair<signed_block_ptr, uint64_t> result;
+         result.first = std::make_shared<signed_block>();
+         unpack_entry( ds, *result.first, mapped_compression( data, end ) );
+         result.second = pos + ds.tellp() + sizeof(uint64_t);
+         return result;
+      }
+
+      signed_block_ptr log_segment::read_block_by_num( uint32_t block_num ) {
+         uint64_t pos = read_index( block_num );
+         if( pos == block_log::npos )
+            return signed_block_ptr();
+         // the entry of a block ends where the next one starts, the last entry at the end of the file
+         uint64_t end = read_index( block_num + 1 );
+         if( end == block_log::npos )
+            end = blocks.file_size();
+         auto b = read_block( pos, end ).first;
+         EOS_ASSERT(b->block_num() == block_num, reversible_blocks_exception,
+                   "Wrong block was read from block log.", ("returned", b->block_num())("expected", block_num));
+         return b;
+      }
+
+      /// an uncompressed block is not decoded past its header
+      optional<signed_block_header> log_segment::read_block_header_by_num( uint32_t block_num ) {
+         uint64_t pos = read_index( block_num );
+         if( pos == block_log::npos )
+            return optional<signed_block_header>();
+         uint64_t end = read_index( block_num + 1 );
+         if( end == block_log::npos )
+            end = blocks.file_size();
+         auto region = blocks.map( end );
+         EOS_ASSERT( region && pos < end, block_log_exception, "block at position ${pos} is not in the block log", ("pos", pos) );
+         const char* data = (const char*)region->get_address();
+         fc::datastream<const char*> ds( data + pos, end - pos );
+         signed_block_header h;
+         unpack_entry( ds, h, mapped_compression( data, end ) );
+         EOS_ASSERT(h.block_num() == block_num, reversible_blocks_exception,
+                   "Wrong block was read from block log.", ("returned", h.block_num())("expected", block_num));
+         return h;
+      }
+
+      /// positions of the blocks found by decoding every block from the first, the slow path that trusts no pointer
+      vector<uint64_t> scan_positions( fc::datastream<const char*>& ds, block_log_compression compression, uint64_t end_pos ) {
+         vector<uint64_t> positions;
+         uint64_t pos = 0;
+         while( pos < end_pos ) {
+            skip_entry( ds, compression );
+            fc::raw::unpack( ds, pos );
+            positions.push_back( pos );
+         }
+         return positions;
+      }
+
+      /**
+       * Positions of the blocks found by following the position that ends every entry back from the head to the first
+       * block at `start`, reading 8 bytes per block. Returns false when a position does not lead back to `start`.
+       */
+      bool walk_positions( const char* data, uint64_t start, uint64_t end_pos, vector<uint64_t>& positions ) {
+         uint64_t pos = end_pos;
+         while( true ) {
+            if( pos < start )
+               return false;
+            positions.push_back( pos );
+            if( pos == start )
+               break;
+            if( pos < start + sizeof(uint64_t) )
+               return false;
+            uint64_t prev;
+            memcpy( &prev, data + pos - sizeof(prev), sizeof(prev) );
+            if( prev >= pos )
+               return false;
+            pos = prev;
+         }
+         std::reverse( positions.begin(), positions.end() );
+         return true;
+      }
+
+      struct position_range_check {
+         bool           valid = true;
+         block_id_type  first_previous;
+         block_id_type  last_id;
+      };
+
+      /// decodes the headers of the blocks at positions [begin, end) and checks their numbers and links
+      position_range_check check_positions( const char* data, uint64_t size, const vector<uint64_t>& positions,
+                                            size_t begin, size_t end, uint32_t first_block_num, block_log_compression compression ) {
+         position_range_check result;
+         signed_block b;
+         for( size_t i = begin; i < end && result.valid; ++i ) {
+            const uint64_t entry_end = (i + 1 < positions.size() ? positions[i + 1] : size) - sizeof(uint64_t);
+            if( entry_end <= positions[i] ) {
+               result.valid = false;
+               break;
+            }
+            fc::datastream<const char*> ds( data + positions[i], entry_end - positions[i] );
+            const signed_block_header* header = &b;
+            signed_block_header h;
+            try {
+               if( compression == block_log_compression::none ) {
+                  fc::raw::unpack( ds, h ); // a block starts with its header
+                  header = &h;
+               } else {
+                  unpack_entry( ds, b, compression );
+               }
+            } catch( ... ) {
+               result.valid = false;
+               break;
+            }
+            result.valid = header->block_num() == first_block_num + i && (i == begin || header->previous == result.last_id);
+            if( i == begin )
+               result.first_previous = header->previous;
+            result.last_id = header->id();
+         }
+         return result;
+      }
+
+      /**
+       * Writes the index of a block log file, reading the blocks through a mapping of the file.
+       *
+       * The positions are first collected by walking the position pointers back from the head. The file is then split
+       * into ranges of blocks whose headers are decoded on `threads` threads, each checking the numbers and links of its
+       * blocks, and the ranges are stitched by checking the links between them. A log that fails the checks is indexed
+       * by decoding every block from the first.
+       */
+      void build_index( const fc::path& block_file, const fc::path& index_file, uint32_t threads = 1 ) {
+         std::fstream index_stream;
+         index_stream.exceptions(std::fstream::failbit | std::fstream::badbit);
+         index_stream.open( index_file.generic_string().c_str(), std::ios::out | std::ios::binary | std::ios::trunc );
+
+         const uint64_t size = fc::file_size( block_file );
+         if( size <= sizeof(uint64_t) )
+            return;
+         bip::file_mapping file( block_file.generic_string().c_str(), bip::read_only );
+         bip::mapped_region region( file, bip::read_only );
+         const char* data = (const char*)region.get_address();
+
+         // the head block starts at the position in the last 8 bytes, the totem when there is no block
+         uint64_t end_pos;
+         memcpy( &end_pos, data + size - sizeof(end_pos), sizeof(end_pos) );
+         if( end_pos == block_log::npos )
+            return;
+
+         fc::datastream<const char*> ds( data, size );
+         const auto header = unpack_header( ds );
+         if( header.version != 1 )
+            ds.skip( sizeof(uint64_t) ); // the totem
+
+         vector<uint64_t> positions;
+         bool valid = end_pos < size && walk_positions( data, ds.tellp(), end_pos, positions );
+         if( valid ) {
+            threads = std::max<uint32_t>( 1, std::min<uint64_t>( threads, positions.size() ) );
+            const size_t per_thread = (positions.size() + threads - 1) / threads;
+            vector<std::future<position_range_check>> checks;
+            for( size_t begin = 0; begin < positions.size(); begin += per_thread ) {
+               const size_t end = std::min( begin + per_thread, positions.size() );
+               checks.emplace_back( std::async( threads > 1 ? std::launch::async : std::launch::deferred, [&, begin, end]() {
+                  return check_positions( data, size, positions, begin, end, header.first_block_num, header.compression );
+               } ) );
+            }
+            block_id_type last_id;
+            for( size_t i = 0; i < checks.size(); ++i ) {
+               auto check = checks[i].get();
+               valid = valid && check.valid && (i == 0 || check.first_previous == last_id);
+               last_id = check.last_id;
+            }
+         }
+         if( !valid ) {
+            wlog( "Block positions of ${file} are inconsistent, indexing it by decoding every block", ("file", block_file) );
+            positions = scan_positions( ds, header.compression, end_pos );
+         }
+         index_stream.write( (const char*)positions.data(), positions.size() * sizeof(uint64_t) );
+      }
+
+      struct cached_block {
+         uint32_t          block_num;
+         signed_block_ptr  block;
+      };
+
+      struct by_block_num;
+      typedef boost::multi_index_container<
+         cached_block,
+         boost::multi_index::indexed_by<
+            boost::multi_index::sequenced<>,
+            boost::multi_index::hashed_unique<boost::multi_index::tag<by_block_num>,
+               boost::multi_index::member<cached_block, uint32_t, &cached_block::block_num>>
+         >
+      > block_cache_type;
+
       class block_log_impl {
          public:
             signed_block_ptr         head;
@@ -36,6 +459,41 @@ namespace eosio { namespace chain {
             bool                     genesis_written_to_block_log = false;
             uint32_t                 version = 0;
             uint32_t                 first_block_num = 0;
+            genesis_state            genesis;
+            block_log_compression    compression = block_log_compression::none;     ///< of blocks.log
+            block_log_compression    new_log_compression = block_log_compression::none; ///< of files this log starts
+
+            /// guards the streams, which the writer thread uses while reads happen on the caller's thread
+            std::mutex                    stream_mutex;
+
+            /// blocks appended but not written yet, queued blocks stay at the front until they are written
+            uint32_t                      max_queued_blocks = 0; ///< 0 writes synchronously in append
+            uint32_t                      fsync_interval = 0;    ///< blocks between fsyncs, 0 never fsyncs
+            uint32_t                      unsynced_blocks = 0;
+            std::deque<signed_block_ptr>  queue;
+            std::mutex                    queue_mutex;
+            std::condition_variable       queue_cv;   ///< signalled when blocks are queued or the writer stops
+            std::condition_variable       written_cv; ///< signalled when queued blocks are written or writing failed
+            bool                          stopping = false;
+            std::exception_ptr            write_error;
+            std::thread                   writer;
+
+            /// reads go through the mappings of the segments, so they neither share the streams nor the writer's lock
+            log_segment_ptr               current;
+            vector<log_segment_ptr>       retained;         ///< ordered by block number
+            std::mutex                    segments_mutex;   ///< guards current and retained
+            std::atomic<uint64_t>         segment_changes{0};
+
+            /// splitting of the log into retained segments
+            uint32_t                      stride = 0;
+            uint32_t                      max_retained_files = 0;
+            fc::path                      retained_dir;
+            fc::path                      archive_dir;
+
+            /// most recently read blocks, least recently used first
+            uint32_t                      max_cached_blocks = 0;
+            block_cache_type              block_cache;
+            std::mutex                    cache_mutex;
 
             inline void check_block_read() {
                if (block_write) {
@@ -71,14 +529,348 @@ namespace eosio { namespace chain {
                   index_write = true;
                }
             }
+
+            void write_blocks( const vector<signed_block_ptr>& blocks );
+            void append_to_log( vector<signed_block_ptr>::const_iterator begin, vector<signed_block_ptr>::const_iterator end );
+            void sync_files();
+            void write_queued_blocks();
+            void wait_for_writes();
+            signed_block_ptr find_queued( uint32_t block_num );
+            void stop_writer();
+
+            void set_current( uint32_t first );
+            void start_log( uint32_t first );
+            void split_log( uint32_t last_block_num );
+            void prune_retained();
+            void load_retained();
+
+            log_segment_ptr current_segment() {
+               std::lock_guard<std::mutex> g( segments_mutex );
+               return current;
+            }
+            log_segment_ptr find_segment( uint32_t block_num );
+            template<typename Read>
+            auto read_written( uint32_t block_num, Read&& read ) -> decltype( read( std::declval<log_segment&>() ) );
+            signed_block_ptr find_cached( uint32_t block_num );
+            void cache( const signed_block_ptr& b );
+            void clear_cache();
       };
+
+      /// writes the blocks to the current log, which is split after every block that completes a stride
+      void block_log_impl::write_blocks( const vector<signed_block_ptr>& blocks ) {
+         auto itr = blocks.begin();
+         while( itr != blocks.end() ) {
+            auto end = itr;
+            bool split = false;
+            while( end != blocks.end() && !split ) {
+               split = stride && (*end)->block_num() % stride == 0;
+               ++end;
+            }
+            append_to_log( itr, end );
+            if( split )
+               split_log( (*(end - 1))->block_num() );
+            itr = end;
+         }
+      }
+
+      /// packs the blocks and writes them with one write to each file, must be called holding stream_mutex
+      void block_log_impl::append_to_log( vector<signed_block_ptr>::const_iterator begin, vector<signed_block_ptr>::const_iterator end ) {
+         check_block_write();
+         check_index_write();
+
+         uint64_t pos = block_stream.tellp();
+         uint64_t index_pos = index_stream.tellp();
+         vector<char> block_data;
+         vector<char> index_data;
+         index_data.reserve( (end - begin) * sizeof(uint64_t) );
+         for( auto itr = begin; itr != end; ++itr ) {
+            const auto& b = *itr;
+            EOS_ASSERT(index_pos == sizeof(uint64_t) * (b->block_num() - first_block_num),
+                       block_log_append_fail,
+                       "Append to index file occuring at wrong position.",
+                       ("position", index_pos)
+                       ("expected", (b->block_num() - first_block_num) * sizeof(uint64_t)));
+            auto data = pack_entry( *b, compression );
+            block_data.insert( block_data.end(), data.begin(), data.end() );
+            block_data.insert( block_data.end(), (const char*)&pos, (const char*)&pos + sizeof(pos) );
+            index_data.insert( index_data.end(), (const char*)&pos, (const char*)&pos + sizeof(pos) );
+            pos += data.size() + sizeof(pos);
+            index_pos += sizeof(pos);
+         }
+         // a block is readable once the index refers to it, so its data reaches the file first
+         block_stream.write( block_data.data(), block_data.size() );
+         block_stream.flush();
+         index_stream.write( index_data.data(), index_data.size() );
+         index_stream.flush();
+
+         unsynced_blocks += end - begin;
+         if( fsync_interval && unsynced_blocks >= fsync_interval ) {
+            sync_files();
+            unsynced_blocks = 0;
+         }
+      }
+
+      /// fsync of any descriptor of a file commits all of its written data
+      void block_log_impl::sync_files() {
+         for( const auto& file : { block_file, index_file } ) {
+            int fd = ::open( file.generic_string().c_str(), O_RDONLY );
+            EOS_ASSERT( fd >= 0, block_log_exception, "unable to open ${file} for fsync", ("file", file) );
+            int r = ::fsync( fd );
+            ::close( fd );
+            EOS_ASSERT( r == 0, block_log_exception, "fsync of ${file} failed", ("file", file) );
+         }
+      }
+
+      void block_log_impl::write_queued_blocks() {
+         std::unique_lock<std::mutex> lock( queue_mutex );
+         while( true ) {
+            queue_cv.wait( lock, [&]() { return stopping || !queue.empty(); } );
+            if( queue.empty() )
+               return; // stopping with every queued block written
+
+            // everything queued so far is written as one batch
+            vector<signed_block_ptr> batch( queue.begin(), queue.end() );
+            lock.unlock();
+            try {
+               std::lock_guard<std::mutex> g( stream_mutex );
+               write_blocks( batch );
+            } catch( ... ) {
+               lock.lock();
+               write_error = std::current_exception();
+               written_cv.notify_all();
+               return;
+            }
+            lock.lock();
+            queue.erase( queue.begin(), queue.begin() + batch.size() );
+            written_cv.notify_all();
+         }
+      }
+
+      /// blocks until every appended block is written, rethrows the failure of the writer
+      void block_log_impl::wait_for_writes() {
+         std::unique_lock<std::mutex> lock( queue_mutex );
+         written_cv.wait( lock, [&]() { return queue.empty() || write_error; } );
+         if( write_error )
+            std::rethrow_exception( write_error );
+      }
+
+      signed_block_ptr block_log_impl::find_queued( uint32_t block_num ) {
+         std::lock_guard<std::mutex> g( queue_mutex );
+         if( queue.empty() || block_num < queue.front()->block_num() || block_num > queue.back()->block_num() )
+            return signed_block_ptr();
+         return queue[block_num - queue.front()->block_num()];
+      }
+
+      void block_log_impl::stop_writer() {
+         if( !writer.joinable() )
+            return;
+         {
+            std::lock_guard<std::mutex> g( queue_mutex );
+            stopping = true;
+         }
+         queue_cv.notify_one();
+         writer.join();
+         stopping = false;
+      }
+
+      /// replaces the current segment after blocks.log was started, truncated or replaced
+      void block_log_impl::set_current( uint32_t first ) {
+         auto next = std::make_shared<log_segment>( first, 0, block_file, index_file );
+         std::lock_guard<std::mutex> g( segments_mutex );
+         current = next;
+         ++segment_changes;
+      }
+
+      /// starts an empty blocks.log whose first block is `first`, must be called holding stream_mutex
+      void block_log_impl::start_log( uint32_t first ) {
+         if (block_stream.is_open())
+            block_stream.close();
+         if (index_stream.is_open())
+            index_stream.close();
+         fc::remove_all(block_file);
+         fc::remove_all(index_file);
+
+         block_stream.open(block_file.generic_string().c_str(), LOG_WRITE);
+         index_stream.open(index_file.generic_string().c_str(), LOG_WRITE);
+         block_write = true;
+         index_write = true;
+
+         version = log_version( new_log_compression );
+         first_block_num = first;
+         compression = new_log_compression;
+         auto data = pack_header( log_header{ version, first_block_num, compression, genesis } );
+         auto totem = block_log::npos;
+         block_stream.write(data.data(), data.size());
+         block_stream.write((char*)&totem, sizeof(totem));
+         block_stream.flush();
+         genesis_written_to_block_log = true;
+      }
+
+      /// moves blocks.log, which ends with `last_block_num`, to the retained segments, must be called holding stream_mutex
+      void block_log_impl::split_log( uint32_t last_block_num ) {
+         block_stream.close();
+         index_stream.close();
+         if( fsync_interval ) {
+            sync_files();
+            unsynced_blocks = 0;
+         }
+
+         if( !fc::is_directory( retained_dir ) )
+            fc::create_directories( retained_dir );
+         const auto name = std::string("blocks-") + std::to_string( first_block_num ) + "-" + std::to_string( last_block_num );
+         auto segment = std::make_shared<log_segment>( first_block_num, last_block_num,
+                                                       retained_dir / (name + ".log"), retained_dir / (name + ".index") );
+         {
+            // readers never see a block that is in neither the current nor a retained segment
+            std::lock_guard<std::mutex> g( segments_mutex );
+            fc::rename( block_file, segment->block_file );
+            fc::rename( index_file, segment->index_file );
+            retained.push_back( segment );
+            start_log( last_block_num + 1 );
+            current = std::make_shared<log_segment>( first_block_num, 0, block_file, index_file );
+            ++segment_changes;
+         }
+         ilog( "split block log, blocks ${first} to ${last} retained in ${file}",
+               ("first", segment->first_block_num)("last", last_block_num)("file", segment->block_file) );
+
+         prune_retained();
+      }
+
+      /// archives or deletes the oldest retained segments beyond max_retained_files
+      void block_log_impl::prune_retained() {
+         while( max_retained_files && retained.size() > max_retained_files ) {
+            log_segment_ptr oldest;
+            {
+               std::lock_guard<std::mutex> g( segments_mutex );
+               oldest = retained.front();
+               retained.erase( retained.begin() );
+               ++segment_changes;
+            }
+            if( archive_dir.empty() ) {
+               fc::remove_all( oldest->block_file );
+               fc::remove_all( oldest->index_file );
+            } else {
+               if( !fc::is_directory( archive_dir ) )
+                  fc::create_directories( archive_dir );
+               fc::rename( oldest->block_file, archive_dir / oldest->block_file.filename() );
+               fc::rename( oldest->index_file, archive_dir / oldest->index_file.filename() );
+            }
+         }
+      }
+
+      /// finds the retained segments, rebuilding missing or incomplete indexes in parallel
+      void block_log_impl::load_retained() {
+         retained.clear();
+         if( !fc::is_directory( retained_dir ) )
+            return;
+
+         const std::string prefix = "blocks-", suffix = ".log";
+         for( fc::directory_iterator itr( retained_dir ), end; itr != end; ++itr ) {
+            const auto name = (*itr).filename().generic_string();
+            if( name.size() <= prefix.size() + suffix.size() || name.compare( 0, prefix.size(), prefix ) != 0 ||
+                name.compare( name.size() - suffix.size(), suffix.size(), suffix ) != 0 )
+               continue;
+            const auto range = name.substr( prefix.size(), name.size() - prefix.size() - suffix.size() );
+            const auto dash = range.find( '-' );
+            uint32_t first = 0, last = 0;
+            if( dash == std::string::npos || !parse_block_num( range.substr( 0, dash ), first ) ||
+                !parse_block_num( range.substr( dash + 1 ), last ) || first == 0 || first > last ) {
+               wlog( "Ignoring ${file} in the retained block log directory, its name is not blocks-<first>-<last>.log",
+                     ("file", *itr) );
+               continue;
+            }
+            auto index_path = retained_dir / (name.substr( 0, name.size() - suffix.size() ) + ".index");
+            retained.push_back( std::make_shared<log_segment>( first, last, *itr, index_path ) );
+         }
+         std::sort( retained.begin(), retained.end(), []( const log_segment_ptr& a, const log_segment_ptr& b ) {
+            return a->first_block_num < b->first_block_num;
+         } );
+
+         vector<log_segment_ptr> unindexed;
+         for( const auto& s : retained ) {
+            if( s->index.file_size() != sizeof(uint64_t) * (s->last_block_num - s->first_block_num + 1) )
+               unindexed.push_back( s );
+         }
+         for( const auto& s : unindexed ) {
+            ilog( "Reconstructing index of retained block log ${file}", ("file", s->block_file) );
+            build_index( s->block_file, s->index_file, std::thread::hardware_concurrency() );
+         }
+      }
+
+      log_segment_ptr block_log_impl::find_segment( uint32_t block_num ) {
+         std::lock_guard<std::mutex> g( segments_mutex );
+         if( current && block_num >= current->first_block_num )
+            return current;
+         auto itr = std::upper_bound( retained.begin(), retained.end(), block_num, []( uint32_t n, const log_segment_ptr& s ) {
+            return n < s->first_block_num;
+         } );
+         if( itr == retained.begin() || block_num > (*(itr - 1))->last_block_num )
+            return log_segment_ptr();
+         return *(itr - 1);
+      }
+
+      /// reads a written block with `read` from the segment holding it
+      template<typename Read>
+      auto block_log_impl::read_written( uint32_t block_num, Read&& read ) -> decltype( read( std::declval<log_segment&>() ) ) {
+         for( int attempt = 0; ; ++attempt ) {
+            const uint64_t changes = segment_changes;
+            auto segment = find_segment( block_num );
+            if( !segment )
+               return {};
+            try {
+               auto b = read( *segment );
+               if( b || attempt > 0 || changes == segment_changes )
+                  return b;
+            } catch( const block_log_exception& ) {
+               if( attempt > 0 || changes == segment_changes )
+                  throw;
+            }
+            // the segment was moved while it was read, look the block up again
+         }
+      }
+
+      signed_block_ptr block_log_impl::find_cached( uint32_t block_num ) {
+         if( !max_cached_blocks )
+            return signed_block_ptr();
+         std::lock_guard<std::mutex> g( cache_mutex );
+         auto& idx = block_cache.get<by_block_num>();
+         auto itr = idx.find( block_num );
+         if( itr == idx.end() )
+            return signed_block_ptr();
+         block_cache.relocate( block_cache.end(), block_cache.project<0>( itr ) );
+         return itr->block;
+      }
+
+      void block_log_impl::cache( const signed_block_ptr& b ) {
+         if( !max_cached_blocks )
+            return;
+         std::lock_guard<std::mutex> g( cache_mutex );
+         block_cache.push_back( cached_block{ b->block_num(), b } );
+         while( block_cache.size() > max_cached_blocks )
+            block_cache.pop_front();
+      }
+
+      void block_log_impl::clear_cache() {
+         std::lock_guard<std::mutex> g( cache_mutex );
+         block_cache.clear();
+      }
    }
 
-   block_log::block_log(const fc::path& data_dir)
+   block_log::block_log(const fc::path& data_dir, const block_log_config& cfg)
    :my(new detail::block_log_impl()) {
       my->block_stream.exceptions(std::fstream::failbit | std::fstream::badbit);
       my->index_stream.exceptions(std::fstream::failbit | std::fstream::badbit);
+      my->max_queued_blocks = cfg.write_queue_size;
+      my->fsync_interval = cfg.fsync_interval;
+      my->max_cached_blocks = cfg.cache_size;
+      my->stride = cfg.stride;
+      my->max_retained_files = cfg.max_retained_files;
+      my->retained_dir = cfg.retained_dir.generic_string().empty() ? fc::path("retained") : cfg.retained_dir;
+      my->archive_dir = cfg.archive_dir;
+      my->new_log_compression = cfg.compression;
       open(data_dir);
+      if( my->max_queued_blocks )
+         my->writer = std::thread( [impl = my.get()]() { impl->write_queued_blocks(); } );
    }
 
    block_log::block_log(block_log&& other) {
@@ -87,7 +879,13 @@ namespace eosio { namespace chain {
 
    block_log::~block_log() {
       if (my) {
-         flush();
+         my->stop_writer();
+         if( my->write_error ) {
+            elog( "block log was not completely written, the last ${n} irreversible blocks are missing from it",
+                  ("n", my->queue.size()) );
+         } else {
+            flush();
+         }
          my.reset();
       }
    }
@@ -102,6 +900,12 @@ namespace eosio { namespace chain {
          fc::create_directories(data_dir);
       my->block_file = data_dir / "blocks.log";
       my->index_file = data_dir / "blocks.index";
+      if( my->retained_dir.is_relative() )
+         my->retained_dir = data_dir / my->retained_dir;
+      if( !my->archive_dir.generic_string().empty() && my->archive_dir.is_relative() )
+         my->archive_dir = data_dir / my->archive_dir;
+      my->load_retained();
+      my->set_current( 0 );
 
       //ilog("Opening block log at ${path}", ("path", my->block_file.generic_string()));
       my->block_stream.open(my->block_file.generic_string().c_str(), LOG_WRITE);
@@ -127,6 +931,17 @@ namespace eosio { namespace chain {
        *  - If the index file head is not in the log file, delete the index and replay.
        *  - If the index file head is in the log, but not up to date, replay from index head.
        */
+      if( !fc::file_size(my->block_file) && !my->retained.empty() ) {
+         // the log was split, but the next blocks.log was not started before shutdown
+         const auto& newest = my->retained.back();
+         ilog("Starting block log after retained block log ${file}", ("file", newest->block_file));
+         std::fstream segment_stream;
+         segment_stream.exceptions(std::fstream::failbit | std::fstream::badbit);
+         segment_stream.open( newest->block_file.generic_string().c_str(), LOG_READ );
+         my->genesis = detail::unpack_header( segment_stream ).genesis;
+         my->start_log( newest->last_block_num + 1 );
+      }
+
       auto log_size = fc::file_size(my->block_file);
       auto index_size = fc::file_size(my->index_file);
 
@@ -134,25 +949,18 @@ namespace eosio { namespace chain {
          ilog("Log is nonempty");
          my->check_block_read();
          my->block_stream.seekg( 0 );
-         my->version = 0;
-         my->block_stream.read( (char*)&my->version, sizeof(my->version) );
-         EOS_ASSERT( my->version > 0, block_log_exception, "Block log was not setup properly" );
-         EOS_ASSERT( my->version >= min_supported_version && my->version <= max_supported_version, block_log_unsupported_version,
-                 "Unsupported version of block log. Block log version is ${version} while code supports version(s) [${min},${max}]",
-                 ("version", my->version)("min", block_log::min_supported_version)("max", block_log::max_supported_version) );
-
-
+         const auto header = detail::unpack_header( my->block_stream );
+         my->version = header.version;
+         my->first_block_num = header.first_block_num;
+         my->compression = header.compression;
+         my->genesis = header.genesis;
          my->genesis_written_to_block_log = true; // Assume it was constructed properly.
-         if (my->version > 1){
-            my->first_block_num = 0;
-            my->block_stream.read( (char*)&my->first_block_num, sizeof(my->first_block_num) );
-            EOS_ASSERT(my->first_block_num > 0, block_log_exception, "Block log is malformed, first recorded block number is 0 but must be greater than or equal to 1");
-         } else {
-            my->first_block_num = 1;
-         }
+         EOS_ASSERT(my->first_block_num > 0, block_log_exception, "Block log is malformed, first recorded block number is 0 but must be greater than or equal to 1");
+         my->set_current( my->first_block_num );
 
          my->head = read_head();
-         my->head_id = my->head->id();
+         if( my->head )
+            my->head_id = my->head->id();
 
          if (index_size) {
             my->check_block_read();
@@ -187,39 +995,48 @@ namespace eosio { namespace chain {
       }
    }
 
-   uint64_t block_log::append(const signed_block_ptr& b) {
+   void block_log::append(const signed_block_ptr& b) {
       try {
          EOS_ASSERT( my->genesis_written_to_block_log, block_log_append_fail, "Cannot append to block log until the genesis is first written" );
 
-         my->check_block_write();
-         my->check_index_write();
-
-         uint64_t pos = my->block_stream.tellp();
-         EOS_ASSERT(my->index_stream.tellp() == sizeof(uint64_t) * (b->block_num() - my->first_block_num),
-                   block_log_append_fail,
-                   "Append to index file occuring at wrong position.",
-                   ("position", (uint64_t) my->index_stream.tellp())
-                   ("expected", (b->block_num() - my->first_block_num) * sizeof(uint64_t)));
-         auto data = fc::raw::pack(*b);
-         my->block_stream.write(data.data(), data.size());
-         my->block_stream.write((char*)&pos, sizeof(pos));
-         my->index_stream.write((char*)&pos, sizeof(pos));
+         if( !my->writer.joinable() ) {
+            std::lock_guard<std::mutex> g( my->stream_mutex );
+            my->write_blocks( {b} );
+         } else {
+            std::unique_lock<std::mutex> lock( my->queue_mutex );
+            my->written_cv.wait( lock, [&]() { return my->queue.size() < my->max_queued_blocks || my->write_error; } );
+            if( my->write_error )
+               std::rethrow_exception( my->write_error );
+            EOS_ASSERT( my->queue.empty() || my->queue.back()->block_num() + 1 == b->block_num(), block_log_append_fail,
+                        "Append of block ${n} does not follow the last queued block ${last}",
+                        ("n", b->block_num())("last", my->queue.back()->block_num()) );
+            my->queue.push_back( b );
+            my->queue_cv.notify_one();
+         }
          my->head = b;
          my->head_id = b->id();
-
-         flush();
-
-         return pos;
       }
       FC_LOG_AND_RETHROW()
    }
 
+   uint32_t block_log::written_block_num()const {
+      std::lock_guard<std::mutex> g( my->queue_mutex );
+      if( !my->queue.empty() )
+         return my->queue.front()->block_num() - 1;
+      return my->head ? my->head->block_num() : 0;
+   }
+
    void block_log::flush() {
+      my->wait_for_writes();
+      std::lock_guard<std::mutex> g( my->stream_mutex );
       my->block_stream.flush();
       my->index_stream.flush();
    }
 
    void block_log::reset( const genesis_state& gs, const signed_block_ptr& first_block, uint32_t first_block_num ) {
+      my->wait_for_writes();
+      std::unique_lock<std::mutex> lock( my->stream_mutex );
+
       if (my->block_stream.is_open())
          my->block_stream.close();
       if (my->index_stream.is_open())
@@ -233,11 +1050,15 @@ namespace eosio { namespace chain {
       my->block_write = true;
       my->index_write = true;
 
-      auto data = fc::raw::pack(gs);
+      my->genesis = gs;
       my->version = 0; // version of 0 is invalid; it indicates that the genesis was not properly written to the block log
       my->first_block_num = first_block_num;
-      my->block_stream.write((char*)&my->version, sizeof(my->version));
-      my->block_stream.write((char*)&my->first_block_num, sizeof(my->first_block_num));
+      my->compression = my->new_log_compression;
+      my->set_current( first_block_num );
+      my->clear_cache();
+      // the header has the layout of the final version, only the version itself is written once the log is complete
+      auto data = detail::pack_header( detail::log_header{ detail::log_version( my->compression ), first_block_num, my->compression, gs } );
+      memcpy( data.data(), &my->version, sizeof(my->version) );
       my->block_stream.write(data.data(), data.size());
       my->genesis_written_to_block_log = true;
 
@@ -246,7 +1067,9 @@ namespace eosio { namespace chain {
       my->block_stream.write((char*)&totem, sizeof(totem));
 
       if (first_block) {
-         append(first_block);
+         my->write_blocks( {first_block} );
+         my->head = first_block;
+         my->head_id = first_block->id();
       }
 
       auto pos = my->block_stream.tellp();
@@ -255,67 +1078,91 @@ namespace eosio { namespace chain {
       my->block_stream.open(my->block_file.generic_string().c_str(), std::ios::in | std::ios::out | std::ios::binary ); // Bypass append-only writing just once
 
       static_assert( block_log::max_supported_version > 0, "a version number of zero is not supported" );
-      my->version = block_log::max_supported_version;
+      my->version = detail::log_version( my->compression );
       my->block_stream.seekp( 0 );
       my->block_stream.write( (char*)&my->version, sizeof(my->version) );
       my->block_stream.seekp( pos );
-      flush();
+      my->block_stream.flush();
+      my->index_stream.flush();
 
       my->block_write = false;
       my->check_block_write(); // Reset to append-only writing.
    }
 
    std::pair<signed_block_ptr, uint64_t> block_log::read_block(uint64_t pos)const {
-      my->check_block_read();
-
-      my->block_stream.seekg(pos);
-      std::pair<signed_block_ptr,uint64_t> result;
-      result.first = std::make_shared<signed_block>();
-      fc::raw::unpack(my->block_stream, *result.first);
-      result.second = uint64_t(my->block_stream.tellg()) + 8;
-      return result;
+      auto current = my->current_segment();
+      return current->read_block( pos, current->blocks.file_size() );
    }
 
    signed_block_ptr block_log::read_block_by_num(uint32_t block_num)const {
       try {
-         signed_block_ptr b;
-         uint64_t pos = get_block_pos(block_num);
-         if (pos != npos) {
-            b = read_block(pos).first;
-            EOS_ASSERT(b->block_num() == block_num, reversible_blocks_exception,
-                      "Wrong block was read from block log.", ("returned", b->block_num())("expected", block_num));
-         }
+         signed_block_ptr b = my->find_cached( block_num );
+         if( b )
+            return b;
+         // a queued block is removed from the queue only once it is written, so it is in one or the other
+         b = my->find_queued( block_num );
+         if( b )
+            return b;
+         b = my->read_written( block_num, [block_num]( detail::log_segment& s ) { return s.read_block_by_num( block_num ); } );
+         if( b )
+            my->cache( b );
          return b;
       } FC_LOG_AND_RETHROW()
    }
 
+   optional<signed_block_header> block_log::read_block_header_by_num(uint32_t block_num)const {
+      try {
+         signed_block_ptr b = my->find_cached( block_num );
+         if( !b )
+            b = my->find_queued( block_num );
+         if( b )
+            return optional<signed_block_header>( *b );
+         return my->read_written( block_num, [block_num]( detail::log_segment& s ) { return s.read_block_header_by_num( block_num ); } );
+      } FC_LOG_AND_RETHROW()
+   }
+
    uint64_t block_log::get_block_pos(uint32_t block_num) const {
-      my->check_index_read();
-      if (!(my->head && block_num <= block_header::num_from_id(my->head_id) && block_num >= my->first_block_num))
-         return npos;
-      my->index_stream.seekg(sizeof(uint64_t) * (block_num - my->first_block_num));
-      uint64_t pos;
-      my->index_stream.read((char*)&pos, sizeof(pos));
-      return pos;
+      if( my->find_queued( block_num ) )
+         my->wait_for_writes();
+      auto segment = my->find_segment( block_num );
+      return segment ? segment->read_index( block_num ) : npos;
    }
 
    signed_block_ptr block_log::read_head()const {
-      my->check_block_read();
-
-      uint64_t pos;
+      {
+         std::lock_guard<std::mutex> g( my->queue_mutex );
+         if( !my->queue.empty() )
+            return my->queue.back();
+      }
 
-      // Check that the file is not empty
-      my->block_stream.seekg(0, std::ios::end);
-      if (my->block_stream.tellg() <= sizeof(pos))
-         return {};
+      uint64_t pos = npos;
+      uint64_t file_size;
+      detail::log_segment_ptr current;
+      {
+         // the tail of the file is only consistent between writes of the writer
+         std::lock_guard<std::mutex> g( my->stream_mutex );
+         current = my->current_segment();
+         file_size = current->blocks.file_size();
+
+         // Check that the file is not empty
+         if (file_size > sizeof(pos)) {
+            auto region = current->blocks.map( file_size );
+            memcpy( &pos, (const char*)region->get_address() + file_size - sizeof(pos), sizeof(pos) );
+         }
+      }
 
-      my->block_stream.seekg(-sizeof(pos), std::ios::end);
-      my->block_stream.read((char*)&pos, sizeof(pos));
       if (pos != npos) {
-         return read_block(pos).first;
-      } else {
-         return {};
+         return current->read_block( pos, file_size ).first;
+      }
+
+      // blocks.log was just started after a split, the head is the last block of the newest retained segment
+      detail::log_segment_ptr newest;
+      {
+         std::lock_guard<std::mutex> g( my->segments_mutex );
+         if( !my->retained.empty() )
+            newest = my->retained.back();
       }
+      return newest ? newest->read_block_by_num( newest->last_block_num ) : signed_block_ptr();
    }
 
    const signed_block_ptr& block_log::head()const {
@@ -323,48 +1170,28 @@ namespace eosio { namespace chain {
    }
 
    uint32_t block_log::first_block_num() const {
-      return my->first_block_num;
+      std::lock_guard<std::mutex> g( my->segments_mutex );
+      return my->retained.empty() ? my->first_block_num : my->retained.front()->first_block_num;
    }
 
    void block_log::construct_index() {
       ilog("Reconstructing Block Log Index...");
       my->index_stream.close();
-      fc::remove_all(my->index_file);
+      detail::build_index( my->block_file, my->index_file, std::thread::hardware_concurrency() );
       my->index_stream.open(my->index_file.generic_string().c_str(), LOG_WRITE);
       my->index_write = true;
-
-      uint64_t end_pos;
-      my->check_block_read();
-
-      my->block_stream.seekg(-sizeof( uint64_t), std::ios::end);
-      my->block_stream.read((char*)&end_pos, sizeof(end_pos));
-      signed_block tmp;
-
-      uint64_t pos = 0;
-      if (my->version == 1) {
-         pos = 4; // Skip version which should have already been checked.
-      } else {
-         pos = 8; // Skip version and first block offset which should have already been checked
-      }
-      my->block_stream.seekg(pos);
-
-      genesis_state gs;
-      fc::raw::unpack(my->block_stream, gs);
-
-      // skip the totem
-      if (my->version > 1) {
-         uint64_t totem;
-         my->block_stream.read((char*) &totem, sizeof(totem));
-      }
-
-      while( pos < end_pos ) {
-         fc::raw::unpack(my->block_stream, tmp);
-         my->block_stream.read((char*)&pos, sizeof(pos));
-         my->index_stream.write((char*)&pos, sizeof(pos));
-      }
+      my->current_segment()->index.invalidate();
    } // construct_index
 
-   fc::path block_log::repair_log( const fc::path& data_dir, uint32_t truncate_at_block ) {
+   void block_log::construct_index( const fc::path& block_file_name, const fc::path& index_file_name, uint32_t threads ) {
+      ilog("Reconstructing ${index} from ${log}", ("index", index_file_name)("log", block_file_name));
+      EOS_ASSERT( fc::is_regular_file(block_file_name), block_log_not_found,
+                  "Block log not found at '${file}'", ("file", block_file_name) );
+      detail::build_index( block_file_name, index_file_name, threads ? threads : std::thread::hardware_concurrency() );
+   }
+
+   fc::path block_log::repair_log( const fc::path& data_dir, uint32_t truncate_at_block,
+                                   const fc::path& retained_dir, const fc::path& archive_dir ) {
       ilog("Recovering Block Log...");
       EOS_ASSERT( fc::is_directory(data_dir) && fc::is_regular_file(data_dir / "blocks.log"), block_log_not_found,
                  "Block log not found in '${blocks_dir}'", ("blocks_dir", data_dir)          );
@@ -390,6 +1217,26 @@ namespace eosio { namespace chain {
       fc::create_directories(blocks_dir);
       auto block_log_path = blocks_dir / "blocks.log";
 
+      // blocks.log only holds the blocks after the split segments, which are carried over unchanged
+      auto carry_over = [&]( fc::path dir ) {
+         if( dir.generic_string().empty() )
+            return;
+         if( !dir.is_relative() ) {
+            const auto root = blocks_dir.generic_string() + "/";
+            const auto path = dir.generic_string();
+            if( path.compare( 0, root.size(), root ) != 0 )
+               return; // outside of the blocks directory, so it was not moved
+            dir = path.substr( root.size() );
+         }
+         if( !fc::is_directory( backup_dir / dir ) )
+            return;
+         fc::create_directories( (blocks_dir / dir).parent_path() );
+         fc::rename( backup_dir / dir, blocks_dir / dir );
+         ilog( "Moved '${dir}' back from the backed up blocks directory", ("dir", blocks_dir / dir) );
+      };
+      carry_over( retained_dir.generic_string().empty() ? fc::path("retained") : retained_dir );
+      carry_over( archive_dir );
+
       ilog( "Reconstructing '${new_block_log}' from backed up block log", ("new_block_log", block_log_path) );
 
       std::fstream  old_block_stream;
@@ -402,27 +1249,17 @@ namespace eosio { namespace chain {
       uint64_t end_pos = old_block_stream.tellg();
       old_block_stream.seekg( 0 );
 
-      uint32_t version = 0;
-      old_block_stream.read( (char*)&version, sizeof(version) );
-      EOS_ASSERT( version > 0, block_log_exception, "Block log was not setup properly" );
-      EOS_ASSERT( version >= min_supported_version && version <= max_supported_version, block_log_unsupported_version,
-                 "Unsupported version of block log. Block log version is ${version} while code supports version(s) [${min},${max}]",
-                 ("version", version)("min", block_log::min_supported_version)("max", block_log::max_supported_version) );
-
-      new_block_stream.write( (char*)&version, sizeof(version) );
-
-      uint32_t first_block_num = 1;
-      if (version != 1) {
-         old_block_stream.read ( (char*)&first_block_num, sizeof(first_block_num) );
-         new_block_stream.write( (char*)&first_block_num, sizeof(first_block_num) );
+      const auto header = detail::unpack_header( old_block_stream );
+      const uint32_t version = header.version;
+      if( version == 1 ) {
+         new_block_stream.write( (char*)&version, sizeof(version) );
+         auto data = fc::raw::pack( header.genesis );
+         new_block_stream.write( data.data(), data.size() );
+      } else {
+         auto data = detail::pack_header( header );
+         new_block_stream.write( data.data(), data.size() );
       }
 
-      genesis_state gs;
-      fc::raw::unpack(old_block_stream, gs);
-
-      auto data = fc::raw::pack( gs );
-      new_block_stream.write( data.data(), data.size() );
-
       if (version != 1) {
          auto expected_totem = npos;
          std::decay_t<decltype(npos)> actual_totem;
@@ -447,7 +1284,7 @@ namespace eosio { namespace chain {
          signed_block tmp;
 
          try {
-            fc::raw::unpack(old_block_stream, tmp);
+            detail::unpack_entry( old_block_stream, tmp, header.compression );
          } catch( ... ) {
             except_ptr = std::current_exception();
             incomplete_block_data.resize( end_pos - pos );
@@ -477,7 +1314,7 @@ namespace eosio { namespace chain {
             break;
          }
 
-         auto data = fc::raw::pack(tmp);
+         auto data = detail::pack_entry( tmp, header.compression );
          new_block_stream.write( data.data(), data.size() );
          new_block_stream.write( reinterpret_cast<char*>(&pos), sizeof(pos) );
          block_num = tmp.block_num();
@@ -531,22 +1368,7 @@ namespace eosio { namespace chain {
 
       std::fstream  block_stream;
       block_stream.open( (data_dir / "blocks.log").generic_string().c_str(), LOG_READ );
-
-      uint32_t version = 0;
-      block_stream.read( (char*)&version, sizeof(version) );
-      EOS_ASSERT( version > 0, block_log_exception, "Block log was not setup properly." );
-      EOS_ASSERT( version >= min_supported_version && version <= max_supported_version, block_log_unsupported_version,
-                 "Unsupported version of block log. Block log version is ${version} while code supports version(s) [${min},${max}]",
-                 ("version", version)("min", block_log::min_supported_version)("max", block_log::max_supported_version) );
-
-      uint32_t first_block_num = 1;
-      if (version != 1) {
-         block_stream.read ( (char*)&first_block_num, sizeof(first_block_num) );
-      }
-
-      genesis_state gs;
-      fc::raw::unpack(block_stream, gs);
-      return gs;
+      return detail::unpack_header( block_stream ).genesis;
    }
 
 } } /// eosio::chain
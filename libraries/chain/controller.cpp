@@ -13,17 +13,22 @@
 #include <eosio/chain/generated_transaction_object.hpp>
 #include <eosio/chain/transaction_object.hpp>
 #include <eosio/chain/reversible_block_object.hpp>
+#include <eosio/chain/activated_feature_object.hpp>
 
 #include <eosio/chain/authorization_manager.hpp>
 #include <eosio/chain/resource_limits.hpp>
 #include <eosio/chain/chain_snapshot.hpp>
 #include <eosio/chain/thread_utils.hpp>
+#include <eosio/chain/execution_profiler.hpp>
 
 #include <chainbase/chainbase.hpp>
 #include <fc/io/json.hpp>
 #include <fc/scoped_exit.hpp>
 #include <fc/variant_object.hpp>
 
+#include <condition_variable>
+#include <thread>
+
 
 namespace eosio { namespace chain {
 
@@ -104,6 +109,8 @@ struct pending_state {
 
    vector<action_receipt>             _actions;
 
+   vector<access_set>                 _access_sets; ///< of the applied transactions, when tracked
+
    controller::block_status           _block_status = controller::block_status::incomplete;
 
    optional<block_id_type>            _producer_block_id;
@@ -113,6 +120,126 @@ struct pending_state {
    }
 };
 
+static block_log_config make_block_log_config( const controller::config& cfg ) {
+   block_log_config c;
+   c.write_queue_size   = cfg.block_log_write_queue_size;
+   c.fsync_interval     = cfg.block_log_fsync_interval;
+   c.cache_size         = cfg.block_log_cache_size;
+   c.stride             = cfg.block_log_stride;
+   c.max_retained_files = cfg.max_retained_block_files;
+   c.retained_dir       = cfg.blocks_retained_dir;
+   c.archive_dir        = cfg.blocks_archive_dir;
+   c.compression        = cfg.compress_block_log ? block_log_compression::zlib : block_log_compression::none;
+   return c;
+}
+
+/**
+ *  Prepares the blocks of a replay ahead of their application. A reader thread reads and unpacks the blocks from the
+ *  block log and derives their header states from one another, the transaction metadata of every block is built on
+ *  the thread pool, which also recovers the signing keys when they are checked. The main thread only applies blocks.
+ */
+class replay_reader {
+   public:
+      struct prepared_block {
+         block_state_ptr                                  state;
+         std::future<vector<transaction_metadata_ptr>>    trxs;
+      };
+
+      replay_reader( const block_log& blog, boost::asio::thread_pool& thread_pool, const chain_id_type& chain_id,
+                     block_state_ptr head, uint32_t max_blocks, bool skip_validate_signee, bool recover_keys )
+      :blog( blog ), thread_pool( thread_pool ), chain_id( chain_id ), max_blocks( std::max( max_blocks, 1u ) ),
+       skip_validate_signee( skip_validate_signee ), recover_keys( recover_keys )
+      {
+         reader = std::thread( [this, head]() { read_blocks( head ); } );
+      }
+
+      ~replay_reader() {
+         {
+            std::lock_guard<std::mutex> g( mutex );
+            stopping = true;
+         }
+         space_cv.notify_one();
+         reader.join();
+      }
+
+      /// the next block of the log, empty after the last block, rethrows a failure of the reader
+      optional<prepared_block> next() {
+         std::unique_lock<std::mutex> lock( mutex );
+         ready_cv.wait( lock, [&]() { return !queue.empty() || done; } );
+         if( queue.empty() ) {
+            if( read_error )
+               std::rethrow_exception( read_error );
+            return optional<prepared_block>();
+         }
+         auto b = std::move( queue.front() );
+         queue.pop_front();
+         lock.unlock();
+         space_cv.notify_one();
+         return optional<prepared_block>( std::move( b ) );
+      }
+
+      /// blocks prepared but not handed out yet
+      size_t queued()const {
+         std::lock_guard<std::mutex> g( mutex );
+         return queue.size();
+      }
+
+   private:
+      void read_blocks( block_state_ptr prev ) {
+         try {
+            while( auto b = blog.read_block_by_num( prev->block_num + 1 ) ) {
+               auto state = std::make_shared<block_state>( *prev, b, skip_validate_signee );
+               auto trxs = async_thread_pool( thread_pool, [b, recover_keys = recover_keys, chain_id = chain_id, &pool = thread_pool]() {
+                  vector<transaction_metadata_ptr> trxs;
+                  trxs.reserve( b->transactions.size() );
+                  for( const auto& receipt : b->transactions ) {
+                     if( !receipt.trx.contains<packed_transaction>() )
+                        continue;
+                     auto mtrx = std::make_shared<transaction_metadata>( std::make_shared<packed_transaction>( receipt.trx.get<packed_transaction>() ) );
+                     if( recover_keys )
+                        transaction_metadata::create_signing_keys_future( mtrx, pool, chain_id, microseconds::maximum() );
+                     trxs.emplace_back( std::move( mtrx ) );
+                  }
+                  return trxs;
+               } );
+
+               std::unique_lock<std::mutex> lock( mutex );
+               space_cv.wait( lock, [&]() { return stopping || queue.size() < max_blocks; } );
+               if( stopping )
+                  break;
+               queue.push_back( prepared_block{ state, std::move( trxs ) } );
+               lock.unlock();
+               ready_cv.notify_one();
+               prev = std::move( state );
+            }
+         } catch( ... ) {
+            std::lock_guard<std::mutex> g( mutex );
+            read_error = std::current_exception();
+         }
+         {
+            std::lock_guard<std::mutex> g( mutex );
+            done = true;
+         }
+         ready_cv.notify_one();
+      }
+
+      const block_log&                 blog;
+      boost::asio::thread_pool&        thread_pool;
+      const chain_id_type              chain_id;
+      const uint32_t                   max_blocks;
+      const bool                       skip_validate_signee;
+      const bool                       recover_keys;
+
+      std::deque<prepared_block>       queue;
+      mutable std::mutex               mutex;
+      std::condition_variable          ready_cv;  ///< signalled when a block is queued or the reader is done
+      std::condition_variable          space_cv;  ///< signalled when a block is handed out or the reader should stop
+      bool                             stopping = false;
+      bool                             done = false;
+      std::exception_ptr               read_error;
+      std::thread                      reader;
+};
+
 struct controller_impl {
    controller&                    self;
    chainbase::database            db;
@@ -122,6 +249,8 @@ struct controller_impl {
    block_state_ptr                head;
    fork_database                  fork_db;
    wasm_interface                 wasmif;
+   std::unique_ptr<execution_profiler> profiler;
+   optional<conflict_graph>       last_conflict_graph;
    resource_limits_manager        resource_limits;
    authorization_manager          authorization;
    controller::config             conf;
@@ -145,6 +274,30 @@ struct controller_impl {
     */
    map<digest_type, transaction_metadata_ptr>     unapplied_transactions;
 
+   /**
+    *  Transactions of blocks passed to create_block_state_future, keyed by signed id, whose signing keys are
+    *  recovered on the thread pool while the block header is validated. apply_block takes them from here,
+    *  transactions of blocks that are never applied are dropped once they expire.
+    */
+   map<digest_type, transaction_metadata_ptr>     recovering_transactions;
+
+   /**
+    *  Header states of blocks passed to create_block_state_future that are not in the fork database yet, keyed by
+    *  block id. A block whose previous block is still being prepared chains on its future, push_block removes the
+    *  block once it is consumed, blocks that failed are dropped by the next call to either once their future is
+    *  ready and blocks that are never pushed are dropped once they become irreversible. Only blocks still being
+    *  prepared count against block_prepare_window.
+    */
+   map<block_id_type, std::shared_future<block_state_ptr>>   preparing_blocks;
+
+   /**
+    *  Ids of blocks proven to be ancestors of a light validation checkpoint, keyed by block number. Ids are proven by
+    *  walking header chains down from a checkpoint. Only the ids of the blocks following head and one anchor every
+    *  checkpoint_header_window blocks are kept, the headers between anchors are fetched again once they are needed.
+    */
+   map<uint32_t, block_id_type>   checkpoint_ancestors;
+   bool                           checkpoint_light_validation = false;
+
    void pop_block() {
       auto prev = fork_db.get_block( head->header.previous );
       EOS_ASSERT( prev, block_validate_exception, "attempt to pop beyond last irreversible block" );
@@ -177,9 +330,10 @@ struct controller_impl {
     reversible_blocks( cfg.blocks_dir/config::reversible_blocks_dir_name,
         cfg.read_only ? database::read_only : database::read_write,
         cfg.reversible_cache_size ),
-    blog( cfg.blocks_dir ),
-    fork_db( cfg.state_dir ),
-    wasmif( cfg.wasm_runtime ),
+    blog( cfg.blocks_dir, make_block_log_config( cfg ) ),
+    fork_db( cfg.state_dir, cfg.blocks_dir ),
+    wasmif( cfg.wasm_runtime, cfg.wasm_cache_size, cfg.wasm_cache_max_entries, cfg.wasm_tier_up_threshold, cfg.wasm_code_cache_dir,
+            cfg.wasm_hard_float ),
     resource_limits( db ),
     authorization( s, db ),
     conf( cfg ),
@@ -187,6 +341,11 @@ struct controller_impl {
     read_mode( cfg.read_mode ),
     thread_pool( cfg.thread_pool_size )
    {
+   if( conf.profile_actions )
+      profiler = std::make_unique<execution_profiler>();
+
+   for( const auto& id : conf.light_validation_checkpoints )
+      add_checkpoint_ancestor( id );
 
 #define SET_APP_HANDLER( receiver, contract, action) \
    set_apply_handler( #receiver, #contract, #action, &BOOST_PP_CAT(apply_, BOOST_PP_CAT(contract, BOOST_PP_CAT(_,action) ) ) )
@@ -239,6 +398,20 @@ struct controller_impl {
    }
 
    void on_irreversible( const block_state_ptr& s ) {
+      for( auto itr = recovering_transactions.begin(); itr != recovering_transactions.end(); ) {
+         if( itr->second->packed_trx->expiration() <= s->header.timestamp.to_time_point() )
+            itr = recovering_transactions.erase( itr );
+         else
+            ++itr;
+      }
+      for( auto itr = preparing_blocks.begin(); itr != preparing_blocks.end(); ) {
+         if( block_header::num_from_id( itr->first ) <= s->block_num )
+            itr = preparing_blocks.erase( itr );
+         else
+            ++itr;
+      }
+      checkpoint_ancestors.erase( checkpoint_ancestors.begin(), checkpoint_ancestors.upper_bound( s->block_num ) );
+
       if( !blog.head() )
          blog.read_head();
 
@@ -268,9 +441,12 @@ struct controller_impl {
          blog.append(s->block);
       }
 
+      // blocks queued for the block log writer keep their reversible rows until they are written, so a crash
+      // never loses an irreversible block from both
+      const auto written_block_num = std::min( s->block_num, blog.written_block_num() );
       const auto& ubi = reversible_blocks.get_index<reversible_block_index,by_num>();
       auto objitr = ubi.begin();
-      while( objitr != ubi.end() && objitr->blocknum <= s->block_num ) {
+      while( objitr != ubi.end() && objitr->blocknum <= written_block_num ) {
          reversible_blocks.remove( *objitr );
          objitr = ubi.begin();
       }
@@ -308,11 +484,40 @@ struct controller_impl {
             ("s", start_block_num)("n", blog_head->block_num()) );
 
       auto start = fc::time_point::now();
-      while( auto next = blog.read_block_by_num( head->block_num + 1 ) ) {
-         replay_push_block( next, controller::block_status::irreversible );
-         if( next->block_num() % 100 == 0 ) {
-            std::cerr << std::setw(10) << next->block_num() << " of " << blog_head->block_num() <<"\r";
-            if( shutdown() ) break;
+      if( conf.replay_read_ahead_blocks > 0 ) {
+         // irreversible blocks skip authorization checks, so their signing keys are only needed when checks are forced
+         replay_reader reader( blog, thread_pool, chain_id, head, conf.replay_read_ahead_blocks,
+                               !conf.force_all_checks, conf.force_all_checks );
+         auto last_report = start;
+         uint32_t last_report_block_num = head->block_num;
+         while( auto next = reader.next() ) {
+            for( auto& mtrx : next->trxs.get() ) {
+               auto signed_id = mtrx->signed_id;
+               recovering_transactions[signed_id] = std::move( mtrx );
+            }
+            replay_push_block( next->state->block, controller::block_status::irreversible, next->state );
+            auto block_num = next->state->block_num;
+            if( block_num % 100 == 0 ) {
+               std::cerr << std::setw(10) << block_num << " of " << blog_head->block_num() <<"\r";
+               auto now = fc::time_point::now();
+               if( now - last_report >= fc::seconds( config::replay_report_interval_sec ) ) {
+                  ilog( "replayed block ${n} of ${last}, ${bps} blocks/s, ${q} blocks read ahead",
+                        ("n", block_num)("last", blog_head->block_num())
+                        ("bps", (block_num - last_report_block_num) * 1000000ll / (now - last_report).count())
+                        ("q", reader.queued()) );
+                  last_report = now;
+                  last_report_block_num = block_num;
+               }
+               if( shutdown() ) break;
+            }
+         }
+      } else {
+         while( auto next = blog.read_block_by_num( head->block_num + 1 ) ) {
+            replay_push_block( next, controller::block_status::irreversible );
+            if( next->block_num() % 100 == 0 ) {
+               std::cerr << std::setw(10) << next->block_num() << " of " << blog_head->block_num() <<"\r";
+               if( shutdown() ) break;
+            }
          }
       }
       std::cerr<< "\n";
@@ -341,6 +546,19 @@ struct controller_impl {
    void init(std::function<bool()> shutdown, const snapshot_reader_ptr& snapshot) {
 
       bool report_integrity_hash = !!snapshot;
+
+      // the fork database journal is kept with the blocks, so it outlives a cleared state database; a state that
+      // was never initialized has revision 0 and is rebuilt from the block log or the snapshot before the forks
+      // the journal holds are restored
+      bool restore_forks = false;
+      if( head && (snapshot || db.revision() < 1) ) {
+         wlog( "setting aside the fork database up to block ${n} while the state database is rebuilt",
+               ("n", head->block_num) );
+         fork_db.set_aside_journal();
+         head.reset();
+         restore_forks = true;
+      }
+
       if (snapshot) {
          EOS_ASSERT( !head, fork_database_exception, "" );
          snapshot->validate();
@@ -372,6 +590,9 @@ struct controller_impl {
 
       if( shutdown() ) return;
 
+      if( restore_forks )
+         fork_db.restore_set_aside();
+
       const auto& ubi = reversible_blocks.get_index<reversible_block_index,by_num>();
       auto objitr = ubi.rbegin();
       if( objitr != ubi.rend() ) {
@@ -416,6 +637,7 @@ struct controller_impl {
 
       controller_index_set::add_indices(db);
       contract_database_index_set::add_indices(db);
+      db.add_index<activated_feature_index>();
 
       authorization.add_indices();
       resource_limits.add_indices();
@@ -518,6 +740,12 @@ struct controller_impl {
 
       add_contract_tables_to_snapshot(snapshot);
 
+      snapshot->write_section<activated_feature_object>([this]( auto& section ){
+         index_utils<activated_feature_index>::walk(db, [this, &section]( const auto& row ) {
+            section.add_row(row, db);
+         });
+      });
+
       authorization.add_to_snapshot(snapshot);
       resource_limits.add_to_snapshot(snapshot);
    }
@@ -562,6 +790,18 @@ struct controller_impl {
 
       read_contract_tables_from_snapshot(snapshot);
 
+      // snapshots taken before features could be activated have no section for them
+      if( snapshot->has_section<activated_feature_object>() ) {
+         snapshot->read_section<activated_feature_object>([this]( auto& section ) {
+            bool more = !section.empty();
+            while(more) {
+               index_utils<activated_feature_index>::create(db, [this, &section, &more]( auto& row ) {
+                  more = section.read_row(row, db);
+               });
+            }
+         });
+      }
+
       authorization.read_from_snapshot(snapshot);
       resource_limits.read_from_snapshot(snapshot);
 
@@ -709,6 +949,28 @@ struct controller_impl {
 
       // push the state for pending.
       pending->push();
+
+      if( conf.track_access_sets ) {
+         try {
+            report_conflict_graph();
+         } FC_LOG_AND_DROP()
+      }
+   }
+
+   void report_conflict_graph() {
+      last_conflict_graph = conflict_graph::build( pending->_pending_block_state->block_num, pending->_access_sets );
+      ilog( "block ${n}: ${t} transactions, ${e} conflicts (${r} on resource rows only), critical path ${c}",
+            ("n", last_conflict_graph->block_num)("t", last_conflict_graph->transactions)
+            ("e", last_conflict_graph->edges.size())("r", last_conflict_graph->resource_edges)
+            ("c", last_conflict_graph->critical_path) );
+   }
+
+   /// keeps the accesses of a transaction whose effects are part of the pending block
+   void record_access_set( transaction_context& trx_context ) {
+      if( trx_context.accesses ) {
+         trx_context.accesses->id = trx_context.id;
+         pending->_access_sets.emplace_back( move( *trx_context.accesses ) );
+      }
    }
 
    // The returned scoped_exit should not exceed the lifetime of the pending which existed when make_block_restore_point was called.
@@ -716,15 +978,18 @@ struct controller_impl {
       auto orig_block_transactions_size = pending->_pending_block_state->block->transactions.size();
       auto orig_state_transactions_size = pending->_pending_block_state->trxs.size();
       auto orig_state_actions_size      = pending->_actions.size();
+      auto orig_access_sets_size        = pending->_access_sets.size();
 
       std::function<void()> callback = [this,
                                         orig_block_transactions_size,
                                         orig_state_transactions_size,
-                                        orig_state_actions_size]()
+                                        orig_state_actions_size,
+                                        orig_access_sets_size]()
       {
          pending->_pending_block_state->block->transactions.resize(orig_block_transactions_size);
          pending->_pending_block_state->trxs.resize(orig_state_transactions_size);
          pending->_actions.resize(orig_state_actions_size);
+         pending->_access_sets.resize(orig_access_sets_size);
       };
 
       return fc::make_scoped_exit( std::move(callback) );
@@ -763,6 +1028,7 @@ struct controller_impl {
          trace->receipt = push_receipt( gtrx.trx_id, transaction_receipt::soft_fail,
                                         trx_context.billed_cpu_time_us, trace->net_usage );
          fc::move_append( pending->_actions, move(trx_context.executed) );
+         record_access_set( trx_context );
 
          trx_context.squash();
          restore.cancel();
@@ -889,6 +1155,7 @@ struct controller_impl {
                                         trace->net_usage );
 
          fc::move_append( pending->_actions, move(trx_context.executed) );
+         record_access_set( trx_context );
 
          emit( self.accepted_transaction, trx );
          emit( self.applied_transaction, trace );
@@ -1063,6 +1330,7 @@ struct controller_impl {
             }
 
             fc::move_append(pending->_actions, move(trx_context.executed));
+            record_access_set( trx_context );
 
             // call the accept signal but only once for this transaction
             if (!trx->accepted) {
@@ -1135,7 +1403,7 @@ struct controller_impl {
          const auto& gpo = db.get<global_property_object>();
          if( gpo.proposed_schedule_block_num.valid() && // if there is a proposed schedule that was proposed in a block ...
              ( *gpo.proposed_schedule_block_num <= pending->_pending_block_state->dpos_irreversible_blocknum ) && // ... that has now become irreversible ...
-             pending->_pending_block_state->pending_schedule.producers.size() == 0 && // ... and there is room for a new pending schedule ...
+             pending->_pending_block_state->pending_schedule->producers.size() == 0 && // ... and there is room for a new pending schedule ...
              !was_pending_promoted // ... and not just because it was promoted to active at the start of this block, then:
          )
             {
@@ -1198,6 +1466,12 @@ struct controller_impl {
          for( const auto& receipt : b->transactions ) {
             if( receipt.trx.contains<packed_transaction>()) {
                auto& pt = receipt.trx.get<packed_transaction>();
+               auto recovering = recovering_transactions.find( digest_type::hash( pt ) );
+               if( recovering != recovering_transactions.end() ) {
+                  packed_transactions.emplace_back( std::move( recovering->second ) );
+                  recovering_transactions.erase( recovering );
+                  continue;
+               }
                auto mtrx = std::make_shared<transaction_metadata>( std::make_shared<packed_transaction>( pt ) );
                if( !self.skip_auth_check() ) {
                   transaction_metadata::create_signing_keys_future( mtrx, thread_pool, chain_id, microseconds::maximum() );
@@ -1271,17 +1545,85 @@ struct controller_impl {
 
       auto id = b->id();
 
+      // a failed block is dropped before it could be handed out again in place of a valid block with the same id
+      const auto in_flight = drop_failed_preparations();
+
+      // a block prepared ahead of its application is handed out again rather than validated twice
+      auto preparing = preparing_blocks.find( id );
+      if( preparing != preparing_blocks.end() )
+         return consume_prepared_block( preparing->second );
+
       // no reason for a block_state if fork_db already knows about block
       auto existing = fork_db.get_block( id );
       EOS_ASSERT( !existing, fork_database_exception, "we already know about this block: ${id}", ("id", id) );
 
-      auto prev = fork_db.get_block( b->previous );
-      EOS_ASSERT( prev, unlinkable_block_exception, "unlinkable block ${id}", ("id", id)("previous", b->previous) );
+      std::shared_future<block_state_ptr> block_state_future;
+      if( auto prev = fork_db.get_block( b->previous ) ) {
+         block_state_future = async_thread_pool( thread_pool, [b, prev]() {
+            const bool skip_validate_signee = false;
+            return std::make_shared<block_state>( *prev, move( b ), skip_validate_signee );
+         } ).share();
+      } else {
+         auto prev_future = preparing_blocks.find( b->previous );
+         EOS_ASSERT( prev_future != preparing_blocks.end(), unlinkable_block_exception, "unlinkable block ${id}",
+                     ("id", id)("previous", b->previous) );
+         EOS_ASSERT( in_flight < conf.block_prepare_window, block_validate_exception,
+                     "${n} blocks are already being prepared ahead of block ${id}", ("n", in_flight)("id", id) );
+
+         // the thread pool runs tasks in order, so the previous block is validated or being validated when this task
+         // starts and waiting on it cannot starve the pool
+         block_state_future = async_thread_pool( thread_pool, [b, id, prev_future = prev_future->second]() {
+            block_state_ptr prev;
+            try {
+               prev = prev_future.get();
+            } catch( ... ) {
+               // reported when the previous block is pushed
+            }
+            EOS_ASSERT( prev, unlinkable_block_exception, "previous block of ${id} failed validation", ("id", id)("previous", b->previous) );
+            const bool skip_validate_signee = false;
+            return std::make_shared<block_state>( *prev, move( b ), skip_validate_signee );
+         } ).share();
+      }
+      preparing_blocks.emplace( id, block_state_future );
+
+      // queued behind the header validation so the block state is never delayed by a large block
+      if( !is_checkpoint_ancestor( id ) )
+         recover_signing_keys( *b );
+
+      return consume_prepared_block( block_state_future );
+   }
+
+   static std::future<block_state_ptr> consume_prepared_block( const std::shared_future<block_state_ptr>& f ) {
+      return std::async( std::launch::deferred, [f]() { return f.get(); } );
+   }
+
+   /**
+    *  Starts recovering the signing keys of every packed transaction of a block, one task per transaction, so
+    *  apply_block of a large block only waits for keys that are not recovered yet. Keys already recovered for a
+    *  transaction with the same signed id are reused.
+    */
+   void recover_signing_keys( const signed_block& b ) {
+      // authorization checks, and therefore signing keys, are skipped for these blocks
+      if( conf.block_validation_mode == validation_mode::LIGHT || conf.trusted_producers.count( b.producer ) )
+         return;
 
-      return async_thread_pool( thread_pool, [b, prev]() {
-         const bool skip_validate_signee = false;
-         return std::make_shared<block_state>( *prev, move( b ), skip_validate_signee );
-      } );
+      for( const auto& receipt : b.transactions ) {
+         if( !receipt.trx.contains<packed_transaction>() )
+            continue;
+         auto mtrx = std::make_shared<transaction_metadata>( std::make_shared<packed_transaction>( receipt.trx.get<packed_transaction>() ) );
+         if( recovering_transactions.count( mtrx->signed_id ) )
+            continue;
+
+         auto unapplied = unapplied_transactions.find( mtrx->signed_id );
+         if( unapplied != unapplied_transactions.end() && unapplied->second->signing_keys &&
+             unapplied->second->signing_keys->first == chain_id ) {
+            mtrx->signing_keys = unapplied->second->signing_keys;
+            mtrx->sig_cpu_usage = unapplied->second->sig_cpu_usage;
+         } else {
+            transaction_metadata::create_signing_keys_future( mtrx, thread_pool, chain_id, microseconds::maximum() );
+         }
+         recovering_transactions.emplace( mtrx->signed_id, std::move( mtrx ) );
+      }
    }
 
    void push_block( std::future<block_state_ptr>& block_state_future ) {
@@ -1291,8 +1633,20 @@ struct controller_impl {
       auto reset_prod_light_validation = fc::make_scoped_exit([old_value=trusted_producer_light_validation, this]() {
          trusted_producer_light_validation = old_value;
       });
+      auto reset_checkpoint_light_validation = fc::make_scoped_exit([old_value=checkpoint_light_validation, this]() {
+         checkpoint_light_validation = old_value;
+      });
       try {
-         block_state_ptr new_header_state = block_state_future.get();
+         block_state_ptr new_header_state;
+         try {
+            new_header_state = block_state_future.get();
+         } catch( ... ) {
+            // a block that failed validation is dropped along with the blocks prepared on top of it
+            drop_failed_preparations();
+            throw;
+         }
+         preparing_blocks.erase( new_header_state->id );
+         drop_failed_preparations();
          auto& b = new_header_state->block;
          emit( self.pre_accepted_block, b );
 
@@ -1301,6 +1655,10 @@ struct controller_impl {
          if (conf.trusted_producers.count(b->producer)) {
             trusted_producer_light_validation = true;
          };
+         // the ancestors of a checkpoint applied by a fork switch to this block are proven as well
+         if( is_checkpoint_ancestor( new_header_state->id ) ) {
+            checkpoint_light_validation = true;
+         }
          emit( self.accepted_block_header, new_header_state );
 
          if ( read_mode != db_read_mode::IRREVERSIBLE ) {
@@ -1310,7 +1668,83 @@ struct controller_impl {
       } FC_LOG_AND_RETHROW( )
    }
 
-   void replay_push_block( const signed_block_ptr& b, controller::block_status s ) {
+   uint32_t add_checkpoint_headers( const vector<signed_block_header>& headers ) {
+      const uint32_t head_num = head->block_num;
+      if( headers.empty() || headers.front().block_num() <= head_num )
+         return 0;
+
+      auto first = checkpoint_ancestors.find( headers.front().block_num() );
+      EOS_ASSERT( first != checkpoint_ancestors.end(), checkpoint_exception,
+                  "header of block ${num} is not a proven ancestor of a checkpoint", ("num", headers.front().block_num()) );
+
+      block_id_type expected = first->second;
+      uint32_t proven = 0;
+      for( const auto& h : headers ) {
+         auto num = h.block_num();
+         if( num <= head_num )
+            break;
+         auto id = h.id();
+         EOS_ASSERT( id == expected, checkpoint_exception, "header of block ${num} does not link to a checkpoint",
+                     ("num", num)("id", id)("expected", expected) );
+         if( num <= head_num + config::checkpoint_header_window || num % config::checkpoint_header_window == 0 )
+            add_checkpoint_ancestor( id );
+         expected = h.previous;
+         ++proven;
+      }
+
+      // the previous block of the last header is proven too, the following headers are requested from it
+      if( block_header::num_from_id( expected ) > head_num )
+         add_checkpoint_ancestor( expected );
+      return proven;
+   }
+
+   void add_checkpoint_ancestor( const block_id_type& id ) {
+      auto num = block_header::num_from_id( id );
+      auto itr = checkpoint_ancestors.emplace( num, id ).first;
+      EOS_ASSERT( itr->second == id, checkpoint_exception, "checkpoints disagree on block ${num}",
+                  ("num", num)("id", id)("existing", itr->second) );
+   }
+
+   block_id_type checkpoint_headers_needed()const {
+      const uint32_t head_num = head->block_num;
+      auto itr = checkpoint_ancestors.upper_bound( head_num );
+      uint32_t next = head_num + 1;
+      // the proven ids following head last for a while, more are only fetched once half a window is left
+      while( itr != checkpoint_ancestors.end() && itr->first == next && next <= head_num + config::checkpoint_header_window / 2 ) {
+         ++itr;
+         ++next;
+      }
+      if( next > head_num + config::checkpoint_header_window / 2 || itr == checkpoint_ancestors.end() )
+         return block_id_type();
+      return itr->second;
+   }
+
+   bool is_checkpoint_ancestor( const block_id_type& id )const {
+      auto itr = checkpoint_ancestors.find( block_header::num_from_id( id ) );
+      return itr != checkpoint_ancestors.end() && itr->second == id;
+   }
+
+   /// removes the preparations that failed, returns the number of preparations still in flight
+   uint32_t drop_failed_preparations() {
+      uint32_t in_flight = 0;
+      for( auto itr = preparing_blocks.begin(); itr != preparing_blocks.end(); ) {
+         if( itr->second.wait_for( std::chrono::seconds(0) ) != std::future_status::ready ) {
+            ++in_flight;
+            ++itr;
+            continue;
+         }
+         try {
+            itr->second.get();
+            ++itr;
+         } catch( ... ) {
+            itr = preparing_blocks.erase( itr );
+         }
+      }
+      return in_flight;
+   }
+
+   /// a block prepared by the replay reader was already validated against the header state of its previous block
+   void replay_push_block( const signed_block_ptr& b, controller::block_status s, const block_state_ptr& prepared = block_state_ptr() ) {
       self.validate_db_available_size();
       self.validate_reversible_available_size();
 
@@ -1322,7 +1756,7 @@ struct controller_impl {
                      block_validate_exception, "invalid block status for replay" );
          emit( self.pre_accepted_block, b );
          const bool skip_validate_signee = !conf.force_all_checks;
-         auto new_header_state = fork_db.add( b, skip_validate_signee );
+         auto new_header_state = prepared ? fork_db.add( prepared, false ) : fork_db.add( b, skip_validate_signee );
 
          emit( self.accepted_block_header, new_header_state );
 
@@ -1368,7 +1802,7 @@ struct controller_impl {
                apply_block( (*ritr)->block, (*ritr)->validated ? controller::block_status::validated : controller::block_status::complete );
                head = *ritr;
                fork_db.mark_in_current_chain( *ritr, true );
-               (*ritr)->validated = true;
+               fork_db.set_validity( *ritr, true );
             }
             catch (const fc::exception& e) { except = e; }
             if (except) {
@@ -1478,7 +1912,7 @@ struct controller_impl {
    } FC_CAPTURE_AND_RETHROW() }
 
    void update_producers_authority() {
-      const auto& producers = pending->_pending_block_state->active_schedule.producers;
+      const auto& producers = pending->_pending_block_state->active_schedule->producers;
 
       auto update_permission = [&]( auto& permission, auto threshold ) {
          auto auth = authority( threshold, {}, {});
@@ -1920,6 +2354,14 @@ signed_block_ptr controller::fetch_block_by_id( block_id_type id )const {
    return signed_block_ptr();
 }
 
+optional<signed_block_header> controller::fetch_block_header_by_id( block_id_type id )const { try {
+   auto state = my->fork_db.get_block(id);
+   if( state ) return state->header;
+   auto h = my->blog.read_block_header_by_num( block_header::num_from_id(id) );
+   if( h && h->id() == id ) return h;
+   return optional<signed_block_header>();
+} FC_CAPTURE_AND_RETHROW( (id) ) }
+
 signed_block_ptr controller::fetch_block_by_number( uint32_t block_num )const  { try {
    auto blk_state = my->fork_db.get_block_in_current_chain_by_num( block_num );
    if( blk_state && blk_state->block ) {
@@ -1984,13 +2426,13 @@ int64_t controller::set_proposed_producers( vector<producer_key> producers ) {
    decltype(sch.producers.cend()) end;
    decltype(end)                  begin;
 
-   if( my->pending->_pending_block_state->pending_schedule.producers.size() == 0 ) {
-      const auto& active_sch = my->pending->_pending_block_state->active_schedule;
+   if( my->pending->_pending_block_state->pending_schedule->producers.size() == 0 ) {
+      const auto& active_sch = *my->pending->_pending_block_state->active_schedule;
       begin = active_sch.producers.begin();
       end   = active_sch.producers.end();
       sch.version = active_sch.version + 1;
    } else {
-      const auto& pending_sch = my->pending->_pending_block_state->pending_schedule;
+      const auto& pending_sch = *my->pending->_pending_block_state->pending_schedule;
       begin = pending_sch.producers.begin();
       end   = pending_sch.producers.end();
       sch.version = pending_sch.version + 1;
@@ -2012,14 +2454,14 @@ int64_t controller::set_proposed_producers( vector<producer_key> producers ) {
 
 const producer_schedule_type&    controller::active_producers()const {
    if ( !(my->pending) )
-      return  my->head->active_schedule;
-   return my->pending->_pending_block_state->active_schedule;
+      return *my->head->active_schedule;
+   return *my->pending->_pending_block_state->active_schedule;
 }
 
 const producer_schedule_type&    controller::pending_producers()const {
    if ( !(my->pending) )
-      return  my->head->pending_schedule;
-   return my->pending->_pending_block_state->pending_schedule;
+      return *my->head->pending_schedule;
+   return *my->pending->_pending_block_state->pending_schedule;
 }
 
 optional<producer_schedule_type> controller::proposed_producers()const {
@@ -2042,7 +2484,7 @@ bool controller::light_validation_allowed(bool replay_opts_disabled_by_policy) c
 
    // OR in a signed block and in light validation mode
    const bool consider_skipping_on_validate = (pb_status == block_status::complete &&
-         (my->conf.block_validation_mode == validation_mode::LIGHT || my->trusted_producer_light_validation));
+         (my->conf.block_validation_mode == validation_mode::LIGHT || my->trusted_producer_light_validation || my->checkpoint_light_validation));
 
    return consider_skipping_on_replay || consider_skipping_on_validate;
 }
@@ -2075,6 +2517,36 @@ bool controller::contracts_console()const {
    return my->conf.contracts_console;
 }
 
+bool controller::is_native_token_code( const digest_type& code_id )const {
+   return my->conf.native_token_code_hashes.count( code_id ) > 0;
+}
+
+bool controller::wasm_hard_float()const {
+   return my->wasmif.hard_float();
+}
+
+void controller::activate_feature( account_name feature_name ) {
+   EOS_ASSERT( my->pending, block_validate_exception, "no pending block" );
+   EOS_ASSERT( feature_name == config::db_scan_feature_name, unsupported_feature,
+               "Unsupported Hardfork Detected: ${f} is not a known feature", ("f", feature_name) );
+   EOS_ASSERT( !my->db.find<activated_feature_object, by_feature_name>( feature_name ), unsupported_feature,
+               "feature ${f} is already activated", ("f", feature_name) );
+   my->db.create<activated_feature_object>( [&]( auto& f ) {
+      f.feature_name = feature_name;
+      f.activation_block_num = my->pending->_pending_block_state->block_num + 1;
+   });
+}
+
+bool controller::is_feature_active( account_name feature_name )const {
+   EOS_ASSERT( my->pending, block_validate_exception, "no pending block" );
+   auto f = my->db.find<activated_feature_object, by_feature_name>( feature_name );
+   return f && my->pending->_pending_block_state->block_num >= f->activation_block_num;
+}
+
+bool controller::is_db_scan_active()const {
+   return is_feature_active( config::db_scan_feature_name );
+}
+
 chain_id_type controller::get_chain_id()const {
    return my->chain_id;
 }
@@ -2087,6 +2559,22 @@ validation_mode controller::get_validation_mode()const {
    return my->conf.block_validation_mode;
 }
 
+uint32_t controller::get_block_prepare_window()const {
+   return my->conf.block_prepare_window;
+}
+
+uint32_t controller::add_checkpoint_headers( const vector<signed_block_header>& headers ) {
+   return my->add_checkpoint_headers( headers );
+}
+
+block_id_type controller::checkpoint_headers_needed()const {
+   return my->checkpoint_headers_needed();
+}
+
+bool controller::is_checkpoint_ancestor( const block_id_type& id )const {
+   return my->is_checkpoint_ancestor( id );
+}
+
 const apply_handler* controller::find_apply_handler( account_name receiver, account_name scope, action_name act ) const
 {
    auto native_handler_scope = my->apply_handlers.find( receiver );
@@ -2101,6 +2589,18 @@ wasm_interface& controller::get_wasm_interface() {
    return my->wasmif;
 }
 
+execution_profiler* controller::get_execution_profiler() {
+   return my->profiler.get();
+}
+
+bool controller::tracks_access_sets()const {
+   return my->conf.track_access_sets;
+}
+
+const optional<conflict_graph>& controller::last_conflict_graph()const {
+   return my->last_conflict_graph;
+}
+
 const account_object& controller::get_account( account_name name )const
 { try {
    return my->db.get<account_object, by_name>(name);
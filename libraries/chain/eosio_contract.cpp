@@ -139,7 +139,7 @@ void apply_eosio_setcode(apply_context& context) {
 
    if( act.code.size() > 0 ) {
      code_id = fc::sha256::hash( act.code.data(), (uint32_t)act.code.size() );
-     wasm_interface::validate(context.control, act.code);
+     context.control.get_wasm_interface().validate(context.control, code_id, act.code);
    }
 
    const auto& account = db.get<account_object,by_name>(act.account);
@@ -170,6 +170,11 @@ void apply_eosio_setcode(apply_context& context) {
    if (new_size != old_size) {
       context.add_ram_usage( act.account, new_size - old_size );
    }
+
+   // take instantiation off the critical path of the first action that runs this code
+   if( code_size > 0 ) {
+      context.control.get_wasm_interface().compile_async( code_id, context.control.get_thread_pool() );
+   }
 }
 
 void apply_eosio_setabi(apply_context& context) {
@@ -0,0 +1,161 @@
+/**
+ *  @file
+ *  @copyright defined in eos/LICENSE
+ */
+#include <eosio/chain/execution_profiler.hpp>
+
+#include <algorithm>
+#include <atomic>
+
+namespace eosio { namespace chain {
+
+   action_profile& action_profile::operator+=( const action_profile& other ) {
+      calls        += other.calls;
+      failures     += other.failures;
+      wall_time    += other.wall_time;
+      billed_cpu   += other.billed_cpu;
+      compile_time += other.compile_time;
+      db_calls     += other.db_calls;
+      ram_delta    += other.ram_delta;
+      return *this;
+   }
+
+   action_profile& action_profile::operator-=( const action_profile& other ) {
+      calls        -= other.calls;
+      failures     -= other.failures;
+      wall_time    -= other.wall_time;
+      billed_cpu   -= other.billed_cpu;
+      compile_time -= other.compile_time;
+      db_calls     -= other.db_calls;
+      ram_delta    -= other.ram_delta;
+      return *this;
+   }
+
+   namespace {
+      /// counters of one (receiver, action) pair, written only by the thread owning their shard
+      struct profile_counters {
+         explicit profile_counters( const std::pair<account_name, action_name>& key ) : key(key) {}
+
+         const std::pair<account_name, action_name>  key;
+         std::atomic<uint64_t>                       calls{0};
+         std::atomic<uint64_t>                       failures{0};
+         std::atomic<int64_t>                        wall_time{0};
+         std::atomic<int64_t>                        billed_cpu{0};
+         std::atomic<int64_t>                        compile_time{0};
+         std::atomic<uint64_t>                       db_calls{0};
+         std::atomic<int64_t>                        ram_delta{0};
+         profile_counters*                           next = nullptr; ///< fixed before the counters are published
+
+         action_profile load()const {
+            action_profile p;
+            p.calls        = calls.load( std::memory_order_relaxed );
+            p.failures     = failures.load( std::memory_order_relaxed );
+            p.wall_time    = fc::microseconds( wall_time.load( std::memory_order_relaxed ) );
+            p.billed_cpu   = fc::microseconds( billed_cpu.load( std::memory_order_relaxed ) );
+            p.compile_time = fc::microseconds( compile_time.load( std::memory_order_relaxed ) );
+            p.db_calls     = db_calls.load( std::memory_order_relaxed );
+            p.ram_delta    = ram_delta.load( std::memory_order_relaxed );
+            return p;
+         }
+      };
+
+      /// the single writer needs no read-modify-write, readers only ever see whole values
+      template<typename T>
+      void add( std::atomic<T>& counter, T value ) {
+         counter.store( counter.load( std::memory_order_relaxed ) + value, std::memory_order_relaxed );
+      }
+   }
+
+   struct execution_profiler::shard {
+      std::atomic<profile_counters*>                                      head{nullptr}; ///< published counters, newest first
+      flat_map<std::pair<account_name, action_name>, profile_counters*>  index;         ///< used by the owning thread only
+
+      ~shard() {
+         for( auto c = head.load(); c; ) {
+            auto next = c->next;
+            delete c;
+            c = next;
+         }
+      }
+   };
+
+   static std::atomic<uint64_t> next_profiler_id{0};
+
+   execution_profiler::execution_profiler()
+   :id(++next_profiler_id) {}
+
+   execution_profiler::~execution_profiler() {}
+
+   execution_profiler::shard& execution_profiler::local_shard() {
+      // profilers are identified by a unique id rather than their address, which a later profiler may reuse
+      thread_local flat_map<uint64_t, std::weak_ptr<shard>> local_shards;
+
+      auto itr = local_shards.find( id );
+      if( itr != local_shards.end() ) {
+         if( auto s = itr->second.lock() )
+            return *s;
+      }
+
+      auto s = std::make_shared<shard>();
+      {
+         std::lock_guard<std::mutex> g( shards_mutex );
+         shards.push_back( s );
+      }
+      local_shards[id] = s;
+      return *s;
+   }
+
+   void execution_profiler::record( account_name receiver, action_name action, const action_profile& sample ) {
+      shard& s = local_shard();
+      const auto key = std::make_pair( receiver, action );
+      profile_counters*& c = s.index[key];
+      if( !c ) {
+         c = new profile_counters( key );
+         c->next = s.head.load( std::memory_order_relaxed );
+         s.head.store( c, std::memory_order_release );
+      }
+      add( c->calls,        sample.calls );
+      add( c->failures,     sample.failures );
+      add( c->wall_time,    sample.wall_time.count() );
+      add( c->billed_cpu,   sample.billed_cpu.count() );
+      add( c->compile_time, sample.compile_time.count() );
+      add( c->db_calls,     sample.db_calls );
+      add( c->ram_delta,    sample.ram_delta );
+   }
+
+   flat_map<std::pair<account_name, action_name>, action_profile> execution_profiler::totals()const {
+      flat_map<std::pair<account_name, action_name>, action_profile> merged;
+      for( const auto& s : shards ) {
+         for( auto c = s->head.load( std::memory_order_acquire ); c; c = c->next )
+            merged[c->key] += c->load();
+      }
+      return merged;
+   }
+
+   vector<action_profile_entry> execution_profiler::snapshot()const {
+      flat_map<std::pair<account_name, action_name>, action_profile> merged;
+      {
+         std::lock_guard<std::mutex> g( shards_mutex );
+         merged = totals();
+         for( const auto& b : baseline )
+            merged[b.first] -= b.second;
+      }
+
+      vector<action_profile_entry> result;
+      result.reserve( merged.size() );
+      for( const auto& m : merged ) {
+         if( m.second.calls > 0 )
+            result.push_back( action_profile_entry{ m.first.first, m.first.second, m.second } );
+      }
+      std::sort( result.begin(), result.end(), []( const action_profile_entry& a, const action_profile_entry& b ) {
+         return a.profile.wall_time > b.profile.wall_time;
+      } );
+      return result;
+   }
+
+   void execution_profiler::reset() {
+      std::lock_guard<std::mutex> g( shards_mutex );
+      baseline = totals();
+   }
+
+} } // eosio::chain
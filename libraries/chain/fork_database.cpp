@@ -7,7 +7,14 @@
 #include <boost/multi_index/mem_fun.hpp>
 #include <boost/multi_index/composite_key.hpp>
 #include <fc/io/fstream.hpp>
+#include <boost/filesystem/operations.hpp>
 #include <fstream>
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+#include <fcntl.h>
+#include <unistd.h>
 
 namespace eosio { namespace chain {
    using boost::multi_index_container;
@@ -42,21 +49,237 @@ namespace eosio { namespace chain {
    > fork_multi_index_type;
 
 
+   /**
+    * The fork database is persisted as an append only journal of its changes, each record being the size of the
+    * rest of the record, its type and its content. Replaying the journal rebuilds the fork database, and once
+    * the journal holds enough records that no longer describe the fork database, it is compacted into the
+    * records of the block states it currently holds.
+    */
+   enum class journal_record : uint8_t {
+      state,        ///< a block state added to the fork database
+      erase,        ///< the id of a block state removed from the fork database
+      status,       ///< the id, validated, in_current_chain and bft_irreversible_blocknum of a block state
+      confirmation, ///< a header_confirmation added to a block state
+      head          ///< the id of the head
+   };
+
+   /// commits the written data of a file, its metadata is only synced where the platform cannot leave it out
+   static int sync_data( int fd ) {
+#if defined( __APPLE__ )
+      return ::fsync( fd );
+#else
+      return ::fdatasync( fd );
+#endif
+   }
+
+   /// the journal is compacted when it holds more records than this, plus the factor times the block states
+   static const uint64_t journal_compaction_min_records = 1024;
+   static const uint64_t journal_compaction_factor      = 4;
+
    struct fork_database_impl {
       fork_multi_index_type index;
       block_state_ptr       head;
       fc::path              datadir;
+
+      fc::path              journal_file;
+      std::ofstream         journal;
+      int                   journal_fd = -1;         ///< descriptor of the journal used to sync it
+      bool                  journal_dirty = false;   ///< records were written since the last commit
+      uint64_t              journal_records = 0;
+      vector<block_state_ptr> set_aside;             ///< block states set aside while the state is rebuilt
+
+      template<typename... T>
+      void append_record( journal_record type, const T&... content ) {
+         if( !journal.is_open() )
+            return;
+         fc::datastream<size_t> sizer;
+         (void)std::initializer_list<int>{ (fc::raw::pack( sizer, content ), 0)... };
+         const uint32_t size = sizeof(uint8_t) + sizer.tellp();
+         vector<char> data( sizeof(size) + size );
+         fc::datastream<char*> ds( data.data(), data.size() );
+         fc::raw::pack( ds, size );
+         fc::raw::pack( ds, static_cast<uint8_t>(type) );
+         (void)std::initializer_list<int>{ (fc::raw::pack( ds, content ), 0)... };
+         journal.write( data.data(), data.size() );
+         journal_dirty = true;
+         ++journal_records;
+      }
+
+      void append_status( const block_state& s ) {
+         append_record( journal_record::status, s.id, s.validated, s.in_current_chain, s.bft_irreversible_blocknum );
+      }
+
+      void append_head() {
+         append_record( journal_record::head, head ? head->id : block_id_type() );
+      }
+
+      void replay_journal();
+      void open_journal( const fc::path& file );
+      void commit_journal();
+      void close_journal();
+      void compact_journal();
+      void maybe_compact_journal() {
+         if( journal.is_open() && journal_records > journal_compaction_min_records + journal_compaction_factor * index.size() )
+            compact_journal();
+      }
    };
 
+   /// applies the records of the journal, cutting off an incomplete record at its end; any other damage throws
+   void fork_database_impl::replay_journal() {
+      string content;
+      fc::read_file_contents( journal_file, content );
+
+      uint64_t good_size = 0;
+      while( content.size() - good_size >= sizeof(uint32_t) ) {
+         fc::datastream<const char*> ds( content.data() + good_size, content.size() - good_size );
+         uint32_t size = 0;
+         fc::raw::unpack( ds, size );
+         if( size > ds.remaining() )
+            break;
+         try {
+            EOS_ASSERT( size > 0, fork_database_exception, "empty record" );
+            fc::datastream<const char*> rds( ds.pos(), size );
+            uint8_t type = 0;
+            fc::raw::unpack( rds, type );
+            block_id_type id;
+            switch( static_cast<journal_record>(type) ) {
+               case journal_record::state: {
+                  auto s = std::make_shared<block_state>();
+                  fc::raw::unpack( rds, *s );
+                  index.erase( s->id );
+                  index.insert( s );
+                  break;
+               }
+               case journal_record::erase:
+                  fc::raw::unpack( rds, id );
+                  index.erase( id );
+                  break;
+               case journal_record::status: {
+                  bool validated = false, in_current_chain = false;
+                  uint32_t bft_irreversible_blocknum = 0;
+                  fc::raw::unpack( rds, id );
+                  fc::raw::unpack( rds, validated );
+                  fc::raw::unpack( rds, in_current_chain );
+                  fc::raw::unpack( rds, bft_irreversible_blocknum );
+                  auto itr = index.find( id );
+                  if( itr != index.end() ) {
+                     index.modify( itr, [&]( auto& bsp ) {
+                        bsp->validated = validated;
+                        bsp->in_current_chain = in_current_chain;
+                        bsp->bft_irreversible_blocknum = bft_irreversible_blocknum;
+                     });
+                  }
+                  break;
+               }
+               case journal_record::confirmation: {
+                  header_confirmation c;
+                  fc::raw::unpack( rds, c );
+                  auto itr = index.find( c.block_id );
+                  if( itr != index.end() )
+                     (*itr)->confirmations.emplace_back( c );
+                  break;
+               }
+               case journal_record::head:
+                  fc::raw::unpack( rds, id );
+                  {
+                     auto itr = index.find( id );
+                     head = itr != index.end() ? *itr : block_state_ptr();
+                  }
+                  break;
+               default:
+                  EOS_THROW( fork_database_exception, "unknown fork database journal record ${t}", ("t", static_cast<uint32_t>(type)) );
+            }
+            EOS_ASSERT( rds.remaining() == 0, fork_database_exception, "record is longer than its content" );
+         } catch( const fc::exception& e ) {
+            // only the end of the journal can be cut off by a crash, anything before it was written completely
+            EOS_THROW( fork_database_exception,
+                       "fork database journal ${file} is corrupt at ${pos}, remove it and replay: ${e}",
+                       ("file", journal_file)("pos", good_size)("e", e.to_detail_string()) );
+         }
+         good_size += sizeof(size) + size;
+         ++journal_records;
+      }
+      if( !head && !index.empty() )
+         head = *index.get<by_lib_block_num>().begin();
 
-   fork_database::fork_database( const fc::path& data_dir ):my( new fork_database_impl() ) {
+      if( good_size == content.size() )
+         return;
+      wlog( "discarding ${n} bytes at the end of the fork database journal, likely written before a crash",
+            ("n", content.size() - good_size) );
+      boost::filesystem::resize_file( journal_file.generic_string(), good_size );
+   }
+
+   void fork_database_impl::open_journal( const fc::path& file ) {
+      journal.exceptions( std::ofstream::failbit | std::ofstream::badbit );
+      journal.open( file.generic_string().c_str(), std::ios::out | std::ios::binary | std::ios::app );
+      journal_fd = ::open( file.generic_string().c_str(), O_RDONLY );
+      if( journal_fd < 0 ) {
+         journal.close();
+         EOS_THROW( fork_database_exception, "unable to open ${file} for fsync", ("file", file) );
+      }
+   }
+
+   /**
+    * Makes the records written since the last commit durable. Every public mutator commits once when it is done,
+    * so the records of one change, like a block added together with the blocks it prunes, share a single sync.
+    */
+   void fork_database_impl::commit_journal() {
+      if( !journal_dirty || !journal.is_open() )
+         return;
+      journal.flush();
+      EOS_ASSERT( sync_data( journal_fd ) == 0, fork_database_exception,
+                  "fsync of ${file} failed: ${e}", ("file", journal_file)("e", strerror( errno )) );
+      journal_dirty = false;
+   }
+
+   void fork_database_impl::close_journal() {
+      if( !journal.is_open() )
+         return;
+      commit_journal();
+      journal.close();
+      ::close( journal_fd );
+      journal_fd = -1;
+   }
+
+   /// rewrites the journal as the records of the current block states, replacing the old journal atomically
+   void fork_database_impl::compact_journal() {
+      // the rewritten journal holds every record not yet committed
+      journal_dirty = false;
+      close_journal();
+
+      auto tmp_file = journal_file;
+      tmp_file.replace_extension( ".tmp" );
+      fc::remove_all( tmp_file );
+      open_journal( tmp_file );
+      journal_records = 0;
+      for( const auto& s : index.get<by_block_num>() )
+         append_record( journal_record::state, *s );
+      append_head();
+      close_journal();
+
+      fc::rename( tmp_file, journal_file );
+      // sync the directory so the rename survives a crash
+      int fd = ::open( journal_file.parent_path().generic_string().c_str(), O_RDONLY );
+      EOS_ASSERT( fd >= 0, fork_database_exception, "unable to open ${dir} for fsync", ("dir", journal_file.parent_path()) );
+      int r = ::fsync( fd );
+      ::close( fd );
+      EOS_ASSERT( r == 0, fork_database_exception, "fsync of ${dir} failed", ("dir", journal_file.parent_path()) );
+      open_journal( journal_file );
+   }
+
+   fork_database::fork_database( const fc::path& data_dir, const fc::path& journal_dir ):my( new fork_database_impl() ) {
       my->datadir = data_dir;
+      my->journal_file = (journal_dir.empty() ? data_dir : journal_dir) / config::forkdb_journal_filename;
 
       if (!fc::is_directory(my->datadir))
          fc::create_directories(my->datadir);
+      if (!fc::is_directory(my->journal_file.parent_path()))
+         fc::create_directories(my->journal_file.parent_path());
 
+      bool compact = false;
       auto fork_db_dat = my->datadir / config::forkdb_filename;
       if( fc::exists( fork_db_dat ) ) {
+         // written on shutdown by versions without the journal
          string content;
          fc::read_file_contents( fork_db_dat, content );
 
@@ -73,23 +296,23 @@ namespace eosio { namespace chain {
          my->head = get_block( head_id );
 
          fc::remove( fork_db_dat );
+         compact = true;
       }
+
+      if( fc::exists( my->journal_file ) )
+         my->replay_journal();
+
+      if( compact || my->journal_records > journal_compaction_min_records + journal_compaction_factor * my->index.size() )
+         my->compact_journal();
+      else
+         my->open_journal( my->journal_file );
    }
 
    void fork_database::close() {
-      if( my->index.size() == 0 ) return;
+      // the journal holds the fork database as it is now, the irreversible block pruned below is kept in it
+      my->close_journal();
 
-      auto fork_db_dat = my->datadir / config::forkdb_filename;
-      std::ofstream out( fork_db_dat.generic_string().c_str(), std::ios::out | std::ios::binary | std::ofstream::trunc );
-      uint32_t num_blocks_in_fork_db = my->index.size();
-      fc::raw::pack( out, unsigned_int{num_blocks_in_fork_db} );
-      for( const auto& s : my->index ) {
-         fc::raw::pack( out, *s );
-      }
-      if( my->head )
-         fc::raw::pack( out, my->head->id );
-      else
-         fc::raw::pack( out, block_id_type() );
+      if( my->index.size() == 0 ) return;
 
       /// we don't normally indicate the head block as irreversible
       /// we cannot normally prune the lib if it is the head block because
@@ -108,6 +331,29 @@ namespace eosio { namespace chain {
       close();
    }
 
+   void fork_database::set_aside_journal() {
+      my->set_aside.assign( my->index.begin(), my->index.end() );
+      std::sort( my->set_aside.begin(), my->set_aside.end(),
+                 []( const block_state_ptr& a, const block_state_ptr& b ) { return a->block_num < b->block_num; } );
+      my->index.clear();
+      my->head.reset();
+      // the journal starts over so it follows the rebuilt state if the rebuild is interrupted
+      my->compact_journal();
+   }
+
+   void fork_database::restore_set_aside() {
+      // in block number order, so a block state is restored before the block states building on it
+      for( const auto& s : my->set_aside ) {
+         if( my->index.find( s->id ) != my->index.end() || my->index.find( s->header.previous ) == my->index.end() )
+            continue;
+         s->in_current_chain = false;
+         my->index.insert( s );
+         my->append_record( journal_record::state, *s );
+      }
+      my->set_aside.clear();
+      my->commit_journal();
+   }
+
    void fork_database::set( block_state_ptr s ) {
       auto result = my->index.insert( s );
       EOS_ASSERT( s->id == s->header.id(), fork_database_exception, 
@@ -116,11 +362,14 @@ namespace eosio { namespace chain {
          //FC_ASSERT( s->block_num == s->header.block_num() );
 
       EOS_ASSERT( result.second, fork_database_exception, "unable to insert block state, duplicate state detected" );
+      my->append_record( journal_record::state, *s );
       if( !my->head ) {
          my->head =  s;
       } else if( my->head->block_num < s->block_num ) {
          my->head =  s;
       }
+      my->append_head();
+      my->commit_journal();
    }
 
    block_state_ptr fork_database::add( const block_state_ptr& n, bool skip_validate_previous ) {
@@ -135,8 +384,12 @@ namespace eosio { namespace chain {
 
       auto inserted = my->index.insert(n);
       EOS_ASSERT( inserted.second, fork_database_exception, "duplicate block added?" );
+      my->append_record( journal_record::state, *n );
 
+      auto prior_head = my->head;
       my->head = *my->index.get<by_lib_block_num>().begin();
+      if( my->head != prior_head )
+         my->append_head();
 
       auto lib    = my->head->dpos_irreversible_blocknum;
       auto oldest = *my->index.get<by_block_num>().begin();
@@ -144,6 +397,8 @@ namespace eosio { namespace chain {
       if( oldest->block_num < lib ) {
          prune( oldest );
       }
+      my->maybe_compact_journal();
+      my->commit_journal();
 
       return n;
    }
@@ -215,8 +470,10 @@ namespace eosio { namespace chain {
 
       for( uint32_t i = 0; i < remove_queue.size(); ++i ) {
          auto itr = my->index.find( remove_queue[i] );
-         if( itr != my->index.end() )
+         if( itr != my->index.end() ) {
             my->index.erase(itr);
+            my->append_record( journal_record::erase, remove_queue[i] );
+         }
 
          auto& previdx = my->index.get<by_prev>();
          auto  previtr = previdx.lower_bound(remove_queue[i]);
@@ -227,6 +484,8 @@ namespace eosio { namespace chain {
       }
       //wdump((my->index.size()));
       my->head = *my->index.get<by_lib_block_num>().begin();
+      my->append_head();
+      my->commit_journal();
    }
 
    void fork_database::set_validity( const block_state_ptr& h, bool valid ) {
@@ -234,8 +493,13 @@ namespace eosio { namespace chain {
          remove( h->id );
       } else {
          /// remove older than irreversible and mark block as valid
-         h->validated = true;
+         if( !h->validated ) {
+            h->validated = true;
+            if( my->index.find( h->id ) != my->index.end() )
+               my->append_status( *h );
+         }
       }
+      my->commit_journal();
    }
 
    void fork_database::mark_in_current_chain( const block_state_ptr& h, bool in_current_chain ) {
@@ -249,6 +513,8 @@ namespace eosio { namespace chain {
       by_id_idx.modify( itr, [&]( auto& bsp ) { // Need to modify this way rather than directly so that Boost MultiIndex can re-sort
          bsp->in_current_chain = in_current_chain;
       });
+      my->append_status( **itr );
+      my->commit_journal();
    }
 
    void fork_database::prune( const block_state_ptr& h ) {
@@ -265,6 +531,7 @@ namespace eosio { namespace chain {
       if( itr != my->index.end() ) {
          irreversible(*itr);
          my->index.erase(itr);
+         my->append_record( journal_record::erase, h->id );
       }
 
       auto& numidx = my->index.get<by_block_num>();
@@ -275,6 +542,7 @@ namespace eosio { namespace chain {
          auto id = (*itr_to_remove)->id;
          remove( id );
       }
+      my->commit_journal();
    }
 
    block_state_ptr   fork_database::get_block(const block_id_type& id)const {
@@ -301,11 +569,13 @@ namespace eosio { namespace chain {
       auto b = get_block( c.block_id );
       EOS_ASSERT( b, fork_db_block_not_found, "unable to find block id ${id}", ("id",c.block_id));
       b->add_confirmation( c );
+      my->append_record( journal_record::confirmation, c );
 
       if( b->bft_irreversible_blocknum < b->block_num &&
-         b->confirmations.size() >= ((b->active_schedule.producers.size() * 2) / 3 + 1) ) {
+         b->confirmations.size() >= ((b->active_schedule->producers.size() * 2) / 3 + 1) ) {
          set_bft_irreversible( c.block_id );
       }
+      my->commit_journal();
    }
 
    /**
@@ -322,6 +592,7 @@ namespace eosio { namespace chain {
       idx.modify( itr, [&]( auto& bsp ) {
            bsp->bft_irreversible_blocknum = bsp->block_num;
       });
+      my->append_status( **itr );
 
       /** to prevent stack-overflow, we perform a bredth-first traversal of the
        * fork database. At each stage we iterate over the leafs from the prior stage
@@ -341,6 +612,7 @@ namespace eosio { namespace chain {
                  if( bsp->bft_irreversible_blocknum < block_num ) {
                     bsp->bft_irreversible_blocknum = block_num;
                     updated.push_back( bsp->id );
+                    my->append_status( *bsp );
                  }
                });
                ++pitr;
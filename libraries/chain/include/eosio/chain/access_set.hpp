@@ -0,0 +1,105 @@
+/**
+ *  @file
+ *  @copyright defined in eos/LICENSE
+ */
+#pragma once
+#include <eosio/chain/types.hpp>
+
+#include <limits>
+#include <tuple>
+
+namespace eosio { namespace chain {
+
+   /**
+    *  Inclusive range of primary keys of one index of a contract table.
+    *
+    *  Secondary indices are addressed by the primary keys of their rows. The existence of the table itself, which
+    *  decides between the -1 and end iterators and changes when a table is created or its last row is removed, is
+    *  modeled as the single key 0 of the pseudo index table_index.
+    */
+   struct table_key_range {
+      static constexpr uint8_t  primary_index         = 0;
+      static constexpr uint8_t  idx64_index           = 1;
+      static constexpr uint8_t  idx128_index          = 2;
+      static constexpr uint8_t  idx256_index          = 3;
+      static constexpr uint8_t  idx_double_index      = 4;
+      static constexpr uint8_t  idx_long_double_index = 5;
+      static constexpr uint8_t  table_index           = 0xff;
+      static constexpr uint64_t max_key               = std::numeric_limits<uint64_t>::max();
+
+      account_name   code;
+      scope_name     scope;
+      table_name     table;
+      uint8_t        index = primary_index;
+      uint64_t       lower = 0;
+      uint64_t       upper = 0;
+
+      bool same_index( const table_key_range& other )const {
+         return code == other.code && scope == other.scope && table == other.table && index == other.index;
+      }
+
+      bool overlaps( const table_key_range& other )const {
+         return same_index( other ) && lower <= other.upper && other.lower <= upper;
+      }
+
+      friend bool operator < ( const table_key_range& a, const table_key_range& b ) {
+         return std::tie( a.code, a.scope, a.table, a.index, a.lower, a.upper )
+              < std::tie( b.code, b.scope, b.table, b.index, b.lower, b.upper );
+      }
+   };
+
+   /**
+    *  Contract table keys read and written by one transaction, and the accounts whose resource rows it updates.
+    *
+    *  Ranges are recorded conservatively: a lookup reads every key between the one it was given and the row it
+    *  returned, and a lookup by secondary key reads the whole secondary index. Sequence numbers of action receipts
+    *  are not recorded, they are assigned in block order regardless of how transactions are executed.
+    */
+   struct access_set {
+      transaction_id_type        id;
+      vector<table_key_range>    reads;
+      vector<table_key_range>    writes;
+      flat_set<account_name>     resource_accounts;
+
+      void read( account_name code, scope_name scope, table_name table, uint8_t index, uint64_t lower, uint64_t upper ) {
+         add( reads, table_key_range{ code, scope, table, index, lower, upper } );
+      }
+
+      void write( account_name code, scope_name scope, table_name table, uint8_t index, uint64_t lower, uint64_t upper ) {
+         add( writes, table_key_range{ code, scope, table, index, lower, upper } );
+      }
+
+      /// sorts the ranges and merges the overlapping or adjacent ones, required by conflicts_with
+      void normalize();
+
+      /// true when either transaction writes a key the other reads or writes, or both update a resource row
+      bool conflicts_with( const access_set& other )const;
+
+      private:
+         /// extends the last range when contiguous with the new one, which keeps a scan through a table to one range
+         static void add( vector<table_key_range>& ranges, const table_key_range& r );
+   };
+
+   /**
+    *  Conflicts between the transactions of a block, in block order.
+    *
+    *  An edge (i, j) with i < j means transaction j has to observe the effects of transaction i. critical_path is
+    *  the number of transactions in the longest chain of edges, the least number of rounds in which the block could
+    *  be executed in parallel with the same result.
+    */
+   struct conflict_graph {
+      uint32_t                             block_num = 0;
+      uint32_t                             transactions = 0;
+      vector<std::pair<uint32_t,uint32_t>> edges;
+      uint32_t                             resource_edges = 0; ///< edges due to resource rows alone
+      uint32_t                             critical_path = 0;
+
+      /// normalizes every set
+      static conflict_graph build( uint32_t block_num, vector<access_set>& sets );
+   };
+
+} } // eosio::chain
+
+FC_REFLECT( eosio::chain::table_key_range, (code)(scope)(table)(index)(lower)(upper) )
+FC_REFLECT( eosio::chain::access_set, (id)(reads)(writes)(resource_accounts) )
+FC_REFLECT( eosio::chain::conflict_graph, (block_num)(transactions)(edges)(resource_edges)(critical_path) )
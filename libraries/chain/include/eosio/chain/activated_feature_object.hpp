@@ -0,0 +1,37 @@
+/**
+ *  @file
+ *  @copyright defined in eos/LICENSE
+ */
+#pragma once
+#include <eosio/chain/types.hpp>
+
+#include "multi_index_includes.hpp"
+
+namespace eosio { namespace chain {
+
+   /**
+    * A consensus feature a privileged contract activated with activate_feature. It is in effect from the block
+    * following the one that activated it, so every node applying the chain agrees on when it starts.
+    */
+   class activated_feature_object : public chainbase::object<activated_feature_object_type, activated_feature_object> {
+      OBJECT_CTOR(activated_feature_object)
+
+      id_type        id;
+      account_name   feature_name;
+      uint32_t       activation_block_num = 0;
+   };
+
+   struct by_feature_name;
+   using activated_feature_index = chainbase::shared_multi_index_container<
+      activated_feature_object,
+      indexed_by<
+         ordered_unique<tag<by_id>, member<activated_feature_object, activated_feature_object::id_type, &activated_feature_object::id>>,
+         ordered_unique<tag<by_feature_name>, member<activated_feature_object, account_name, &activated_feature_object::feature_name>>
+      >
+   >;
+
+} } // eosio::chain
+
+CHAINBASE_SET_INDEX_TYPE(eosio::chain::activated_feature_object, eosio::chain::activated_feature_index)
+
+FC_REFLECT(eosio::chain::activated_feature_object, (feature_name)(activation_block_num))
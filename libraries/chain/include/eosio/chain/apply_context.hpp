@@ -6,6 +6,8 @@
 #include <eosio/chain/controller.hpp>
 #include <eosio/chain/transaction.hpp>
 #include <eosio/chain/contract_table_objects.hpp>
+#include <eosio/chain/execution_profiler.hpp>
+#include <eosio/chain/open_address_map.hpp>
 #include <fc/utility.hpp>
 #include <sstream>
 #include <algorithm>
@@ -30,26 +32,25 @@ class apply_context {
 
             /// Returns end iterator of the table.
             int cache_table( const table_id_object& tobj ) {
-               auto itr = _table_cache.find(tobj.id);
-               if( itr != _table_cache.end() )
-                  return itr->second.second;
+               if( auto cached = _table_cache.find( tobj.id._id ) )
+                  return cached->second;
 
                auto ei = index_to_end_iterator(_end_iterator_to_table.size());
                _end_iterator_to_table.push_back( &tobj );
-               _table_cache.emplace( tobj.id, make_pair(&tobj, ei) );
+               _table_cache.insert( tobj.id._id, make_pair(&tobj, ei) );
                return ei;
             }
 
             const table_id_object& get_table( table_id_object::id_type i )const {
-               auto itr = _table_cache.find(i);
-               EOS_ASSERT( itr != _table_cache.end(), table_not_in_cache, "an invariant was broken, table should be in cache" );
-               return *itr->second.first;
+               auto cached = _table_cache.find( i._id );
+               EOS_ASSERT( cached, table_not_in_cache, "an invariant was broken, table should be in cache" );
+               return *cached->first;
             }
 
             int get_end_iterator_by_table_id( table_id_object::id_type i )const {
-               auto itr = _table_cache.find(i);
-               EOS_ASSERT( itr != _table_cache.end(), table_not_in_cache, "an invariant was broken, table should be in cache" );
-               return itr->second.second;
+               auto cached = _table_cache.find( i._id );
+               EOS_ASSERT( cached, table_not_in_cache, "an invariant was broken, table should be in cache" );
+               return cached->second;
             }
 
             const table_id_object* find_table_by_end_iterator( int ei )const {
@@ -75,25 +76,34 @@ class apply_context {
                auto obj_ptr = _iterator_to_object[iterator];
                if( !obj_ptr ) return;
                _iterator_to_object[iterator] = nullptr;
-               _object_to_iterator.erase( obj_ptr );
+               _object_to_iterator.erase( object_key( obj_ptr ) );
             }
 
             int add( const T& obj ) {
-               auto itr = _object_to_iterator.find( &obj );
-               if( itr != _object_to_iterator.end() )
-                    return itr->second;
+               if( auto cached = _object_to_iterator.find( object_key( &obj ) ) )
+                  return *cached;
 
                _iterator_to_object.push_back( &obj );
-               _object_to_iterator[&obj] = _iterator_to_object.size() - 1;
+               _object_to_iterator.insert( object_key( &obj ), _iterator_to_object.size() - 1 );
 
                return _iterator_to_object.size() - 1;
             }
 
+            /// forgets every table and iterator, keeping the storage for the next action
+            void clear() {
+               _table_cache.clear();
+               _end_iterator_to_table.clear();
+               _iterator_to_object.clear();
+               _object_to_iterator.clear();
+            }
+
          private:
-            map<table_id_object::id_type, pair<const table_id_object*, int>> _table_cache;
+            static uint64_t object_key( const T* obj ) { return reinterpret_cast<uintptr_t>( obj ); }
+
+            open_address_map<pair<const table_id_object*, int>> _table_cache; ///< by table id
             vector<const table_id_object*>                  _end_iterator_to_table;
             vector<const T*>                                _iterator_to_object;
-            map<const T*,int>                               _object_to_iterator;
+            open_address_map<int>                           _object_to_iterator; ///< by object address
 
             /// Precondition: std::numeric_limits<int>::min() < ei < -1
             /// Iterator of -1 is reserved for invalid iterators (i.e. when the appropriate table has not yet been created).
@@ -102,6 +112,24 @@ class apply_context {
             inline int index_to_end_iterator( size_t indx )const { return -(indx + 2); }
       }; /// class iterator_cache
 
+      /**
+       *  The iterator caches of an action. Iterators are only valid within the action that created them, so every
+       *  action starts with cleared caches, but the storage of a completed action is reused by the next one.
+       */
+      struct iterator_caches {
+         iterator_cache<key_value_object>           keyval;
+         iterator_cache<index64_object>             idx64;
+         iterator_cache<index128_object>            idx128;
+         iterator_cache<index256_object>            idx256;
+         iterator_cache<index_double_object>        idx_double;
+         iterator_cache<index_long_double_object>   idx_long_double;
+
+         void clear();
+      };
+
+      static std::unique_ptr<iterator_caches> acquire_iterator_caches();
+      static void release_iterator_caches( std::unique_ptr<iterator_caches> caches );
+
       template<typename>
       struct array_size;
 
@@ -174,7 +202,8 @@ class apply_context {
 
             using secondary_key_helper_t = secondary_key_helper<secondary_key_type, secondary_key_proxy_type, secondary_key_proxy_const_type>;
 
-            generic_index( apply_context& c ):context(c){}
+            generic_index( apply_context& c, iterator_cache<ObjectType>& cache, uint8_t index )
+            :context(c),itr_cache(cache),access_index(index){}
 
             int store( uint64_t scope, uint64_t table, const account_name& payer,
                        uint64_t id, secondary_key_proxy_const_type value )
@@ -184,6 +213,7 @@ class apply_context {
 //               context.require_write_lock( scope );
 
                const auto& tab = context.find_or_create_table( context.receiver, scope, table, payer );
+               context.record_write( tab, access_index, id, id );
 
                const auto& obj = context.db.create<ObjectType>( [&]( auto& o ){
                   o.t_id          = tab.id;
@@ -208,6 +238,7 @@ class apply_context {
 
                const auto& table_obj = itr_cache.get_table( obj.t_id );
                EOS_ASSERT( table_obj.code == context.receiver, table_access_violation, "db access violation" );
+               context.record_write( table_obj, access_index, obj.primary_key, obj.primary_key );
 
 //               context.require_write_lock( table_obj.scope );
 
@@ -228,6 +259,7 @@ class apply_context {
 
                const auto& table_obj = itr_cache.get_table( obj.t_id );
                EOS_ASSERT( table_obj.code == context.receiver, table_access_violation, "db access violation" );
+               context.record_write( table_obj, access_index, obj.primary_key, obj.primary_key );
 
 //               context.require_write_lock( table_obj.scope );
 
@@ -250,6 +282,8 @@ class apply_context {
                auto tab = context.find_table( code, scope, table );
                if( !tab ) return -1;
 
+               // the row found depends on the secondary keys of the whole index
+               context.record_read( *tab, access_index, 0, table_key_range::max_key );
                auto table_end_itr = itr_cache.cache_table( *tab );
 
                const auto* obj = context.db.find<ObjectType, by_secondary>( secondary_key_helper_t::create_tuple( *tab, secondary ) );
@@ -264,6 +298,8 @@ class apply_context {
                auto tab = context.find_table( code, scope, table );
                if( !tab ) return -1;
 
+               // the row found depends on the secondary keys of the whole index
+               context.record_read( *tab, access_index, 0, table_key_range::max_key );
                auto table_end_itr = itr_cache.cache_table( *tab );
 
                const auto& idx = context.db.get_index< typename chainbase::get_index_type<ObjectType>::type, by_secondary >();
@@ -281,6 +317,8 @@ class apply_context {
                auto tab = context.find_table( code, scope, table );
                if( !tab ) return -1;
 
+               // the row found depends on the secondary keys of the whole index
+               context.record_read( *tab, access_index, 0, table_key_range::max_key );
                auto table_end_itr = itr_cache.cache_table( *tab );
 
                const auto& idx = context.db.get_index< typename chainbase::get_index_type<ObjectType>::type, by_secondary >();
@@ -306,6 +344,8 @@ class apply_context {
 
                const auto& obj = itr_cache.get(iterator); // Check for iterator != -1 happens in this call
                const auto& idx = context.db.get_index<typename chainbase::get_index_type<ObjectType>::type, by_secondary>();
+               if( context.accesses )
+                  context.record_read( itr_cache.get_table( obj.t_id ), access_index, 0, table_key_range::max_key );
 
                auto itr = idx.iterator_to(obj);
                ++itr;
@@ -323,6 +363,7 @@ class apply_context {
                {
                   auto tab = itr_cache.find_table_by_end_iterator(iterator);
                   EOS_ASSERT( tab, invalid_table_iterator, "not a valid end iterator" );
+                  context.record_read( *tab, access_index, 0, table_key_range::max_key );
 
                   auto itr = idx.upper_bound(tab->id);
                   if( idx.begin() == idx.end() || itr == idx.begin() ) return -1; // Empty index
@@ -336,6 +377,8 @@ class apply_context {
                }
 
                const auto& obj = itr_cache.get(iterator); // Check for iterator != -1 happens in this call
+               if( context.accesses )
+                  context.record_read( itr_cache.get_table( obj.t_id ), access_index, 0, table_key_range::max_key );
 
                auto itr = idx.iterator_to(obj);
                if( itr == idx.begin() ) return -1; // cannot decrement past beginning iterator of index
@@ -353,6 +396,7 @@ class apply_context {
                if( !tab ) return -1;
 
                auto table_end_itr = itr_cache.cache_table( *tab );
+               context.record_read( *tab, access_index, primary, primary );
 
                const auto* obj = context.db.find<ObjectType, by_primary>( boost::make_tuple( tab->id, primary ) );
                if( !obj ) return table_end_itr;
@@ -369,9 +413,12 @@ class apply_context {
 
                const auto& idx = context.db.get_index<typename chainbase::get_index_type<ObjectType>::type, by_primary>();
                auto itr = idx.lower_bound(boost::make_tuple(tab->id, primary));
-               if (itr == idx.end()) return table_end_itr;
-               if (itr->t_id != tab->id) return table_end_itr;
+               if (itr == idx.end() || itr->t_id != tab->id) {
+                  context.record_read( *tab, access_index, primary, table_key_range::max_key );
+                  return table_end_itr;
+               }
 
+               context.record_read( *tab, access_index, primary, itr->primary_key );
                return itr_cache.add(*itr);
             }
 
@@ -383,9 +430,12 @@ class apply_context {
 
                const auto& idx = context.db.get_index<typename chainbase::get_index_type<ObjectType>::type, by_primary>();
                auto itr = idx.upper_bound(boost::make_tuple(tab->id, primary));
-               if (itr == idx.end()) return table_end_itr;
-               if (itr->t_id != tab->id) return table_end_itr;
+               if (itr == idx.end() || itr->t_id != tab->id) {
+                  context.record_read( *tab, access_index, primary, table_key_range::max_key );
+                  return table_end_itr;
+               }
 
+               context.record_read( *tab, access_index, primary, itr->primary_key );
                itr_cache.cache_table(*tab);
                return itr_cache.add(*itr);
             }
@@ -399,8 +449,14 @@ class apply_context {
                auto itr = idx.iterator_to(obj);
                ++itr;
 
-               if( itr == idx.end() || itr->t_id != obj.t_id ) return itr_cache.get_end_iterator_by_table_id(obj.t_id);
+               if( itr == idx.end() || itr->t_id != obj.t_id ) {
+                  if( context.accesses )
+                     context.record_read( itr_cache.get_table( obj.t_id ), access_index, obj.primary_key, table_key_range::max_key );
+                  return itr_cache.get_end_iterator_by_table_id(obj.t_id);
+               }
 
+               if( context.accesses )
+                  context.record_read( itr_cache.get_table( obj.t_id ), access_index, obj.primary_key, itr->primary_key );
                primary = itr->primary_key;
                return itr_cache.add(*itr);
             }
@@ -414,12 +470,12 @@ class apply_context {
                   EOS_ASSERT( tab, invalid_table_iterator, "not a valid end iterator" );
 
                   auto itr = idx.upper_bound(tab->id);
-                  if( idx.begin() == idx.end() || itr == idx.begin() ) return -1; // Empty table
-
-                  --itr;
-
-                  if( itr->t_id != tab->id ) return -1; // Empty table
+                  if( idx.begin() == idx.end() || itr == idx.begin() || (--itr)->t_id != tab->id ) {
+                     context.record_read( *tab, access_index, 0, table_key_range::max_key );
+                     return -1; // Empty table
+                  }
 
+                  context.record_read( *tab, access_index, itr->primary_key, table_key_range::max_key );
                   primary = itr->primary_key;
                   return itr_cache.add(*itr);
                }
@@ -427,12 +483,14 @@ class apply_context {
                const auto& obj = itr_cache.get(iterator); // Check for iterator != -1 happens in this call
 
                auto itr = idx.iterator_to(obj);
-               if( itr == idx.begin() ) return -1; // cannot decrement past beginning iterator of table
-
-               --itr;
-
-               if( itr->t_id != obj.t_id ) return -1; // cannot decrement past beginning iterator of index
+               if( itr == idx.begin() || (--itr)->t_id != obj.t_id ) {
+                  if( context.accesses )
+                     context.record_read( itr_cache.get_table( obj.t_id ), access_index, 0, obj.primary_key );
+                  return -1; // cannot decrement past beginning iterator of table
+               }
 
+               if( context.accesses )
+                  context.record_read( itr_cache.get_table( obj.t_id ), access_index, itr->primary_key, obj.primary_key );
                primary = itr->primary_key;
                return itr_cache.add(*itr);
             }
@@ -445,7 +503,8 @@ class apply_context {
 
          private:
             apply_context&              context;
-            iterator_cache<ObjectType>  itr_cache;
+            iterator_cache<ObjectType>& itr_cache;
+            const uint8_t               access_index; ///< of the index in table_key_range
       }; /// class generic_index
 
 
@@ -459,15 +518,21 @@ class apply_context {
       ,receiver(act.account)
       ,used_authorizations(act.authorization.size(), false)
       ,recurse_depth(depth)
-      ,idx64(*this)
-      ,idx128(*this)
-      ,idx256(*this)
-      ,idx_double(*this)
-      ,idx_long_double(*this)
+      ,caches(acquire_iterator_caches())
+      ,idx64(*this, caches->idx64, table_key_range::idx64_index)
+      ,idx128(*this, caches->idx128, table_key_range::idx128_index)
+      ,idx256(*this, caches->idx256, table_key_range::idx256_index)
+      ,idx_double(*this, caches->idx_double, table_key_range::idx_double_index)
+      ,idx_long_double(*this, caches->idx_long_double, table_key_range::idx_long_double_index)
+      ,keyval_cache(caches->keyval)
       {
          reset_console();
       }
 
+      ~apply_context() {
+         release_iterator_caches( std::move( caches ) );
+      }
+
 
    /// Execution methods:
    public:
@@ -550,6 +615,8 @@ class apply_context {
       int  db_lowerbound_i64( uint64_t code, uint64_t scope, uint64_t table, uint64_t id );
       int  db_upperbound_i64( uint64_t code, uint64_t scope, uint64_t table, uint64_t id );
       int  db_end_i64( uint64_t code, uint64_t scope, uint64_t table );
+      /// the rows following iterator as packed records, the layout is documented with db_scan_i64 in eosiolib/db.h
+      int  db_scan_i64( int iterator, char* buffer, size_t buffer_size, uint32_t max_rows );
 
    private:
 
@@ -559,6 +626,14 @@ class apply_context {
 
       int  db_store_i64( uint64_t code, uint64_t scope, uint64_t table, const account_name& payer, uint64_t id, const char* buffer, size_t buffer_size );
 
+      void record_read( const table_id_object& t, uint8_t index, uint64_t lower, uint64_t upper ) {
+         if( accesses ) accesses->read( t.code, t.scope, t.table, index, lower, upper );
+      }
+
+      void record_write( const table_id_object& t, uint8_t index, uint64_t lower, uint64_t upper ) {
+         if( accesses ) accesses->write( t.code, t.scope, t.table, index, lower, upper );
+      }
+
 
    /// Misc methods:
    public:
@@ -588,7 +663,13 @@ class apply_context {
       bool                          privileged   = false;
       bool                          context_free = false;
       bool                          used_context_free_api = false;
+      action_profile*               profile = nullptr; ///< costs of the running action, set only when profiling
+      access_set*                   accesses = nullptr; ///< keys accessed by the transaction, set only when tracked
 
+   private:
+      std::unique_ptr<iterator_caches>    caches; ///< declared ahead of the indices using them
+
+   public:
       generic_index<index64_object>                                  idx64;
       generic_index<index128_object>                                 idx128;
       generic_index<index256_object, uint128_t*, const uint128_t*>   idx256;
@@ -597,7 +678,7 @@ class apply_context {
 
    private:
 
-      iterator_cache<key_value_object>    keyval_cache;
+      iterator_cache<key_value_object>&   keyval_cache;
       vector<account_name>                _notified; ///< keeps track of new accounts to be notifed of current message
       vector<action>                      _inline_actions; ///< queued inline messages
       vector<action>                      _cfa_inline_actions; ///< queued inline messages
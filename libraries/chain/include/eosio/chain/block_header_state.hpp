@@ -5,6 +5,45 @@
 
 namespace eosio { namespace chain {
 
+/**
+ *  @class producer_schedule_ref
+ *  @brief an immutable producer schedule shared by all block header states that have it
+ *
+ *  Schedules only change when a new one is proposed or promoted, so the states of consecutive blocks refer
+ *  to the same schedule instead of each holding a copy. Equal schedules are interned, which also shares the
+ *  schedules of states that were unpacked separately. The empty schedule needs no allocation.
+ */
+class producer_schedule_ref {
+   public:
+      producer_schedule_ref() = default;
+      producer_schedule_ref( producer_schedule_type schedule );
+
+      const producer_schedule_type& operator*()const  { return schedule ? *schedule : empty(); }
+      const producer_schedule_type* operator->()const { return &**this; }
+
+      /// true when both refer to the same instance
+      bool shares( const producer_schedule_ref& other )const { return schedule == other.schedule; }
+
+   private:
+      static const producer_schedule_type& empty();
+
+      std::shared_ptr<const producer_schedule_type> schedule;
+};
+
+template<typename DataStream>
+DataStream& operator << ( DataStream& ds, const producer_schedule_ref& s ) {
+   fc::raw::pack( ds, *s );
+   return ds;
+}
+
+template<typename DataStream>
+DataStream& operator >> ( DataStream& ds, producer_schedule_ref& s ) {
+   producer_schedule_type schedule;
+   fc::raw::unpack( ds, schedule );
+   s = producer_schedule_ref( std::move(schedule) );
+   return ds;
+}
+
 /**
  *  @struct block_header_state
  *  @brief defines the minimum state necessary to validate transaction headers
@@ -18,8 +57,8 @@ struct block_header_state {
     uint32_t                          bft_irreversible_blocknum = 0;
     uint32_t                          pending_schedule_lib_num = 0; /// last irr block num
     digest_type                       pending_schedule_hash;
-    producer_schedule_type            pending_schedule;
-    producer_schedule_type            active_schedule;
+    producer_schedule_ref             pending_schedule;
+    producer_schedule_ref             active_schedule;
     incremental_merkle                blockroot_merkle;
     flat_map<account_name,uint32_t>   producer_to_last_produced;
     flat_map<account_name,uint32_t>   producer_to_last_implied_irb;
@@ -36,7 +75,7 @@ struct block_header_state {
     bool maybe_promote_pending();
 
 
-    bool                 has_pending_producers()const { return pending_schedule.producers.size(); }
+    bool                 has_pending_producers()const { return pending_schedule->producers.size(); }
     uint32_t             calc_dpos_last_irreversible()const;
     bool                 is_active_producer( account_name n )const;
 
@@ -59,6 +98,18 @@ struct block_header_state {
 
 } } /// namespace eosio::chain
 
+namespace fc {
+   inline void to_variant( const eosio::chain::producer_schedule_ref& s, variant& v ) {
+      to_variant( *s, v );
+   }
+
+   inline void from_variant( const variant& v, eosio::chain::producer_schedule_ref& s ) {
+      eosio::chain::producer_schedule_type schedule;
+      from_variant( v, schedule );
+      s = eosio::chain::producer_schedule_ref( std::move(schedule) );
+   }
+}
+
 FC_REFLECT( eosio::chain::block_header_state,
             (id)(block_num)(header)(dpos_proposed_irreversible_blocknum)(dpos_irreversible_blocknum)(bft_irreversible_blocknum)
             (pending_schedule_lib_num)(pending_schedule_hash)
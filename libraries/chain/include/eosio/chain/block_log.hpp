@@ -11,6 +11,23 @@ namespace eosio { namespace chain {
 
    namespace detail { class block_log_impl; }
 
+   /// how the entries of a block log file are stored, recorded in the header from version 3 on
+   enum class block_log_compression : uint8_t {
+      none = 0, ///< packed blocks, written as version 2 so older nodes can still read the log
+      zlib = 1  ///< every packed block is zlib compressed on its own
+   };
+
+   struct block_log_config {
+      uint32_t write_queue_size = 0; ///< blocks appended but not yet written before append blocks, 0 writes in append
+      uint32_t fsync_interval   = 0; ///< blocks written between fsyncs of the files, 0 leaves syncing to the OS
+      uint32_t cache_size       = 0; ///< most recently read blocks kept decoded, 0 disables the cache
+      uint32_t stride           = 0; ///< blocks.log is split after every block number divisible by stride, 0 never splits
+      uint32_t max_retained_files = 0; ///< retained segments kept before the oldest is archived or deleted, 0 keeps all
+      fc::path retained_dir;         ///< directory of the retained segments, "retained" when empty, relative to the data dir
+      fc::path archive_dir;          ///< segments beyond max_retained_files are moved here, deleted when empty
+      block_log_compression compression = block_log_compression::none; ///< of files started by this log, existing ones keep theirs
+   };
+
    /* The block log is an external append only log of the blocks with a header. Blocks should only
     * be written to the log after they irreverisble as the log is append only. The log is a doubly
     * linked list of blocks. There is a secondary index file of only block positions that enables
@@ -33,16 +50,37 @@ namespace eosio { namespace chain {
     * to find the position of the block in the main file.
     *
     * The main file is the only file that needs to persist. The index file can be reconstructed during a
-    * linear scan of the main file.
+    * linear scan of the main file. The scan follows the positions back from the head and decodes the block
+    * headers of ranges of the file in parallel, only falling back to decoding every block in order when the
+    * positions are inconsistent.
+    *
+    * With a non-zero write queue size, append only queues the block and a writer thread packs and writes the
+    * queued blocks in batches. append blocks only while the queue is full. Queued blocks are served from the
+    * queue by the read functions, flush waits until they are written. written_block_num tells callers which
+    * blocks they may stop keeping elsewhere.
+    *
+    * Reads go through read-only memory mappings of both files and never take the writer's lock, so the read
+    * functions may be called from any number of threads. Blocks read by number are kept decoded in an LRU cache.
+    *
+    * With a stride, the log is split into segments: after a block whose number is a multiple of the stride,
+    * blocks.log and its index are moved to the retained directory as blocks-<first>-<last>.log and .index and
+    * a new blocks.log starts with the next block. Blocks of retained segments stay readable by number, so the
+    * segments together act as one log, while repair and index reconstruction of blocks.log only scan the blocks
+    * since the last split. Missing indexes of retained segments are rebuilt in parallel on open.
+    *
+    * A version 3 log records a compression after the first block number. Each block is then stored as the
+    * size prefixed compressed serialization of the block, still followed by its position, so the index and the
+    * backwards walk work unchanged and a block is decompressed on its own. Every file keeps the format it was
+    * started with: a compressed log continues an uncompressed blocks.log until the next split or reset.
     */
 
    class block_log {
       public:
-         block_log(const fc::path& data_dir);
+         block_log(const fc::path& data_dir, const block_log_config& cfg = block_log_config());
          block_log(block_log&& other);
          ~block_log();
 
-         uint64_t append(const signed_block_ptr& b);
+         void append(const signed_block_ptr& b);
          void flush();
          void reset( const genesis_state& gs, const signed_block_ptr& genesis_block, uint32_t first_block_num = 1 );
 
@@ -51,24 +89,35 @@ namespace eosio { namespace chain {
          signed_block_ptr read_block_by_id(const block_id_type& id)const {
             return read_block_by_num(block_header::num_from_id(id));
          }
+         /// the header of a block, read without decoding the rest of an uncompressed block
+         optional<signed_block_header> read_block_header_by_num(uint32_t block_num)const;
 
          /**
-          * Return offset of block in file, or block_log::npos if it does not exist.
+          * Return offset of block in the file of the segment containing it, or block_log::npos if it does not exist.
           */
          uint64_t get_block_pos(uint32_t block_num) const;
          signed_block_ptr        read_head()const;
          const signed_block_ptr& head()const;
+         /// first block of the oldest retained segment, or of blocks.log when none is retained
          uint32_t                first_block_num() const;
+         /// the last block written to the files, blocks still queued for the writer thread are not
+         uint32_t                written_block_num() const;
 
          static const uint64_t npos = std::numeric_limits<uint64_t>::max();
 
          static const uint32_t min_supported_version;
          static const uint32_t max_supported_version;
 
-         static fc::path repair_log( const fc::path& data_dir, uint32_t truncate_at_block = 0 );
+         /// rebuilds blocks.log from the one moved to the returned backup directory; the retained and archive
+         /// directories (as in block_log_config) inside data_dir are moved back, their segments precede blocks.log
+         static fc::path repair_log( const fc::path& data_dir, uint32_t truncate_at_block = 0,
+                                     const fc::path& retained_dir = fc::path(), const fc::path& archive_dir = fc::path() );
 
          static genesis_state extract_genesis_state( const fc::path& data_dir );
 
+         /// writes the index of a block log file, checking the blocks on `threads` threads, 0 for one per core
+         static void construct_index( const fc::path& block_file_name, const fc::path& index_file_name, uint32_t threads = 0 );
+
       private:
          void open(const fc::path& data_dir);
          void construct_index();
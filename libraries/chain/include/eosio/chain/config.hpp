@@ -16,9 +16,12 @@ const static auto default_blocks_dir_name    = "blocks";
 const static auto reversible_blocks_dir_name = "reversible";
 const static auto default_reversible_cache_size = 340*1024*1024ll;/// 1MB * 340 blocks based on 21 producer BFT delay
 const static auto default_reversible_guard_size = 2*1024*1024ll;/// 1MB * 340 blocks based on 21 producer BFT delay
+const static uint32_t default_block_log_write_queue_size = 64;
+const static uint32_t default_block_log_cache_size = 1024;
 
 const static auto default_state_dir_name     = "state";
 const static auto forkdb_filename            = "forkdb.dat";
+const static auto forkdb_journal_filename    = "forkdb.log";
 const static auto default_state_size            = 1*1024*1024*1024ll;
 const static auto default_state_guard_size      =    128*1024*1024ll;
 
@@ -39,6 +42,8 @@ const static uint64_t owner_name  = N(owner);
 const static uint64_t eosio_any_name = N(eosio.any);
 const static uint64_t eosio_code_name = N(eosio.code);
 
+const static uint64_t db_scan_feature_name = N(dbscan); ///< feature allowing contracts to import db_scan_i64
+
 const static int      block_interval_ms = 500;
 const static int      block_interval_us = block_interval_ms*1000;
 const static uint64_t block_timestamp_epoch = 946684800000ll; // epoch is year 2000.
@@ -81,6 +86,10 @@ const static uint16_t   default_max_inline_action_depth        = 4;
 const static uint16_t   default_max_auth_depth                 = 6;
 const static uint32_t   default_sig_cpu_bill_pct               = 50 * percent_1; // billable percentage of signature recovery
 const static uint16_t   default_controller_thread_pool_size    = 2;
+const static uint32_t   default_block_prepare_window           = 16; ///< blocks whose headers are validated ahead of their application
+const static uint32_t   default_replay_read_ahead_blocks       = 256; ///< blocks read from the block log ahead of their replay
+const static uint32_t   replay_report_interval_sec             = 10;
+const static uint32_t   checkpoint_header_window               = 10000; ///< proven checkpoint ancestors kept ahead of head, and between kept anchors
 
 const static uint32_t   min_net_usage_delta_between_base_and_max_for_trx  = 10*1024;
 // Should be large enough to allow recovery from badly set blockchain parameters without a hard fork
@@ -94,9 +103,13 @@ const static uint32_t   overhead_per_account_ram_bytes     = 2*1024; ///< overhe
 const static uint32_t   setcode_ram_bytes_multiplier       = 10;     ///< multiplier on contract size to account for multiple copies and cached compilation
 
 const static uint32_t   hashing_checktime_block_size       = 10*1024;  /// call checktime from hashing intrinsic once per this number of bytes
+const static uint32_t   max_db_scan_rows                   = 64;       ///< rows copied by a single db_scan_i64 call at most
 
 const static eosio::chain::wasm_interface::vm_type default_wasm_runtime = eosio::chain::wasm_interface::vm_type::wabt;
 const static uint32_t   default_abi_serializer_max_time_ms = 15*1000; ///< default deadline for abi serialization methods
+const static uint64_t   default_wasm_cache_size            = 512*1024*1024ll; ///< budget of instantiated modules kept in the wasm cache
+const static uint32_t   default_wasm_cache_max_entries     = 1024;
+const static uint32_t   default_wasm_tier_up_threshold     = 1000; ///< invocations of an interpreted contract before it is compiled by the JIT in tiered mode
 
 /**
  *  The number of sequential blocks produced by a single producer
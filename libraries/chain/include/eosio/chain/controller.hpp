@@ -7,6 +7,7 @@
 #include <eosio/chain/abi_serializer.hpp>
 #include <eosio/chain/account_object.hpp>
 #include <eosio/chain/snapshot.hpp>
+#include <eosio/chain/access_set.hpp>
 
 namespace chainbase {
    class database;
@@ -35,6 +36,7 @@ namespace eosio { namespace chain {
    using apply_handler = std::function<void(apply_context&)>;
 
    class fork_database;
+   class execution_profiler;
 
    enum class db_read_mode {
       SPECULATIVE,
@@ -60,6 +62,14 @@ namespace eosio { namespace chain {
             flat_set< pair<account_name, action_name> > action_blacklist;
             flat_set<public_key_type> key_blacklist;
             path                     blocks_dir             =  chain::config::default_blocks_dir_name;
+            uint32_t                 block_log_write_queue_size = 0; ///< irreversible blocks queued for the block log writer thread, 0 writes them synchronously
+            uint32_t                 block_log_fsync_interval = 0;   ///< blocks written to the block log between fsyncs, 0 never fsyncs
+            uint32_t                 block_log_cache_size = 0;       ///< decoded blocks read from the block log kept for reuse
+            uint32_t                 block_log_stride = 0;           ///< the block log is split every stride blocks, 0 never splits
+            uint32_t                 max_retained_block_files = 0;   ///< split block log files kept, 0 keeps all
+            path                     blocks_retained_dir;            ///< split block log files, relative to blocks_dir
+            path                     blocks_archive_dir;             ///< split block log files beyond max_retained_block_files, deleted when empty
+            bool                     compress_block_log = false;     ///< block log files started by this node store zlib compressed blocks
             path                     state_dir              =  chain::config::default_state_dir_name;
             uint64_t                 state_size             =  chain::config::default_state_size;
             uint64_t                 state_guard_size       =  chain::config::default_state_guard_size;
@@ -67,20 +77,31 @@ namespace eosio { namespace chain {
             uint64_t                 reversible_guard_size  =  chain::config::default_reversible_guard_size;
             uint32_t                 sig_cpu_bill_pct       =  chain::config::default_sig_cpu_bill_pct;
             uint16_t                 thread_pool_size       =  chain::config::default_controller_thread_pool_size;
+            uint32_t                 block_prepare_window   =  chain::config::default_block_prepare_window; ///< blocks prepared ahead of a block not yet in the fork database
+            uint32_t                 replay_read_ahead_blocks = chain::config::default_replay_read_ahead_blocks; ///< blocks prepared ahead of replay, 0 replays on the main thread only
             bool                     read_only              =  false;
             bool                     force_all_checks       =  false;
             bool                     disable_replay_opts    =  false;
             bool                     contracts_console      =  false;
             bool                     allow_ram_billing_in_notify = false;
+            bool                     profile_actions        =  false; ///< aggregate execution costs per receiver and action
+            bool                     track_access_sets      =  false; ///< record the table keys each transaction accesses and build a conflict graph per block
+            flat_set<digest_type>    native_token_code_hashes; ///< builds of eosio.token whose transfers are applied natively
 
             genesis_state            genesis;
             wasm_interface::vm_type  wasm_runtime = chain::config::default_wasm_runtime;
+            uint64_t                 wasm_cache_size        =  chain::config::default_wasm_cache_size;
+            uint32_t                 wasm_cache_max_entries =  chain::config::default_wasm_cache_max_entries;
+            uint32_t                 wasm_tier_up_threshold =  chain::config::default_wasm_tier_up_threshold;
+            path                     wasm_code_cache_dir; ///< persistent cache of injected modules, disabled when empty
+            bool                     wasm_hard_float        =  false; ///< native float add, sub, mul, div and sqrt, bit-exact with softfloat, see wasm_hard_float.hpp
 
             db_read_mode             read_mode              = db_read_mode::SPECULATIVE;
             validation_mode          block_validation_mode  = validation_mode::FULL;
 
             flat_set<account_name>   resource_greylist;
             flat_set<account_name>   trusted_producers;
+            flat_set<block_id_type>  light_validation_checkpoints; ///< blocks proven to be ancestors of these are light validated
          };
 
          enum class block_status {
@@ -144,9 +165,24 @@ namespace eosio { namespace chain {
          void commit_block();
          void pop_block();
 
+         /**
+          *  Validates the header and recovers the signing keys of a block on the thread pool. The previous block may
+          *  itself still be in preparation, so up to block_prepare_window upcoming blocks can be prepared while the
+          *  blocks before them are applied. Blocks must still be pushed in order.
+          */
          std::future<block_state_ptr> create_block_state_future( const signed_block_ptr& b );
          void push_block( std::future<block_state_ptr>& block_state_future );
 
+         /**
+          *  Proves that the blocks of a header chain are ancestors of a light validation checkpoint. The headers are
+          *  in descending order and the first one must be a proven ancestor or a checkpoint itself. Returns the
+          *  number of headers proven, headers of blocks at or below head are ignored.
+          */
+         uint32_t add_checkpoint_headers( const vector<signed_block_header>& headers );
+         /// the block from which headers are needed to prove the next blocks, an empty id when none are needed
+         block_id_type checkpoint_headers_needed()const;
+         bool is_checkpoint_ancestor( const block_id_type& id )const;
+
          boost::asio::thread_pool& get_thread_pool();
 
          const chainbase::database& db()const;
@@ -200,6 +236,8 @@ namespace eosio { namespace chain {
 
          signed_block_ptr fetch_block_by_number( uint32_t block_num )const;
          signed_block_ptr fetch_block_by_id( block_id_type id )const;
+         /// the header of a block from its block state or the block log, without reading the whole block
+         optional<signed_block_header> fetch_block_header_by_id( block_id_type id )const;
 
          block_state_ptr fetch_block_state_by_number( uint32_t block_num )const;
          block_state_ptr fetch_block_state_by_id( block_id_type id )const;
@@ -239,11 +277,21 @@ namespace eosio { namespace chain {
          bool skip_trx_checks()const;
 
          bool contracts_console()const;
+         /// wasm_hard_float of the config if the floating point environment supports it, decided at startup
+         bool wasm_hard_float()const;
+         /// records the activation of a known feature, in effect from the block after the pending block
+         void activate_feature( account_name feature_name );
+         /// whether a feature is in effect in the pending block
+         bool is_feature_active( account_name feature_name )const;
+         /// whether contracts deployed in the pending block may import db_scan_i64
+         bool is_db_scan_active()const;
+         bool is_native_token_code( const digest_type& code_id )const;
 
          chain_id_type get_chain_id()const;
 
          db_read_mode get_read_mode()const;
          validation_mode get_validation_mode()const;
+         uint32_t get_block_prepare_window()const;
 
          void set_subjective_cpu_leeway(fc::microseconds leeway);
 
@@ -268,6 +316,11 @@ namespace eosio { namespace chain {
 
          const apply_handler* find_apply_handler( account_name contract, scope_name scope, action_name act )const;
          wasm_interface& get_wasm_interface();
+         /// null unless config::profile_actions is set
+         execution_profiler* get_execution_profiler();
+         bool tracks_access_sets()const;
+         /// conflicts between the transactions of the last committed block, empty unless config::track_access_sets is set
+         const optional<conflict_graph>& last_conflict_graph()const;
 
 
          optional<abi_serializer> get_abi_serializer( account_name n, const fc::microseconds& max_serialization_time )const {
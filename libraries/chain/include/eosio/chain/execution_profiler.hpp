@@ -0,0 +1,73 @@
+/**
+ *  @file
+ *  @copyright defined in eos/LICENSE
+ */
+#pragma once
+#include <eosio/chain/types.hpp>
+#include <fc/time.hpp>
+
+#include <mutex>
+
+namespace eosio { namespace chain {
+
+   /**
+    *  Resources used by the executions of one (receiver, action) pair.
+    *
+    *  billed_cpu is wall_time less compile_time, the billing timer being paused while a contract is instantiated.
+    *  compile_time covers the lookup and, on a miss, the injection and instantiation of the contract.
+    */
+   struct action_profile {
+      uint64_t          calls = 0;
+      uint64_t          failures = 0;
+      fc::microseconds  wall_time;
+      fc::microseconds  billed_cpu;
+      fc::microseconds  compile_time;
+      uint64_t          db_calls = 0;
+      int64_t           ram_delta = 0;
+
+      action_profile& operator+=( const action_profile& other );
+      action_profile& operator-=( const action_profile& other );
+   };
+
+   struct action_profile_entry {
+      account_name      receiver;
+      action_name       action;
+      action_profile    profile;
+   };
+
+   /**
+    *  Opt-in aggregation of action execution costs per (receiver, action).
+    *
+    *  Every recording thread owns a shard of counters that only it writes, so record() takes no lock after the
+    *  first sample of a thread, which registers its shard. The counters are atomics that snapshot() reads while
+    *  they are written, so a snapshot may see part of a sample recorded concurrently. reset() never touches the
+    *  shards either: it records the current totals as a baseline that later snapshots subtract.
+    */
+   class execution_profiler {
+      public:
+         execution_profiler();
+         ~execution_profiler();
+
+         void record( account_name receiver, action_name action, const action_profile& sample );
+
+         /// merged counters of all threads, ordered by decreasing wall time
+         vector<action_profile_entry> snapshot()const;
+         void reset();
+
+      private:
+         struct shard;
+         shard& local_shard();
+
+         /// Precondition: shards_mutex is held
+         flat_map<std::pair<account_name, action_name>, action_profile> totals()const;
+
+         const uint64_t                      id;
+         mutable std::mutex                  shards_mutex; ///< guards shards and baseline, never taken by record() once registered
+         vector<std::shared_ptr<shard>>      shards;
+         flat_map<std::pair<account_name, action_name>, action_profile> baseline; ///< totals at the last reset()
+   };
+
+} } // eosio::chain
+
+FC_REFLECT( eosio::chain::action_profile, (calls)(failures)(wall_time)(billed_cpu)(compile_time)(db_calls)(ram_delta) )
+FC_REFLECT( eosio::chain::action_profile_entry, (receiver)(action)(profile) )
@@ -18,15 +18,35 @@ namespace eosio { namespace chain {
     * database tracks the longest chain and the last irreversible block number. All
     * blocks older than the last irreversible block are freed after emitting the
     * irreversible signal.
+    *
+    * Every change is appended to a journal as it is made and synced once the change
+    * is done, so close does not have to write the fork database out and a restart,
+    * clean or not, replays the journal. A record cut off by a crash is discarded.
+    * The journal lives in its own directory, the blocks directory for the controller,
+    * so it outlives a state directory cleared for a replay; the block states it holds
+    * are then set aside while the state is rebuilt and the forks building on the
+    * rebuilt chain are restored afterwards.
     */
    class fork_database {
       public:
 
-         fork_database( const fc::path& data_dir );
+         /// the journal is kept in @p journal_dir, or in @p data_dir when it is empty
+         fork_database( const fc::path& data_dir, const fc::path& journal_dir = fc::path() );
          ~fork_database();
 
          void close();
 
+         /**
+          * Moves every block state out of the fork database, leaving it empty for a state
+          * database that is rebuilt from the block log or a snapshot.
+          */
+         void set_aside_journal();
+         /**
+          * Adds back the block states set aside that are not in the fork database but build
+          * on it, as blocks outside of the current chain.
+          */
+         void restore_set_aside();
+
          block_state_ptr  get_block(const block_id_type& id)const;
          block_state_ptr  get_block_in_current_chain_by_num( uint32_t n )const;
 //         vector<block_state_ptr>    get_blocks_by_number(uint32_t n)const;
@@ -0,0 +1,26 @@
+/**
+ *  @file
+ *  @copyright defined in eos/LICENSE
+ */
+#pragma once
+
+#include <eosio/chain/types.hpp>
+
+namespace eosio { namespace chain {
+
+   class apply_context;
+
+   /**
+    *  Native implementation of the transfer action of the standard eosio.token contract, used in place of the
+    *  WASM contract when the deployed code hash is listed in controller::config::native_token_code_hashes.
+    *
+    *  Only a transfer that the contract would accept is applied natively, with the same authorization, notification
+    *  and database calls in the same order, so state, RAM billing and receipts are identical. For any other action,
+    *  malformed input or failing check it returns false without side effects and the caller runs the WASM contract,
+    *  which reports the failure exactly as it always has.
+    *
+    *  @return true if the action was applied
+    */
+   bool apply_native_token_transfer( apply_context& context );
+
+} } /// namespace eosio::chain
@@ -0,0 +1,123 @@
+/**
+ *  @file
+ *  @copyright defined in eos/LICENSE
+ */
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+namespace eosio { namespace chain {
+
+   /**
+    *  Map from 64 bit keys to small values, open addressed with linear probing in a single array.
+    *
+    *  The key UINT64_MAX is reserved to mark empty slots. Erasing shifts the following entries of a probe sequence
+    *  back rather than leaving tombstones. clear() keeps the array unless it grew beyond shrink_capacity, so a map
+    *  reused by one action after another only allocates while it grows.
+    */
+   template<typename Value>
+   class open_address_map {
+      public:
+         static constexpr uint64_t empty_key       = std::numeric_limits<uint64_t>::max();
+         static constexpr size_t   min_capacity    = 16;
+         static constexpr size_t   shrink_capacity = 4096;
+
+         Value* find( uint64_t key ) {
+            if( slots.empty() )
+               return nullptr;
+            for( size_t i = slot_of( key ); ; i = next( i ) ) {
+               if( slots[i].key == key )
+                  return &slots[i].value;
+               if( slots[i].key == empty_key )
+                  return nullptr;
+            }
+         }
+
+         const Value* find( uint64_t key )const {
+            return const_cast<open_address_map*>( this )->find( key );
+         }
+
+         /// Precondition: key is not in the map and is not empty_key
+         void insert( uint64_t key, const Value& value ) {
+            if( (count + 1) * 2 > slots.size() )
+               grow();
+            size_t i = slot_of( key );
+            while( slots[i].key != empty_key )
+               i = next( i );
+            slots[i].key = key;
+            slots[i].value = value;
+            ++count;
+         }
+
+         void erase( uint64_t key ) {
+            if( slots.empty() )
+               return;
+            size_t i = slot_of( key );
+            while( slots[i].key != key ) {
+               if( slots[i].key == empty_key )
+                  return;
+               i = next( i );
+            }
+
+            // moves back every following entry of the run whose home slot does not lie after the freed slot
+            for( size_t j = next( i ); slots[j].key != empty_key; j = next( j ) ) {
+               size_t home = slot_of( slots[j].key );
+               bool stays = i <= j ? (i < home && home <= j) : (i < home || home <= j);
+               if( !stays ) {
+                  slots[i] = slots[j];
+                  i = j;
+               }
+            }
+            slots[i].key = empty_key;
+            --count;
+         }
+
+         void clear() {
+            if( slots.size() > shrink_capacity ) {
+               slots = std::vector<slot>();
+               shift = 64;
+            } else {
+               for( auto& s : slots )
+                  s.key = empty_key;
+            }
+            count = 0;
+         }
+
+         size_t size()const { return count; }
+         bool   empty()const { return count == 0; }
+
+      private:
+         struct slot {
+            uint64_t key = empty_key;
+            Value    value;
+         };
+
+         /// Fibonacci hashing, the high bits of the product are the best mixed
+         size_t slot_of( uint64_t key )const { return (key * 0x9E3779B97F4A7C15ull) >> shift; }
+         size_t next( size_t i )const { return (i + 1) & (slots.size() - 1); }
+
+         void grow() {
+            std::vector<slot> old;
+            old.swap( slots );
+            size_t capacity = old.empty() ? min_capacity : old.size() * 2;
+            slots.resize( capacity );
+            shift = 64;
+            while( capacity > 1 ) {
+               capacity >>= 1;
+               --shift;
+            }
+            count = 0;
+            for( const auto& s : old ) {
+               if( s.key != empty_key )
+                  insert( s.key, s.value );
+            }
+         }
+
+         std::vector<slot>  slots;
+         uint32_t           shift = 64;
+         size_t             count = 0;
+   };
+
+} } // eosio::chain
@@ -103,6 +103,8 @@ namespace eosio { namespace chain {
          int64_t                       billed_cpu_time_us = 0;
          bool                          explicit_billed_cpu_time = false;
 
+         std::unique_ptr<access_set>   accesses; ///< set only when the controller tracks access sets
+
       private:
          bool                          is_initialized = false;
 
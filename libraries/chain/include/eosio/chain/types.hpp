@@ -168,7 +168,7 @@ namespace eosio { namespace chain {
       transaction_object_type,
       generated_transaction_object_type,
       producer_object_type,
-      UNUSED_chain_property_object_type,
+      activated_feature_object_type,
       account_control_history_object_type,     ///< Defined by history_plugin
       UNUSED_account_transaction_history_object_type,
       UNUSED_transaction_history_object_type,
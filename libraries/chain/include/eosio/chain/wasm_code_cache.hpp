@@ -0,0 +1,63 @@
+/**
+ *  @file
+ *  @copyright defined in eos/LICENSE
+ */
+#pragma once
+#include <eosio/chain/types.hpp>
+#include <eosio/chain/wasm_interface.hpp>
+#include <fc/filesystem.hpp>
+
+namespace eosio { namespace chain {
+
+   /* The wasm code cache is a directory of injected and serialized modules that survives restarts of the
+    * node. Each file is named after the code hash, the runtime, the float injection and the cache version, so a
+    * change to any of them never serves a stale module:
+    *
+    *    <code hash>-<runtime>[-hard-float]-v<version>.wasm
+    *
+    * A cached entry lets a restarted node skip the parse, injection and reserialization passes of every
+    * contract it has seen before. The WAVM runtime in this tree cannot persist LLVM object code, so native
+    * code is still generated when the cached module is instantiated.
+    *
+    * Entries are synced to disk before they are renamed into place and carry a checksum of their contents.
+    * Unreadable, mismatched or damaged entries are removed and treated as a miss; the cache is never
+    * authoritative.
+    */
+   class wasm_code_cache {
+      public:
+         struct entry {
+            uint32_t               version = 0;
+            digest_type            code_id;
+            std::vector<uint8_t>   code;             ///< module after wasm_binary_injection
+            std::vector<uint8_t>   initial_memory;   ///< memory image built from the data segments
+            fc::sha256             checksum;         ///< hash of code and initial_memory, verified on get
+
+            fc::sha256 compute_checksum()const;
+         };
+
+         /// @param native_float true when modules are injected with native float opcodes, see wasm_hard_float.hpp
+         wasm_code_cache( const fc::path& dir, wasm_interface::vm_type vm, bool native_float = false );
+
+         optional<entry> get( const digest_type& code_id )const;
+         void            put( entry e )const;
+
+         /**
+          * History:
+          * Version 1: initial layout
+          * Version 2: entries carry a checksum of their contents
+          *
+          * Must be bumped whenever wasm_binary_injection or the WAVM serializer change their output.
+          */
+         static const uint32_t version;
+
+      private:
+         fc::path file_for( const digest_type& code_id )const;
+
+         fc::path                 dir;
+         wasm_interface::vm_type  vm;
+         bool                     native_float = false;
+   };
+
+} }
+
+FC_REFLECT( eosio::chain::wasm_code_cache::entry, (version)(code_id)(code)(initial_memory)(checksum) )
@@ -464,6 +464,114 @@ namespace eosio { namespace chain { namespace wasm_injections {
       }
    }
 
+   /* With native floats enabled (see wasm_hard_float.hpp) add, sub, mul, div and sqrt stay wasm opcodes instead of
+    * calls into the host. Only the payload and sign of a NaN result depend on the architecture, so a NaN result is
+    * replaced by calling the softfloat intrinsic with the same operands, which makes the injected code compute the
+    * same bits as the intrinsic alone. A binop becomes
+    *
+    *    set_local $b  tee_local $a  get_local $b  <op>  tee_local $r  get_local $r  <eq>
+    *    if (result <type>)  get_local $r  else  get_local $a  get_local $b  call <intrinsic>  end
+    *
+    * using three scratch locals per float type, appended to a function the first time it needs them.
+    */
+   struct native_float_injection {
+      static void init( bool native ) {
+         enabled = native;
+         function = nullptr;
+      }
+
+      /// emits the native form of Opcode and returns true, or returns false if Opcode must call its intrinsic
+      template <uint16_t Opcode>
+      static bool inject( wasm_ops::visitor_arg& arg, int32_t intrinsic ) {
+         if( !enabled )
+            return false;
+         using ops = wasm_ops::op_types<>;
+         switch( Opcode ) {
+            case wasm_ops::f32_add_code:  emit<ops::f32_add_t,  ops::f32_eq_t, 2>( arg, ResultType::f32, intrinsic ); return true;
+            case wasm_ops::f32_sub_code:  emit<ops::f32_sub_t,  ops::f32_eq_t, 2>( arg, ResultType::f32, intrinsic ); return true;
+            case wasm_ops::f32_mul_code:  emit<ops::f32_mul_t,  ops::f32_eq_t, 2>( arg, ResultType::f32, intrinsic ); return true;
+            case wasm_ops::f32_div_code:  emit<ops::f32_div_t,  ops::f32_eq_t, 2>( arg, ResultType::f32, intrinsic ); return true;
+            case wasm_ops::f32_sqrt_code: emit<ops::f32_sqrt_t, ops::f32_eq_t, 1>( arg, ResultType::f32, intrinsic ); return true;
+            case wasm_ops::f64_add_code:  emit<ops::f64_add_t,  ops::f64_eq_t, 2>( arg, ResultType::f64, intrinsic ); return true;
+            case wasm_ops::f64_sub_code:  emit<ops::f64_sub_t,  ops::f64_eq_t, 2>( arg, ResultType::f64, intrinsic ); return true;
+            case wasm_ops::f64_mul_code:  emit<ops::f64_mul_t,  ops::f64_eq_t, 2>( arg, ResultType::f64, intrinsic ); return true;
+            case wasm_ops::f64_div_code:  emit<ops::f64_div_t,  ops::f64_eq_t, 2>( arg, ResultType::f64, intrinsic ); return true;
+            case wasm_ops::f64_sqrt_code: emit<ops::f64_sqrt_t, ops::f64_eq_t, 1>( arg, ResultType::f64, intrinsic ); return true;
+            default:
+               return false;
+         }
+      }
+
+      static bool                 enabled;
+
+   private:
+      // index of the first scratch local of the given type in the function being injected
+      static uint32_t scratch_locals( wasm_ops::visitor_arg& arg, ResultType type ) {
+         if( arg.function_def != function ) {
+            function = arg.function_def;
+            f32_locals = f64_locals = UINT32_MAX;
+         }
+         uint32_t& first = type == ResultType::f32 ? f32_locals : f64_locals;
+         if( first == UINT32_MAX ) {
+            FunctionDef& fd = *arg.function_def;
+            first = arg.module->types[fd.type.index]->parameters.size() + fd.nonParameterLocalTypes.size();
+            fd.nonParameterLocalTypes.insert( fd.nonParameterLocalTypes.end(), 3, ValueType(type) );
+         }
+         return first;
+      }
+
+      template <typename Op, typename Eq, int Operands>
+      static void emit( wasm_ops::visitor_arg& arg, ResultType type, int32_t intrinsic ) {
+         const uint32_t a = scratch_locals( arg, type );
+         const uint32_t b = a + 1;
+         const uint32_t r = a + 2;
+
+         wasm_ops::op_types<>::get_local_t get_local;
+         wasm_ops::op_types<>::set_local_t set_local;
+         wasm_ops::op_types<>::tee_local_t tee_local;
+         wasm_ops::op_types<>::if__t       if_inst;
+         wasm_ops::op_types<>::else__t     else_inst;
+         wasm_ops::op_types<>::end_t       end_inst;
+         wasm_ops::op_types<>::call_t      call_inst;
+         Op                                op_inst;
+         Eq                                eq_inst;
+         if_inst.field.result = uint8_t(type);
+         call_inst.field = intrinsic;
+
+         if( Operands == 2 ) {
+            set_local.field = b;
+            set_local.pack(arg.new_code);
+         }
+         tee_local.field = a;
+         tee_local.pack(arg.new_code);
+         if( Operands == 2 ) {
+            get_local.field = b;
+            get_local.pack(arg.new_code);
+         }
+         op_inst.pack(arg.new_code);
+         tee_local.field = r;
+         tee_local.pack(arg.new_code);
+         get_local.field = r;
+         get_local.pack(arg.new_code);
+         eq_inst.pack(arg.new_code);
+         if_inst.pack(arg.new_code);
+         get_local.pack(arg.new_code);
+         else_inst.pack(arg.new_code);
+         get_local.field = a;
+         get_local.pack(arg.new_code);
+         if( Operands == 2 ) {
+            get_local.field = b;
+            get_local.pack(arg.new_code);
+         }
+         call_inst.pack(arg.new_code);
+         end_inst.pack(arg.new_code);
+      }
+
+      static IR::FunctionDef*     function;
+      static uint32_t             f32_locals;
+      static uint32_t             f64_locals;
+   };
+
    template <uint16_t Opcode>
    struct f32_binop_injector {
       static constexpr bool kills = true;
@@ -472,6 +580,8 @@ namespace eosio { namespace chain { namespace wasm_injections {
       static void accept( wasm_ops::instr* inst, wasm_ops::visitor_arg& arg ) {
          int32_t idx;
          injector_utils::add_import<ResultType::f32, ValueType::f32, ValueType::f32>( *(arg.module), inject_which_op(Opcode), idx );
+         if( native_float_injection::inject<Opcode>( arg, idx ) )
+            return;
          wasm_ops::op_types<>::call_t f32op;
          f32op.field = idx;
          f32op.pack(arg.new_code);
@@ -486,6 +596,8 @@ namespace eosio { namespace chain { namespace wasm_injections {
       static void accept( wasm_ops::instr* inst, wasm_ops::visitor_arg& arg ) {
          int32_t idx;
          injector_utils::add_import<ResultType::f32, ValueType::f32>( *(arg.module), inject_which_op(Opcode), idx );
+         if( native_float_injection::inject<Opcode>( arg, idx ) )
+            return;
          wasm_ops::op_types<>::call_t f32op;
          f32op.field = idx;
          f32op.pack(arg.new_code);
@@ -513,6 +625,8 @@ namespace eosio { namespace chain { namespace wasm_injections {
       static void accept( wasm_ops::instr* inst, wasm_ops::visitor_arg& arg ) {
          int32_t idx;
          injector_utils::add_import<ResultType::f64, ValueType::f64, ValueType::f64>( *(arg.module), inject_which_op(Opcode), idx );
+         if( native_float_injection::inject<Opcode>( arg, idx ) )
+            return;
          wasm_ops::op_types<>::call_t f64op;
          f64op.field = idx;
          f64op.pack(arg.new_code);
@@ -527,6 +641,8 @@ namespace eosio { namespace chain { namespace wasm_injections {
       static void accept( wasm_ops::instr* inst, wasm_ops::visitor_arg& arg ) {
          int32_t idx;
          injector_utils::add_import<ResultType::f64, ValueType::f64>( *(arg.module), inject_which_op(Opcode), idx );
+         if( native_float_injection::inject<Opcode>( arg, idx ) )
+            return;
          wasm_ops::op_types<>::call_t f64op;
          f64op.field = idx;
          f64op.pack(arg.new_code);
@@ -780,12 +896,13 @@ namespace eosio { namespace chain { namespace wasm_injections {
       using standard_module_injectors = module_injectors< max_memory_injection_visitor >;
 
       public:
-         wasm_binary_injection( IR::Module& mod )  : _module( &mod ) { 
+         wasm_binary_injection( IR::Module& mod, bool native_float = false )  : _module( &mod ) { 
             _module_injectors.init();
             // initialize static fields of injectors
             injector_utils::init( mod );
             checktime_injection::init();
             call_depth_check::init();
+            native_float_injection::init( native_float );
          }
 
          void inject() {
@@ -0,0 +1,84 @@
+/**
+ *  @file
+ *  @copyright defined in eos/LICENSE
+ */
+#pragma once
+#include <cstdint>
+#include <cstring>
+
+#if defined(__x86_64__) && defined(__SSE2__)
+#include <emmintrin.h>
+#define EOSIO_WASM_HARD_FLOAT 1
+#endif
+
+namespace eosio { namespace chain { namespace hard_float {
+
+   /* Hardware floating point for the operations wasm_eosio_injection.hpp would otherwise replace by softfloat
+    * intrinsics.
+    *
+    * IEEE-754 requires add, sub, mul, div and sqrt to be correctly rounded, so on x86-64 SSE2 with the
+    * default MXCSR (round to nearest even, no flush-to-zero, no denormals-are-zero) they produce the same
+    * bits as softfloat for every finite, infinite or subnormal result. The only divergence is in the payload
+    * and sign of a NaN result, which is architecture specific. Callers canonicalize those by recomputing any
+    * NaN result with softfloat, which keeps the fast path bit-exact with the consensus implementation.
+    *
+    * With hard float enabled, native_float_injection in wasm_eosio_injection.hpp leaves these operations as
+    * wasm opcodes and injects the same canonicalization in wasm: a NaN result is replaced by a call of the
+    * _eosio_* intrinsic, which recomputes it with softfloat. The intrinsics, still called for NaN results
+    * and for the operations that are always injected, take the fast path below. supported() is checked once
+    * when the wasm_interface is created, on the thread that applies contracts.
+    *
+    * The SSE intrinsics are used explicitly so the compiler can neither fall back to x87 nor contract an
+    * operation into a fused multiply-add.
+    */
+
+   inline bool is_nan( float f ) {
+      uint32_t u;
+      memcpy( &u, &f, sizeof(u) );
+      return (u & 0x7FFFFFFFu) > 0x7F800000u;
+   }
+
+   inline bool is_nan( double d ) {
+      uint64_t u;
+      memcpy( &u, &d, sizeof(u) );
+      return (u & 0x7FFFFFFFFFFFFFFFull) > 0x7FF0000000000000ull;
+   }
+
+#ifdef EOSIO_WASM_HARD_FLOAT
+   /// true when the calling thread rounds to nearest even and preserves subnormals
+   inline bool supported() {
+      constexpr uint32_t rounding_control = 0x6000;
+      constexpr uint32_t flush_to_zero    = 0x8000;
+      constexpr uint32_t denormals_zero   = 0x0040;
+      return (_mm_getcsr() & (rounding_control | flush_to_zero | denormals_zero)) == 0;
+   }
+
+   inline float add( float a, float b )  { return _mm_cvtss_f32( _mm_add_ss( _mm_set_ss(a), _mm_set_ss(b) ) ); }
+   inline float sub( float a, float b )  { return _mm_cvtss_f32( _mm_sub_ss( _mm_set_ss(a), _mm_set_ss(b) ) ); }
+   inline float mul( float a, float b )  { return _mm_cvtss_f32( _mm_mul_ss( _mm_set_ss(a), _mm_set_ss(b) ) ); }
+   inline float div( float a, float b )  { return _mm_cvtss_f32( _mm_div_ss( _mm_set_ss(a), _mm_set_ss(b) ) ); }
+   inline float sqrt( float a )          { return _mm_cvtss_f32( _mm_sqrt_ss( _mm_set_ss(a) ) ); }
+
+   inline double add( double a, double b ) { return _mm_cvtsd_f64( _mm_add_sd( _mm_set_sd(a), _mm_set_sd(b) ) ); }
+   inline double sub( double a, double b ) { return _mm_cvtsd_f64( _mm_sub_sd( _mm_set_sd(a), _mm_set_sd(b) ) ); }
+   inline double mul( double a, double b ) { return _mm_cvtsd_f64( _mm_mul_sd( _mm_set_sd(a), _mm_set_sd(b) ) ); }
+   inline double div( double a, double b ) { return _mm_cvtsd_f64( _mm_div_sd( _mm_set_sd(a), _mm_set_sd(b) ) ); }
+   inline double sqrt( double a )          { __m128d x = _mm_set_sd(a); return _mm_cvtsd_f64( _mm_sqrt_sd( x, x ) ); }
+#else
+   inline bool supported() { return false; }
+
+   // never reached when supported() is false, present so callers need no conditional compilation
+   inline float add( float a, float b )    { return a + b; }
+   inline float sub( float a, float b )    { return a - b; }
+   inline float mul( float a, float b )    { return a * b; }
+   inline float div( float a, float b )    { return a / b; }
+   inline float sqrt( float a )            { return __builtin_sqrtf(a); }
+
+   inline double add( double a, double b ) { return a + b; }
+   inline double sub( double a, double b ) { return a - b; }
+   inline double mul( double a, double b ) { return a * b; }
+   inline double div( double a, double b ) { return a / b; }
+   inline double sqrt( double a )          { return __builtin_sqrt(a); }
+#endif
+
+} } } // eosio::chain::hard_float
@@ -1,9 +1,15 @@
 #pragma once
 #include <eosio/chain/types.hpp>
 #include <eosio/chain/exceptions.hpp>
+#include <fc/time.hpp>
+#include <fc/filesystem.hpp>
 #include "Runtime/Linker.h"
 #include "Runtime/Runtime.h"
 
+namespace boost { namespace asio {
+   class thread_pool;
+}}
+
 namespace eosio { namespace chain {
 
    class apply_context;
@@ -45,6 +51,23 @@ namespace eosio { namespace chain {
       };
    } }
 
+   /**
+    * Counters describing the behavior of the instantiation cache. Sizes are measured in bytes of contract
+    * code as set by setcode plus the initial memory image of each module, a proxy for the footprint of compiled
+    * code that is known without serializing the injected module again.
+    */
+   struct wasm_cache_stats {
+      uint64_t          hits = 0;
+      uint64_t          misses = 0;
+      uint64_t          persistent_hits = 0; ///< misses served from the on-disk code cache
+      uint64_t          evictions = 0;
+      uint64_t          async_compiles = 0;  ///< compilations started in the background by setcode
+      uint64_t          promotions = 0;      ///< modules moved from the interpreter to the JIT in tiered mode
+      uint64_t          entries = 0;
+      uint64_t          size = 0;
+      fc::microseconds  compile_time;
+   };
+
    /**
     * @class wasm_interface
     *
@@ -53,21 +76,46 @@ namespace eosio { namespace chain {
       public:
          enum class vm_type {
             wavm,
-            wabt
+            wabt,
+            tiered ///< interpret with wabt, then recompile contracts with wavm in the background once they are hot
          };
 
-         wasm_interface(vm_type vm);
+         /**
+          * @param cache_size maximum total size of instantiated modules kept in the cache, 0 for unbounded
+          * @param cache_max_entries maximum number of instantiated modules kept in the cache, 0 for unbounded
+          * @param tier_up_threshold invocations of a module before it is promoted to wavm, only used by vm_type::tiered
+          * @param code_cache_dir directory of the persistent code cache, empty to disable it
+          * @param hard_float compute floating point add, sub, mul, div and sqrt in hardware where supported, see wasm_hard_float.hpp
+          */
+         wasm_interface(vm_type vm, uint64_t cache_size, uint32_t cache_max_entries, uint32_t tier_up_threshold,
+                        const fc::path& code_cache_dir = fc::path(), bool hard_float = false);
          ~wasm_interface();
 
          //validates code -- does a WASM validation pass and checks the wasm against EOSIO specific constraints
          static void validate(const controller& control, const bytes& code);
 
+         //validates code like above and keeps the parsed module for a following compile_async of the same code
+         void validate(const controller& control, const digest_type& code_id, const bytes& code);
+
+         //Starts injecting and instantiating the module last validated for code_id on the thread pool; a later apply
+         //of the same code waits for it instead of compiling on the calling thread
+         void compile_async(const digest_type& code_id, boost::asio::thread_pool& thread_pool);
+
          //Calls apply or error on a given code
          void apply(const digest_type& code_id, const shared_string& code, apply_context& context);
 
          //Immediately exits currently running wasm. UB is called when no wasm running
          void exit();
 
+         wasm_cache_stats get_cache_stats()const;
+
+         //true when hard float was requested and the floating point environment supports it, decided at construction
+         bool hard_float()const;
+
+         //Waits for the compilations and tier promotions running on the thread pool and moves them into the cache,
+         //so tests can check their outcome without polling
+         void wait_for_background_compiles();
+
       private:
          unique_ptr<struct wasm_interface_impl> my;
          friend class eosio::chain::webassembly::common::intrinsics_accessor;
@@ -79,4 +127,5 @@ namespace eosio{ namespace chain {
    std::istream& operator>>(std::istream& in, wasm_interface::vm_type& runtime);
 }}
 
-FC_REFLECT_ENUM( eosio::chain::wasm_interface::vm_type, (wavm)(wabt) )
+FC_REFLECT_ENUM( eosio::chain::wasm_interface::vm_type, (wavm)(wabt)(tiered) )
+FC_REFLECT( eosio::chain::wasm_cache_stats, (hits)(misses)(persistent_hits)(evictions)(async_compiles)(promotions)(entries)(size)(compile_time) )
@@ -5,10 +5,20 @@
 #include <eosio/chain/webassembly/wabt.hpp>
 #include <eosio/chain/webassembly/runtime_interface.hpp>
 #include <eosio/chain/wasm_eosio_injection.hpp>
+#include <eosio/chain/wasm_code_cache.hpp>
+#include <eosio/chain/wasm_hard_float.hpp>
 #include <eosio/chain/transaction_context.hpp>
 #include <eosio/chain/exceptions.hpp>
+#include <eosio/chain/thread_utils.hpp>
 #include <fc/scoped_exit.hpp>
 
+#include <boost/multi_index_container.hpp>
+#include <boost/multi_index/hashed_index.hpp>
+#include <boost/multi_index/sequenced_index.hpp>
+#include <boost/multi_index/member.hpp>
+
+#include <mutex>
+
 #include "IR/Module.h"
 #include "Runtime/Intrinsics.h"
 #include "Platform/Platform.h"
@@ -22,14 +32,49 @@ using namespace Runtime;
 
 namespace eosio { namespace chain {
 
+   namespace bmi = boost::multi_index;
+
+   struct wasm_cache_entry {
+      digest_type                                              code_id;
+      uint64_t                                                 size = 0; ///< contract code size plus initial memory image
+      std::shared_ptr<wasm_instantiated_module_interface>      module;
+      wasm_runtime_interface*                                  runtime = nullptr; ///< runtime that instantiated module
+      uint32_t                                                 invocations = 0; ///< uses counted towards tiering up
+   };
+
+   struct by_lru;
+   struct by_code_id;
+   typedef bmi::multi_index_container<
+      wasm_cache_entry,
+      bmi::indexed_by<
+         bmi::sequenced< bmi::tag<by_lru> >,
+         bmi::hashed_unique< bmi::tag<by_code_id>, bmi::member<wasm_cache_entry, digest_type, &wasm_cache_entry::code_id>, std::hash<digest_type> >
+      >
+   > wasm_cache_index;
+
    struct wasm_interface_impl {
-      wasm_interface_impl(wasm_interface::vm_type vm) {
+      wasm_interface_impl(wasm_interface::vm_type vm, uint64_t cache_size, uint32_t cache_max_entries, uint32_t tier_up_threshold,
+                          const fc::path& code_cache_dir, bool hard_float)
+      :hard_float(hard_float && hard_float::supported())
+      ,cache_size(cache_size)
+      ,cache_max_entries(cache_max_entries)
+      {
+         if(!code_cache_dir.empty())
+            code_cache.emplace(code_cache_dir, vm, this->hard_float);
+
          if(vm == wasm_interface::vm_type::wavm)
             runtime_interface = std::make_unique<webassembly::wavm::wavm_runtime>();
          else if(vm == wasm_interface::vm_type::wabt)
             runtime_interface = std::make_unique<webassembly::wabt_runtime::wabt_runtime>();
+         else if(vm == wasm_interface::vm_type::tiered) {
+            runtime_interface = std::make_unique<webassembly::wabt_runtime::wabt_runtime>();
+            jit_runtime = std::make_unique<webassembly::wavm::wavm_runtime>();
+            this->tier_up_threshold = std::max<uint32_t>(tier_up_threshold, 1);
+         }
          else
             EOS_THROW(wasm_exception, "wasm_interface_impl fall through");
+
+         running_runtime = runtime_interface.get();
       }
 
       std::vector<uint8_t> parse_initial_memory(const Module& module) {
@@ -50,47 +95,273 @@ namespace eosio { namespace chain {
          return mem_image;
       }
 
-      std::unique_ptr<wasm_instantiated_module_interface>& get_instantiated_module( const digest_type& code_id,
-                                                                                    const shared_string& code,
-                                                                                    transaction_context& trx_context )
-      {
-         auto it = instantiation_cache.find(code_id);
-         if(it == instantiation_cache.end()) {
-            auto timer_pause = fc::make_scoped_exit([&](){
-               trx_context.resume_billing_timer();
-            });
-            trx_context.pause_billing_timer();
-            IR::Module module;
-            try {
-               Serialization::MemoryInputStream stream((const U8*)code.data(), code.size());
-               WASM::serialize(stream, module);
-               module.userSections.clear();
-            } catch(const Serialization::FatalSerializationException& e) {
-               EOS_ASSERT(false, wasm_serialization_error, e.message.c_str());
-            } catch(const IR::ValidationException& e) {
-               EOS_ASSERT(false, wasm_serialization_error, e.message.c_str());
-            }
+      /**
+       *  Evicts least recently used modules until an entry of `incoming_size` bytes fits within the configured
+       *  byte and entry budgets. A budget of 0 means unbounded.
+       */
+      void make_room_for( uint64_t incoming_size ) {
+         auto& lru = instantiation_cache.get<by_lru>();
+         while( !lru.empty() ) {
+            bool over_entries = cache_max_entries && lru.size() + 1 > cache_max_entries;
+            bool over_size    = cache_size && stats.size + incoming_size > cache_size;
+            if( !over_entries && !over_size )
+               break;
+            stats.size -= lru.front().size;
+            ++stats.evictions;
+            dlog( "evicting wasm module ${id} from instantiation cache", ("id", lru.front().code_id) );
+            lru.pop_front();
+         }
+      }
+
+      struct compiled_module {
+         std::shared_ptr<wasm_instantiated_module_interface> module;
+         wasm_runtime_interface*                             runtime = nullptr;
+         uint64_t                                            size = 0;
+         bool                                                from_code_cache = false;
+      };
 
-            wasm_injections::wasm_binary_injection injector(module);
+      static std::unique_ptr<Module> parse_module( const char* code, size_t code_size ) {
+         auto module = std::make_unique<Module>();
+         try {
+            Serialization::MemoryInputStream stream((const U8*)code, code_size);
+            WASM::serialize(stream, *module);
+         } catch(const Serialization::FatalSerializationException& e) {
+            EOS_ASSERT(false, wasm_serialization_error, e.message.c_str());
+         } catch(const IR::ValidationException& e) {
+            EOS_ASSERT(false, wasm_serialization_error, e.message.c_str());
+         }
+         return module;
+      }
+
+      /**
+       *  Injects and instantiates an already parsed module. Safe to call off the main thread: the injector keeps
+       *  its bookkeeping in statics, so injection is serialized, and each runtime serializes its own compilation.
+       *  The module is only serialized back to bytes when the persistent code cache needs them.
+       */
+      compiled_module compile( wasm_runtime_interface& runtime, const digest_type& code_id, std::unique_ptr<Module> module, size_t code_size ) {
+         static std::mutex injection_mutex;
+
+         module->userSections.clear();
+         {
+            std::lock_guard<std::mutex> l(injection_mutex);
+            wasm_injections::wasm_binary_injection injector(*module, hard_float);
             injector.inject();
+         }
 
-            std::vector<U8> bytes;
+         std::vector<uint8_t> initial_memory = parse_initial_memory(*module);
+         if(code_cache) {
+            wasm_code_cache::entry prepared;
             try {
                Serialization::ArrayOutputStream outstream;
-               WASM::serialize(outstream, module);
-               bytes = outstream.getBytes();
+               WASM::serialize(outstream, *module);
+               prepared.code = outstream.getBytes();
             } catch(const Serialization::FatalSerializationException& e) {
                EOS_ASSERT(false, wasm_serialization_error, e.message.c_str());
             } catch(const IR::ValidationException& e) {
                EOS_ASSERT(false, wasm_serialization_error, e.message.c_str());
             }
-            it = instantiation_cache.emplace(code_id, runtime_interface->instantiate_module((const char*)bytes.data(), bytes.size(), parse_initial_memory(module))).first;
+            prepared.code_id = code_id;
+            prepared.initial_memory = initial_memory;
+            code_cache->put(std::move(prepared));
+         }
+
+         compiled_module result;
+         result.runtime = &runtime;
+         result.size = code_size + initial_memory.size();
+         result.module = runtime.instantiate_module(std::move(module), std::move(initial_memory));
+         return result;
+      }
+
+      compiled_module compile( wasm_runtime_interface& runtime, const digest_type& code_id, const char* code, size_t code_size ) {
+         if(code_cache) {
+            if(auto cached = code_cache->get(code_id)) {
+               compiled_module result;
+               result.runtime = &runtime;
+               result.size = code_size + cached->initial_memory.size();
+               result.from_code_cache = true;
+               result.module = runtime.instantiate_module((const char*)cached->code.data(), cached->code.size(), std::move(cached->initial_memory));
+               return result;
+            }
+         }
+         return compile( runtime, code_id, parse_module(code, code_size), code_size );
+      }
+
+      void insert( const digest_type& code_id, const compiled_module& compiled ) {
+         make_room_for( compiled.size );
+         instantiation_cache.get<by_lru>().push_back( wasm_cache_entry{ code_id, compiled.size, compiled.module, compiled.runtime } );
+         stats.size += compiled.size;
+         if( compiled.from_code_cache )
+            ++stats.persistent_hits;
+      }
+
+      /// moves background compilations that have finished into the instantiation cache
+      void harvest_pending_compiles() {
+         for( auto itr = pending_compiles.begin(); itr != pending_compiles.end(); ) {
+            if( itr->second.wait_for( std::chrono::seconds(0) ) != std::future_status::ready ) {
+               ++itr;
+               continue;
+            }
+            try {
+               insert( itr->first, itr->second.get() );
+            } catch( ... ) {
+               // failures are reported when the code is applied and compiled synchronously
+            }
+            itr = pending_compiles.erase( itr );
+         }
+      }
+
+      /// keeps the module parsed by validation so compile_async does not have to parse the code again
+      void set_validated( const digest_type& code_id, std::unique_ptr<Module> module, size_t code_size ) {
+         last_validated.code_id = code_id;
+         last_validated.module = std::move(module);
+         last_validated.code_size = code_size;
+      }
+
+      void compile_async( const digest_type& code_id, boost::asio::thread_pool& thread_pool ) {
+         harvest_pending_compiles();
+         if( !last_validated.module || last_validated.code_id != code_id )
+            return;
+         std::unique_ptr<Module> module = std::move(last_validated.module);
+         if( instantiation_cache.get<by_code_id>().count(code_id) || pending_compiles.count(code_id) )
+            return;
+
+         pending_compiles.emplace( code_id, async_thread_pool( thread_pool,
+               [this, code_id, module=std::move(module), code_size=last_validated.code_size]() mutable {
+            return compile( *runtime_interface, code_id, std::move(module), code_size );
+         } ).share() );
+         ++stats.async_compiles;
+      }
+
+      /**
+       *  In tiered mode counts a use of a module still running on the interpreter and, once it reaches the
+       *  threshold, starts compiling the code with the JIT on the thread pool. The interpreted module keeps
+       *  serving the contract until the JIT module is swapped in by harvest_promotions.
+       */
+      void count_invocation( wasm_cache_index::index<by_code_id>::type::iterator it, const shared_string& code,
+                             boost::asio::thread_pool& thread_pool ) {
+         if( !jit_runtime || it->runtime == jit_runtime.get() )
+            return;
+         auto& by_id = instantiation_cache.get<by_code_id>();
+         by_id.modify( it, []( wasm_cache_entry& e ) { ++e.invocations; } );
+         if( it->invocations != tier_up_threshold || pending_promotions.count(it->code_id) )
+            return;
+
+         pending_promotions.emplace( it->code_id, async_thread_pool( thread_pool,
+               [this, code_id=it->code_id, code=std::string(code.data(), code.size())]() {
+            return compile( *jit_runtime, code_id, code.data(), code.size() );
+         } ).share() );
+      }
+
+      /// replaces interpreted modules by their JIT compiled versions once those are ready
+      void harvest_promotions() {
+         auto& by_id = instantiation_cache.get<by_code_id>();
+         for( auto itr = pending_promotions.begin(); itr != pending_promotions.end(); ) {
+            if( itr->second.wait_for( std::chrono::seconds(0) ) != std::future_status::ready ) {
+               ++itr;
+               continue;
+            }
+            try {
+               compiled_module compiled = itr->second.get();
+               auto it = by_id.find( itr->first );
+               if( it != by_id.end() ) {
+                  by_id.modify( it, [&]( wasm_cache_entry& e ) {
+                     e.module = compiled.module;
+                     e.runtime = compiled.runtime;
+                  } );
+                  ++stats.promotions;
+               }
+            } catch( ... ) {
+               // the contract keeps running on the interpreter
+            }
+            itr = pending_promotions.erase( itr );
          }
-         return it->second;
       }
 
+      /// blocks until every background compilation and promotion has finished and moves their results in
+      void wait_for_background_compiles() {
+         for( auto& p : pending_compiles )
+            p.second.wait();
+         for( auto& p : pending_promotions )
+            p.second.wait();
+         harvest_pending_compiles();
+         harvest_promotions();
+      }
+
+      /// also makes the runtime of the returned module the one exit() unwinds
+      std::shared_ptr<wasm_instantiated_module_interface> get_instantiated_module( const digest_type& code_id,
+                                                                                   const shared_string& code,
+                                                                                   transaction_context& trx_context )
+      {
+         if( !pending_promotions.empty() )
+            harvest_promotions();
+
+         auto& by_id = instantiation_cache.get<by_code_id>();
+         auto it = by_id.find(code_id);
+         if(it != by_id.end()) {
+            ++stats.hits;
+            auto& lru = instantiation_cache.get<by_lru>();
+            lru.relocate( lru.end(), instantiation_cache.project<by_lru>(it) );
+            count_invocation( it, code, trx_context.control.get_thread_pool() );
+            running_runtime = it->runtime;
+            return it->module;
+         }
+
+         ++stats.misses;
+         auto timer_pause = fc::make_scoped_exit([&](){
+            trx_context.resume_billing_timer();
+         });
+         trx_context.pause_billing_timer();
+         auto start = fc::time_point::now();
+
+         auto pending = pending_compiles.find(code_id);
+         if(pending != pending_compiles.end()) {
+            auto compiling = pending->second;
+            pending_compiles.erase(pending);
+            try {
+               compiled_module compiled = compiling.get();
+               insert( code_id, compiled );
+               stats.compile_time += fc::time_point::now() - start;
+               running_runtime = compiled.runtime;
+               return compiled.module;
+            } catch( ... ) {
+               // fall through and compile on this thread so any failure is reported in the transaction context
+            }
+         }
+
+         compiled_module compiled = compile( *runtime_interface, code_id, code.data(), code.size() );
+         insert( code_id, compiled );
+         stats.compile_time += fc::time_point::now() - start;
+         running_runtime = compiled.runtime;
+         return compiled.module;
+      }
+
+      wasm_cache_stats get_cache_stats()const {
+         wasm_cache_stats result = stats;
+         result.entries = instantiation_cache.size();
+         return result;
+      }
+
+      const bool                              hard_float; ///< native float injection and intrinsic fast path
       std::unique_ptr<wasm_runtime_interface> runtime_interface;
-      map<digest_type, std::unique_ptr<wasm_instantiated_module_interface>> instantiation_cache;
+      std::unique_ptr<wasm_runtime_interface> jit_runtime; ///< top tier of vm_type::tiered, null otherwise
+      wasm_runtime_interface*                 running_runtime = nullptr;
+      uint32_t                                tier_up_threshold = 0;
+      wasm_cache_index                        instantiation_cache;
+      uint64_t                                cache_size = 0;
+      uint32_t                                cache_max_entries = 0;
+      wasm_cache_stats                        stats;
+      optional<wasm_code_cache>               code_cache;
+
+      using pending_compile = std::shared_future<compiled_module>;
+      map<digest_type, pending_compile>       pending_compiles;
+      map<digest_type, pending_compile>       pending_promotions;
+
+      struct validated_module {
+         digest_type             code_id;
+         std::unique_ptr<Module> module;
+         size_t                  code_size = 0;
+      };
+      validated_module                        last_validated;
    };
 
 #define _REGISTER_INTRINSIC_EXPLICIT(CLS, MOD, METHOD, WASM_SIG, NAME, SIG)\
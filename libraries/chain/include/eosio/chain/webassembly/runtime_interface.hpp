@@ -2,6 +2,10 @@
 #include <vector>
 #include <memory>
 
+namespace IR {
+   struct Module;
+}
+
 namespace eosio { namespace chain {
 
 class apply_context;
@@ -17,6 +21,9 @@ class wasm_runtime_interface {
    public:
       virtual std::unique_ptr<wasm_instantiated_module_interface> instantiate_module(const char* code_bytes, size_t code_size, std::vector<uint8_t> initial_memory) = 0;
 
+      //instantiate an already parsed and injected module. The default serializes it for runtimes that can only consume bytes
+      virtual std::unique_ptr<wasm_instantiated_module_interface> instantiate_module(std::unique_ptr<IR::Module> module, std::vector<uint8_t> initial_memory);
+
       //immediately exit the currently running wasm_instantiated_module_interface. Yep, this assumes only one can possibly run at a time.
       virtual void immediately_exit_currently_running_module() = 0;
 
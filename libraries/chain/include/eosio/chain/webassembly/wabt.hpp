@@ -51,6 +51,7 @@ class wabt_runtime : public eosio::chain::wasm_runtime_interface {
    public:
       wabt_runtime();
       std::unique_ptr<wasm_instantiated_module_interface> instantiate_module(const char* code_bytes, size_t code_size, std::vector<uint8_t> initial_memory) override;
+      using wasm_runtime_interface::instantiate_module;
 
       void immediately_exit_currently_running_module() override;
 
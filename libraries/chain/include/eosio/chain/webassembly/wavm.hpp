@@ -21,6 +21,7 @@ class wavm_runtime : public eosio::chain::wasm_runtime_interface {
       wavm_runtime();
       ~wavm_runtime();
       std::unique_ptr<wasm_instantiated_module_interface> instantiate_module(const char* code_bytes, size_t code_size, std::vector<uint8_t> initial_memory) override;
+      std::unique_ptr<wasm_instantiated_module_interface> instantiate_module(std::unique_ptr<IR::Module> module, std::vector<uint8_t> initial_memory) override;
 
       void immediately_exit_currently_running_module() override;
 
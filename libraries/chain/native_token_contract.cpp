@@ -0,0 +1,175 @@
+/**
+ *  @file
+ *  @copyright defined in eos/LICENSE
+ */
+#include <eosio/chain/native_token_contract.hpp>
+#include <eosio/chain/apply_context.hpp>
+
+#include <cstring>
+
+namespace eosio { namespace chain {
+
+   namespace {
+
+      /// asset as packed by eosiolib
+      struct token_asset {
+         int64_t  amount = 0;
+         uint64_t symbol = 0;
+
+         static constexpr int64_t max_amount = (1LL << 62) - 1;
+
+         uint64_t symbol_name()const { return symbol >> 8; }
+
+         /// eosiolib's is_valid_symbol: one to seven upper case letters, left aligned
+         bool symbol_is_valid()const {
+            uint64_t sym = symbol >> 8;
+            for( int i = 0; i < 7; ++i ) {
+               char c = (char)(sym & 0xff);
+               if( !('A' <= c && c <= 'Z') ) return false;
+               sym >>= 8;
+               if( !(sym & 0xff) ) {
+                  do {
+                     sym >>= 8;
+                     if( (sym & 0xff) ) return false;
+                     ++i;
+                  } while( i < 7 );
+               }
+            }
+            return true;
+         }
+
+         bool is_valid()const {
+            return -max_amount <= amount && amount <= max_amount && symbol_is_valid();
+         }
+      };
+
+      class token_reader {
+         public:
+            token_reader( const char* data, size_t size ) : pos(data), end(data + size) {}
+
+            template<typename T>
+            bool read( T& v ) {
+               if( size_t(end - pos) < sizeof(T) ) return false;
+               memcpy( &v, pos, sizeof(T) );
+               pos += sizeof(T);
+               return true;
+            }
+
+            bool read( token_asset& a ) {
+               return read( a.amount ) && read( a.symbol );
+            }
+
+            /// string length prefix, limited to the lengths decoded identically by eosiolib
+            bool read_length( uint32_t& len ) {
+               len = 0;
+               for( uint32_t shift = 0; shift < 28; shift += 7 ) {
+                  uint8_t b;
+                  if( !read( b ) ) return false;
+                  len |= uint32_t(b & 0x7f) << shift;
+                  if( !(b & 0x80) ) return true;
+               }
+               return false;
+            }
+
+            bool skip( size_t n ) {
+               if( size_t(end - pos) < n ) return false;
+               pos += n;
+               return true;
+            }
+
+         private:
+            const char* pos;
+            const char* end;
+      };
+
+      /// iterator of the row with primary key `id` in a table of the contract, negative when there is none
+      int find_row( apply_context& context, uint64_t scope, uint64_t table, uint64_t id ) {
+         return context.db_find_i64( context.receiver, scope, table, id );
+      }
+
+      /// reads the leading asset of a row the contract unpacks from at least `min_size` bytes
+      bool load_row( apply_context& context, int iterator, size_t min_size, token_asset& a ) {
+         int size = context.db_get_i64( iterator, nullptr, 0 );
+         if( size < 0 || size_t(size) < min_size ) return false;
+         char buffer[sizeof(int64_t) + sizeof(uint64_t)];
+         context.db_get_i64( iterator, buffer, sizeof(buffer) );
+         token_reader r( buffer, sizeof(buffer) );
+         return r.read( a );
+      }
+
+      void pack( const token_asset& a, char (&buffer)[16] ) {
+         memcpy( buffer, &a.amount, sizeof(a.amount) );
+         memcpy( buffer + sizeof(a.amount), &a.symbol, sizeof(a.symbol) );
+      }
+
+   } // anonymous namespace
+
+   bool apply_native_token_transfer( apply_context& context ) {
+      // EOSIO_ABI only dispatches actions sent to the contract itself; notifications and other actions stay in WASM
+      if( context.receiver != context.act.account || context.act.name != N(transfer) )
+         return false;
+
+      const auto& data = context.act.data;
+      token_reader r( data.data(), data.size() );
+      uint64_t    from = 0, to = 0;
+      token_asset quantity;
+      uint32_t    memo_size = 0;
+      if( !r.read( from ) || !r.read( to ) || !r.read( quantity ) || !r.read_length( memo_size ) || !r.skip( memo_size ) )
+         return false;
+
+      if( from == to || !context.has_authorization( from ) || !context.is_account( to ) )
+         return false;
+
+      const uint64_t sym = quantity.symbol_name();
+      token_asset supply; // currency_stats is supply, max_supply and issuer
+      int st_itr = find_row( context, sym, N(stat), sym );
+      if( st_itr < 0 || !load_row( context, st_itr, 2 * sizeof(supply) + sizeof(uint64_t), supply ) )
+         return false;
+
+      if( !quantity.is_valid() || quantity.amount <= 0 || quantity.symbol != supply.symbol || memo_size > 256 )
+         return false;
+
+      token_asset from_balance;
+      int from_itr = find_row( context, from, N(accounts), sym );
+      if( from_itr < 0 || !load_row( context, from_itr, sizeof(from_balance), from_balance ) )
+         return false;
+      if( from_balance.symbol != quantity.symbol || from_balance.amount < quantity.amount )
+         return false;
+
+      token_asset to_balance;
+      int to_itr = find_row( context, to, N(accounts), sym );
+      bool to_exists = to_itr >= 0;
+      if( to_exists ) {
+         if( !load_row( context, to_itr, sizeof(to_balance), to_balance ) )
+            return false;
+         if( to_balance.symbol != quantity.symbol || to_balance.amount < 0 ||
+             to_balance.amount > token_asset::max_amount - quantity.amount )
+            return false;
+      }
+
+      // every check of the contract passed, apply its effects in the order it does
+      context.require_authorization( from );
+      context.require_recipient( from );
+      context.require_recipient( to );
+
+      char buffer[16];
+      if( from_balance.amount == quantity.amount ) {
+         context.db_remove_i64( from_itr );
+      } else {
+         from_balance.amount -= quantity.amount;
+         pack( from_balance, buffer );
+         context.db_update_i64( from_itr, from, buffer, sizeof(buffer) );
+      }
+
+      if( to_exists ) {
+         to_balance.amount += quantity.amount;
+         pack( to_balance, buffer );
+         context.db_update_i64( to_itr, account_name(), buffer, sizeof(buffer) );
+      } else {
+         pack( quantity, buffer );
+         context.db_store_i64( to, N(accounts), from, sym, buffer, sizeof(buffer) );
+      }
+      return true;
+   }
+
+} } /// namespace eosio::chain
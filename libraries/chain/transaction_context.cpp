@@ -166,6 +166,8 @@ namespace bacc = boost::accumulators;
       trace->block_time = c.pending_block_time();
       trace->producer_block_id = c.pending_producer_block_id();
       executed.reserve( trx.total_actions() );
+      if( c.tracks_access_sets() )
+         accesses = std::make_unique<access_set>();
       EOS_ASSERT( trx.transaction_extensions.size() == 0, unsupported_feature, "we don't support any extensions yet" );
    }
 
@@ -399,6 +401,9 @@ namespace bacc = boost::accumulators;
 
       validate_cpu_usage_to_bill( billed_cpu_time_us );
 
+      if( accesses )
+         accesses->resource_accounts.insert( bill_to_accounts.begin(), bill_to_accounts.end() );
+
       rl.add_transaction_usage( bill_to_accounts, static_cast<uint64_t>(billed_cpu_time_us), net_usage,
                                 block_timestamp_type(control.pending_block_time()).slot ); // Should never fail
    }
@@ -528,6 +533,8 @@ namespace bacc = boost::accumulators;
       if( ram_delta > 0 ) {
          validate_ram_usage.insert( account );
       }
+      if( accesses )
+         accesses->resource_accounts.insert( account );
    }
 
    uint32_t transaction_context::update_billed_cpu_time( fc::time_point now ) {
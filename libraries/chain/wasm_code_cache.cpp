@@ -0,0 +1,91 @@
+/**
+ *  @file
+ *  @copyright defined in eos/LICENSE
+ */
+#include <eosio/chain/wasm_code_cache.hpp>
+#include <eosio/chain/exceptions.hpp>
+#include <fc/io/fstream.hpp>
+#include <fc/io/raw.hpp>
+#include <boost/filesystem/operations.hpp>
+#include <fstream>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace eosio { namespace chain {
+
+   const uint32_t wasm_code_cache::version = 2;
+
+   fc::sha256 wasm_code_cache::entry::compute_checksum()const {
+      fc::sha256::encoder enc;
+      fc::raw::pack( enc, code );
+      fc::raw::pack( enc, initial_memory );
+      return enc.result();
+   }
+
+   wasm_code_cache::wasm_code_cache( const fc::path& dir, wasm_interface::vm_type vm, bool native_float )
+   :dir(dir), vm(vm), native_float(native_float) {
+      if( !fc::is_directory( dir ) )
+         fc::create_directories( dir );
+   }
+
+   fc::path wasm_code_cache::file_for( const digest_type& code_id )const {
+      return dir / (code_id.str() + "-" + fc::reflector<wasm_interface::vm_type>::to_string(vm) + (native_float ? "-hard-float" : "")
+                    + "-v" + std::to_string(version) + ".wasm");
+   }
+
+   optional<wasm_code_cache::entry> wasm_code_cache::get( const digest_type& code_id )const {
+      auto file = file_for( code_id );
+      if( !fc::exists( file ) )
+         return optional<entry>();
+
+      try {
+         string content;
+         fc::read_file_contents( file, content );
+
+         entry e;
+         fc::datastream<const char*> ds( content.data(), content.size() );
+         fc::raw::unpack( ds, e );
+         if( e.version == version && e.code_id == code_id && e.checksum == e.compute_checksum() )
+            return e;
+         wlog( "discarding stale or damaged cached wasm module ${f}", ("f", file.generic_string()) );
+      } catch( const fc::exception& ex ) {
+         wlog( "unable to read cached wasm module ${f}: ${e}", ("f", file.generic_string())("e", ex.to_string()) );
+      }
+
+      fc::remove( file );
+      return optional<entry>();
+   }
+
+   void wasm_code_cache::put( entry e )const {
+      e.version = version;
+      e.checksum = e.compute_checksum();
+      auto file = file_for( e.code_id );
+      fc::path tmp_file = file.generic_string() + ".tmp";
+
+      try {
+         {
+            std::ofstream out;
+            out.exceptions( std::ofstream::failbit | std::ofstream::badbit );
+            out.open( tmp_file.generic_string().c_str(), std::ios::out | std::ios::binary | std::ofstream::trunc );
+            fc::raw::pack( out, e );
+            out.close();
+         }
+         // sync before the rename so a crash never leaves a renamed but unwritten entry behind
+         int fd = ::open( tmp_file.generic_string().c_str(), O_RDONLY );
+         EOS_ASSERT( fd >= 0, wasm_exception, "unable to open ${f} for fsync", ("f", tmp_file) );
+         int r = ::fsync( fd );
+         ::close( fd );
+         EOS_ASSERT( r == 0, wasm_exception, "fsync of ${f} failed", ("f", tmp_file) );
+         fc::rename( tmp_file, file );
+         return;
+      } catch( const fc::exception& ex ) {
+         wlog( "unable to write cached wasm module ${f}: ${e}", ("f", file.generic_string())("e", ex.to_string()) );
+      } catch( const std::exception& ex ) {
+         wlog( "unable to write cached wasm module ${f}: ${e}", ("f", file.generic_string())("e", ex.what()) );
+      }
+      boost::system::error_code ec;
+      boost::filesystem::remove( tmp_file.generic_string(), ec );
+   }
+
+} } /// eosio::chain
@@ -49,4 +49,9 @@ std::queue<std::vector<size_t>>      checktime_block_type::orderings;
 std::queue<std::map<size_t, size_t>> checktime_block_type::bcnt_tables;
 size_t  checktime_function_end::fcnt = 0;
 
+bool             native_float_injection::enabled = false;
+IR::FunctionDef* native_float_injection::function = nullptr;
+uint32_t         native_float_injection::f32_locals = UINT32_MAX;
+uint32_t         native_float_injection::f64_locals = UINT32_MAX;
+
 }}} // namespace eosio, chain, injectors
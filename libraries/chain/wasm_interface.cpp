@@ -10,6 +10,7 @@
 #include <eosio/chain/wasm_interface_private.hpp>
 #include <eosio/chain/wasm_eosio_validation.hpp>
 #include <eosio/chain/wasm_eosio_injection.hpp>
+#include <eosio/chain/wasm_hard_float.hpp>
 #include <eosio/chain/global_property_object.hpp>
 #include <eosio/chain/account_object.hpp>
 #include <fc/exception/exception.hpp>
@@ -27,43 +28,87 @@ namespace eosio { namespace chain {
    using namespace webassembly;
    using namespace webassembly::common;
 
-   wasm_interface::wasm_interface(vm_type vm) : my( new wasm_interface_impl(vm) ) {}
+   wasm_interface::wasm_interface(vm_type vm, uint64_t cache_size, uint32_t cache_max_entries, uint32_t tier_up_threshold,
+                                  const fc::path& code_cache_dir, bool hard_float)
+   : my( new wasm_interface_impl(vm, cache_size, cache_max_entries, tier_up_threshold, code_cache_dir, hard_float) ) {}
 
    wasm_interface::~wasm_interface() {}
 
-   void wasm_interface::validate(const controller& control, const bytes& code) {
-      Module module;
-      try {
-         Serialization::MemoryInputStream stream((U8*)code.data(), code.size());
-         WASM::serialize(stream, module);
-      } catch(const Serialization::FatalSerializationException& e) {
-         EOS_ASSERT(false, wasm_serialization_error, e.message.c_str());
-      } catch(const IR::ValidationException& e) {
-         EOS_ASSERT(false, wasm_serialization_error, e.message.c_str());
-      }
+   static std::unique_ptr<Module> validate_module(const controller& control, const bytes& code) {
+      std::unique_ptr<Module> module = wasm_interface_impl::parse_module(code.data(), code.size());
 
-      wasm_validations::wasm_binary_validation validator(control, module);
+      wasm_validations::wasm_binary_validation validator(control, *module);
       validator.validate();
 
       root_resolver resolver(true);
-      LinkResult link_result = linkModule(module, resolver);
+      LinkResult link_result = linkModule(*module, resolver);
+
+      //intrinsics added after a chain launched are unresolvable for nodes that predate them, so contracts may only
+      // import them once a privileged contract activated them on chain
+      if( !control.is_db_scan_active() ) {
+         for( const auto& import : module->functions.imports )
+            EOS_ASSERT( import.exportName != "db_scan_i64", wasm_exception, "db_scan_i64 is not activated on this chain" );
+      }
+
+      return module;
+   }
+
+   void wasm_interface::validate(const controller& control, const bytes& code) {
+      validate_module(control, code);
+   }
+
+   void wasm_interface::validate(const controller& control, const digest_type& code_id, const bytes& code) {
+      my->set_validated(code_id, validate_module(control, code), code.size());
+   }
 
-      //there are a couple opportunties for improvement here--
-      //Easy: Cache the Module created here so it can be reused for instantiaion
-      //Hard: Kick off instantiation in a separate thread at this location
-	 }
+   void wasm_interface::compile_async( const digest_type& code_id, boost::asio::thread_pool& thread_pool ) {
+      my->compile_async( code_id, thread_pool );
+   }
 
    void wasm_interface::apply( const digest_type& code_id, const shared_string& code, apply_context& context ) {
+      if( context.profile ) {
+         auto start = fc::time_point::now();
+         auto module = my->get_instantiated_module(code_id, code, context.trx_context);
+         context.profile->compile_time += fc::time_point::now() - start;
+         module->apply(context);
+         return;
+      }
       my->get_instantiated_module(code_id, code, context.trx_context)->apply(context);
    }
 
    void wasm_interface::exit() {
-      my->runtime_interface->immediately_exit_currently_running_module();
+      my->running_runtime->immediately_exit_currently_running_module();
+   }
+
+   wasm_cache_stats wasm_interface::get_cache_stats()const {
+      return my->get_cache_stats();
+   }
+
+   bool wasm_interface::hard_float()const {
+      return my->hard_float;
+   }
+
+   void wasm_interface::wait_for_background_compiles() {
+      my->wait_for_background_compiles();
    }
 
    wasm_instantiated_module_interface::~wasm_instantiated_module_interface() {}
    wasm_runtime_interface::~wasm_runtime_interface() {}
 
+   std::unique_ptr<wasm_instantiated_module_interface> wasm_runtime_interface::instantiate_module(std::unique_ptr<IR::Module> module, std::vector<uint8_t> initial_memory) {
+      std::vector<U8> bytes;
+      try {
+         Serialization::ArrayOutputStream outstream;
+         WASM::serialize(outstream, *module);
+         bytes = outstream.getBytes();
+      } catch(const Serialization::FatalSerializationException& e) {
+         EOS_ASSERT(false, wasm_serialization_error, e.message.c_str());
+      } catch(const IR::ValidationException& e) {
+         EOS_ASSERT(false, wasm_serialization_error, e.message.c_str());
+      }
+      return instantiate_module((const char*)bytes.data(), bytes.size(), std::move(initial_memory));
+   }
+
 #if defined(assert)
    #undef assert
 #endif
@@ -109,24 +154,21 @@ class privileged_api : public context_aware_api {
       }
 
       /**
-       * This should return true if a feature is active and irreversible, false if not.
-       *
-       * Irreversiblity by fork-database is not consensus safe, therefore, this defines
-       * irreversiblity only by block headers not by BFT short-cut.
+       * Returns true if the feature is in effect in the current block, false if it is not
+       * activated or only activated by the current block.
        */
       int is_feature_active( int64_t feature_name ) {
-         return false;
+         return context.control.is_feature_active( feature_name );
       }
 
       /**
-       *  This should schedule the feature to be activated once the
-       *  block that includes this call is irreversible. It should
-       *  fail if the feature is already pending.
+       *  Activates the feature from the block following the one that includes this call.
+       *  Fails for an unknown feature and for a feature that is already activated.
        *
        *  Feature name should be base32 encoded name.
        */
       void activate_feature( int64_t feature_name ) {
-         EOS_ASSERT( false, unsupported_feature, "Unsupported Hardfork Detected" );
+         context.control.activate_feature( feature_name );
       }
 
       /**
@@ -209,22 +251,39 @@ class softfloat_api : public context_aware_api {
    public:
       // TODO add traps on truncations for special cases (NaN or outside the range which rounds to an integer)
       softfloat_api( apply_context& ctx )
-      :context_aware_api(ctx, true) {}
+      :context_aware_api(ctx, true)
+      ,hard(ctx.control.wasm_hard_float()) {}
 
       // float binops
       float _eosio_f32_add( float a, float b ) {
+         if( hard ) {
+            float r = hard_float::add( a, b );
+            if( !hard_float::is_nan(r) ) return r;
+         }
          float32_t ret = f32_add( to_softfloat32(a), to_softfloat32(b) );
          return *reinterpret_cast<float*>(&ret);
       }
       float _eosio_f32_sub( float a, float b ) {
+         if( hard ) {
+            float r = hard_float::sub( a, b );
+            if( !hard_float::is_nan(r) ) return r;
+         }
          float32_t ret = f32_sub( to_softfloat32(a), to_softfloat32(b) );
          return *reinterpret_cast<float*>(&ret);
       }
       float _eosio_f32_div( float a, float b ) {
+         if( hard ) {
+            float r = hard_float::div( a, b );
+            if( !hard_float::is_nan(r) ) return r;
+         }
          float32_t ret = f32_div( to_softfloat32(a), to_softfloat32(b) );
          return *reinterpret_cast<float*>(&ret);
       }
       float _eosio_f32_mul( float a, float b ) {
+         if( hard ) {
+            float r = hard_float::mul( a, b );
+            if( !hard_float::is_nan(r) ) return r;
+         }
          float32_t ret = f32_mul( to_softfloat32(a), to_softfloat32(b) );
          return *reinterpret_cast<float*>(&ret);
       }
@@ -279,6 +338,10 @@ class softfloat_api : public context_aware_api {
          return from_softfloat32(a);
       }
       float _eosio_f32_sqrt( float a ) {
+         if( hard ) {
+            float r = hard_float::sqrt( a );
+            if( !hard_float::is_nan(r) ) return r;
+         }
          float32_t ret = f32_sqrt( to_softfloat32(a) );
          return from_softfloat32(ret);
       }
@@ -382,18 +445,34 @@ class softfloat_api : public context_aware_api {
 
       // double binops
       double _eosio_f64_add( double a, double b ) {
+         if( hard ) {
+            double r = hard_float::add( a, b );
+            if( !hard_float::is_nan(r) ) return r;
+         }
          float64_t ret = f64_add( to_softfloat64(a), to_softfloat64(b) );
          return from_softfloat64(ret);
       }
       double _eosio_f64_sub( double a, double b ) {
+         if( hard ) {
+            double r = hard_float::sub( a, b );
+            if( !hard_float::is_nan(r) ) return r;
+         }
          float64_t ret = f64_sub( to_softfloat64(a), to_softfloat64(b) );
          return from_softfloat64(ret);
       }
       double _eosio_f64_div( double a, double b ) {
+         if( hard ) {
+            double r = hard_float::div( a, b );
+            if( !hard_float::is_nan(r) ) return r;
+         }
          float64_t ret = f64_div( to_softfloat64(a), to_softfloat64(b) );
          return from_softfloat64(ret);
       }
       double _eosio_f64_mul( double a, double b ) {
+         if( hard ) {
+            double r = hard_float::mul( a, b );
+            if( !hard_float::is_nan(r) ) return r;
+         }
          float64_t ret = f64_mul( to_softfloat64(a), to_softfloat64(b) );
          return from_softfloat64(ret);
       }
@@ -443,6 +522,10 @@ class softfloat_api : public context_aware_api {
          return from_softfloat64(a);
       }
       double _eosio_f64_sqrt( double a ) {
+         if( hard ) {
+            double r = hard_float::sqrt( a );
+            if( !hard_float::is_nan(r) ) return r;
+         }
          float64_t ret = f64_sqrt( to_softfloat64(a) );
          return from_softfloat64(ret);
       }
@@ -661,6 +744,8 @@ class softfloat_api : public context_aware_api {
 
       static constexpr uint32_t inv_float_eps = 0x4B000000;
       static constexpr uint64_t inv_double_eps = 0x4330000000000000;
+
+      const bool hard; ///< compute add, sub, mul, div and sqrt in hardware, see wasm_hard_float.hpp
 };
 
 class producer_api : public context_aware_api {
@@ -1220,7 +1305,11 @@ class console_api : public context_aware_api {
 
 class database_api : public context_aware_api {
    public:
-      using context_aware_api::context_aware_api;
+      database_api( apply_context& ctx )
+      :context_aware_api(ctx) {
+         if( context.profile )
+            ++context.profile->db_calls;
+      }
 
       int db_store_i64( uint64_t scope, uint64_t table, uint64_t payer, uint64_t id, array_ptr<const char> buffer, size_t buffer_size ) {
          return context.db_store_i64( scope, table, payer, id, buffer, buffer_size );
@@ -1252,6 +1341,9 @@ class database_api : public context_aware_api {
       int db_end_i64( uint64_t code, uint64_t scope, uint64_t table ) {
          return context.db_end_i64( code, scope, table );
       }
+      int db_scan_i64( int itr, array_ptr<char> buffer, size_t buffer_size, uint32_t max_rows ) {
+         return context.db_scan_i64( itr, buffer, buffer_size, max_rows );
+      }
 
       DB_API_METHOD_WRAPPERS_SIMPLE_SECONDARY(idx64,  uint64_t)
       DB_API_METHOD_WRAPPERS_SIMPLE_SECONDARY(idx128, uint128_t)
@@ -1734,6 +1826,7 @@ REGISTER_INTRINSICS( database_api,
    (db_lowerbound_i64,   int(int64_t,int64_t,int64_t,int64_t))
    (db_upperbound_i64,   int(int64_t,int64_t,int64_t,int64_t))
    (db_end_i64,          int(int64_t,int64_t,int64_t))
+   (db_scan_i64,         int(int, int, int, int))
 
    DB_SECONDARY_INDEX_METHODS_SIMPLE(idx64)
    DB_SECONDARY_INDEX_METHODS_SIMPLE(idx128)
@@ -1900,6 +1993,8 @@ std::istream& operator>>(std::istream& in, wasm_interface::vm_type& runtime) {
       runtime = eosio::chain::wasm_interface::vm_type::wavm;
    else if (s == "wabt")
       runtime = eosio::chain::wasm_interface::vm_type::wabt;
+   else if (s == "tiered")
+      runtime = eosio::chain::wasm_interface::vm_type::tiered;
    else
       in.setstate(std::ios_base::failbit);
    return in;
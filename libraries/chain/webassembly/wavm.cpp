@@ -13,6 +13,7 @@
 #include "Runtime/Intrinsics.h"
 
 #include <mutex>
+#include <set>
 
 using namespace IR;
 using namespace Runtime;
@@ -21,13 +22,32 @@ namespace eosio { namespace chain { namespace webassembly { namespace wavm {
 
 running_instance_context the_running_instance_context;
 
+//ModuleInstances are owned by WAVM's object garbage collector. Track the ones still referenced by a
+// wavm_instantiated_module so instances evicted from the instantiation cache can actually be freed.
+static std::set<ModuleInstance*> __live_instances;
+static bool __instances_released = false;
+static std::mutex __live_instances_lock;
+//LLVMJIT and WAVM's object bookkeeping are not thread safe; instantiation may happen on the controller's thread pool
+static std::mutex __instantiate_lock;
+
 class wavm_instantiated_module : public wasm_instantiated_module_interface {
    public:
       wavm_instantiated_module(ModuleInstance* instance, std::unique_ptr<Module> module, std::vector<uint8_t> initial_mem) :
          _initial_memory(initial_mem),
+         _memory_image(createMemoryImage(_initial_memory.data(), _initial_memory.size())),
          _instance(instance),
          _module(std::move(module))
-      {}
+      {
+         std::lock_guard<std::mutex> l(__live_instances_lock);
+         __live_instances.insert(_instance);
+      }
+
+      ~wavm_instantiated_module() {
+         destroyMemoryImage(_memory_image);
+         std::lock_guard<std::mutex> l(__live_instances_lock);
+         __live_instances.erase(_instance);
+         __instances_released = true;
+      }
 
       void apply(apply_context& context) override {
          vector<Value> args = {Value(uint64_t(context.receiver)),
@@ -50,12 +70,18 @@ class wavm_instantiated_module : public wasm_instantiated_module_interface {
             // that didn't declare "memory", getDefaultMemory() won't see it
             MemoryInstance* default_mem = getDefaultMemory(_instance);
             if(default_mem) {
-               //reset memory resizes the sandbox'ed memory to the module's init memory size and then
-               // (effectively) memzeros it all
-               resetMemory(default_mem, _module->memories.defs[0].type);
-
-               char* memstart = &memoryRef<char>(getDefaultMemory(_instance), 0);
-               memcpy(memstart, _initial_memory.data(), _initial_memory.size());
+               //map the initial memory image copy-on-write so only the pages the previous action dirtied are
+               // discarded; fall back to resizing, zeroing and copying when there is no image (e.g. no file
+               // descriptor was available to create it) or it can't be mapped. Both resetMemoryFromImage and
+               // resetMemory unmap another module's image before resetting, so the fallback always starts from zeroes
+               if(!_memory_image || !resetMemoryFromImage(default_mem, _module->memories.defs[0].type, _memory_image)) {
+                  //reset memory resizes the sandbox'ed memory to the module's init memory size and then
+                  // (effectively) memzeros it all
+                  resetMemory(default_mem, _module->memories.defs[0].type);
+
+                  char* memstart = &memoryRef<char>(getDefaultMemory(_instance), 0);
+                  memcpy(memstart, _initial_memory.data(), _initial_memory.size());
+               }
             }
 
             the_running_instance_context.memory = default_mem;
@@ -75,6 +101,8 @@ class wavm_instantiated_module : public wasm_instantiated_module_interface {
 
 
       std::vector<uint8_t>     _initial_memory;
+      //owned; null when the platform can't map memory images
+      MemoryImage*             _memory_image;
       //naked pointer because ModuleInstance is opaque
       //_instance is deleted via WAVM's object garbage collection when wavm_rutime is deleted
       ModuleInstance*          _instance;
@@ -119,12 +147,30 @@ std::unique_ptr<wasm_instantiated_module_interface> wavm_runtime::instantiate_mo
       EOS_ASSERT(false, wasm_serialization_error, e.message.c_str());
    }
 
+   return instantiate_module(std::move(module), std::move(initial_memory));
+}
+
+std::unique_ptr<wasm_instantiated_module_interface> wavm_runtime::instantiate_module(std::unique_ptr<Module> module, std::vector<uint8_t> initial_memory) {
+   std::lock_guard<std::mutex> instantiate_guard(__instantiate_lock);
+   {
+      //collect instances of modules that were destroyed since the last instantiation
+      std::lock_guard<std::mutex> l(__live_instances_lock);
+      if(__instances_released) {
+         std::vector<ObjectInstance*> roots;
+         roots.reserve(__live_instances.size());
+         for(ModuleInstance* live : __live_instances)
+            roots.push_back(asObject(live));
+         Runtime::freeUnreferencedObjects(std::move(roots));
+         __instances_released = false;
+      }
+   }
+
    eosio::chain::webassembly::common::root_resolver resolver;
    LinkResult link_result = linkModule(*module, resolver);
    ModuleInstance *instance = instantiateModule(*module, std::move(link_result.resolvedImports));
    EOS_ASSERT(instance != nullptr, wasm_exception, "Fail to Instantiate WAVM Module");
 
-   return std::make_unique<wavm_instantiated_module>(instance, std::move(module), initial_memory);
+   return std::make_unique<wavm_instantiated_module>(instance, std::move(module), std::move(initial_memory));
 }
 
 void wavm_runtime::immediately_exit_currently_running_module() {
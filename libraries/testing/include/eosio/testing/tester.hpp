@@ -84,6 +84,10 @@ namespace eosio { namespace testing {
 
          void              init(bool push_genesis = true, db_read_mode read_mode = db_read_mode::SPECULATIVE);
          void              init(controller::config config, const snapshot_reader_ptr& snapshot = nullptr);
+         void              init(controller::config config, bool push_genesis);
+
+         // The config init(bool) starts a chain with, rooted in tempdir; tests adjust it before starting a tester on it
+         static controller::config default_config(const fc::temp_directory& tempdir);
 
          void              close();
          void              open( const snapshot_reader_ptr& snapshot );
@@ -196,6 +200,8 @@ namespace eosio { namespace testing {
          void              set_code( account_name name, const char* wast, const private_key_type* signer = nullptr );
          void              set_code( account_name name, const vector<uint8_t> wasm, const private_key_type* signer = nullptr  );
          void              set_abi( account_name name, const char* abi_json, const private_key_type* signer = nullptr );
+         /// activates a feature with the activate action of the bios contract and produces the block it takes effect in
+         void              activate_feature( account_name feature_name );
 
          bool                          chain_has_transaction( const transaction_id_type& txid ) const;
          const transaction_receipt&    get_transaction_receipt( const transaction_id_type& txid ) const;
@@ -297,6 +303,10 @@ namespace eosio { namespace testing {
          init(config);
       }
 
+      tester(controller::config config, bool push_genesis) {
+         init(config, push_genesis);
+      }
+
       signed_block_ptr produce_block( fc::microseconds skip_time = fc::milliseconds(config::block_interval_ms), uint32_t skip_flag = 0/*skip_missed_block_penalty*/ )override {
          return _produce_block(skip_time, false, skip_flag);
       }
@@ -346,6 +356,8 @@ namespace eosio { namespace testing {
                vcfg.wasm_runtime = chain::wasm_interface::vm_type::wavm;
             else if(boost::unit_test::framework::master_test_suite().argv[i] == std::string("--wabt"))
                vcfg.wasm_runtime = chain::wasm_interface::vm_type::wabt;
+            else if(boost::unit_test::framework::master_test_suite().argv[i] == std::string("--tiered"))
+               vcfg.wasm_runtime = chain::wasm_interface::vm_type::tiered;
          }
          return vcfg;
       }
@@ -82,7 +82,8 @@ namespace eosio { namespace testing {
      return control->head_block_id() == other.control->head_block_id();
    }
 
-   void base_tester::init(bool push_genesis, db_read_mode read_mode) {
+   controller::config base_tester::default_config(const fc::temp_directory& tempdir) {
+      controller::config cfg;
       cfg.blocks_dir      = tempdir.path() / config::default_blocks_dir_name;
       cfg.state_dir  = tempdir.path() / config::default_state_dir_name;
       cfg.state_size = 1024*1024*8;
@@ -90,7 +91,6 @@ namespace eosio { namespace testing {
       cfg.reversible_cache_size = 1024*1024*8;
       cfg.reversible_guard_size = 0;
       cfg.contracts_console = true;
-      cfg.read_mode = read_mode;
 
       cfg.genesis.initial_timestamp = fc::time_point::from_iso_string("2020-01-01T00:00:00.000");
       cfg.genesis.initial_key = get_public_key( config::system_account_name, "active" );
@@ -100,12 +100,16 @@ namespace eosio { namespace testing {
             cfg.wasm_runtime = chain::wasm_interface::vm_type::wavm;
          else if(boost::unit_test::framework::master_test_suite().argv[i] == std::string("--wabt"))
             cfg.wasm_runtime = chain::wasm_interface::vm_type::wabt;
+         else if(boost::unit_test::framework::master_test_suite().argv[i] == std::string("--tiered"))
+            cfg.wasm_runtime = chain::wasm_interface::vm_type::tiered;
       }
+      return cfg;
+   }
 
-      open(nullptr);
-
-      if (push_genesis)
-         push_genesis_block();
+   void base_tester::init(bool push_genesis, db_read_mode read_mode) {
+      cfg = default_config( tempdir );
+      cfg.read_mode = read_mode;
+      init( cfg, push_genesis );
    }
 
 
@@ -114,6 +118,14 @@ namespace eosio { namespace testing {
       open(snapshot);
    }
 
+   void base_tester::init(controller::config config, bool push_genesis) {
+      cfg = config;
+      open(nullptr);
+
+      if (push_genesis)
+         push_genesis_block();
+   }
+
 
    void base_tester::close() {
       control.reset();
@@ -256,7 +268,7 @@ namespace eosio { namespace testing {
    void base_tester::produce_min_num_of_blocks_to_spend_time_wo_inactive_prod(const fc::microseconds target_elapsed_time) {
       fc::microseconds elapsed_time;
       while (elapsed_time < target_elapsed_time) {
-         for(uint32_t i = 0; i < control->head_block_state()->active_schedule.producers.size(); i++) {
+         for(uint32_t i = 0; i < control->head_block_state()->active_schedule->producers.size(); i++) {
             const auto time_to_skip = fc::milliseconds(config::producer_repetitions * config::block_interval_ms);
             produce_block(time_to_skip);
             elapsed_time += time_to_skip;
@@ -812,6 +824,12 @@ namespace eosio { namespace testing {
       sync_dbs(other, *this);
    }
 
+   void base_tester::activate_feature( account_name feature_name ) {
+      push_action( config::system_account_name, N(activate), config::system_account_name,
+                   fc::mutable_variant_object()("feature", feature_name) );
+      produce_block();
+   }
+
    void base_tester::push_genesis_block() {
       set_code(config::system_account_name, eosio_bios_wast);
 
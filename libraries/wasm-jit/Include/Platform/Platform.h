@@ -94,6 +94,26 @@ namespace Platform
 	// baseVirtualAddress must be a multiple of the preferred page size.
 	PLATFORM_API void freeVirtualPages(U8* baseVirtualAddress,Uptr numPages);
 
+	// An immutable image of memory contents that can be mapped copy-on-write over virtual pages.
+	struct PageImage;
+
+	// Creates an image holding a copy of numBytes of data, padded with zeroes to a whole number of pages.
+	// Returns nullptr if the platform doesn't support page images.
+	PLATFORM_API PageImage* createPageImage(const U8* data,Uptr numBytes);
+	PLATFORM_API void destroyPageImage(PageImage* image);
+
+	// Returns the number of virtual pages covered by the image.
+	PLATFORM_API Uptr getPageImageNumPages(PageImage* image);
+
+	// Maps a private copy-on-write view of the image over the virtual pages at baseVirtualAddress with read/write access.
+	// Pages are only copied when written; decommitting them discards the copies and reverts them to the image contents.
+	// baseVirtualAddress must be a multiple of the preferred page size.
+	PLATFORM_API bool mapPageImage(U8* baseVirtualAddress,PageImage* image);
+
+	// Replaces pages previously mapped with mapPageImage by inaccessible anonymous pages.
+	// baseVirtualAddress must be a multiple of the preferred page size.
+	PLATFORM_API void unmapPageImage(U8* baseVirtualAddress,Uptr numPages);
+
 	//
 	// Call stack and exceptions
 	//
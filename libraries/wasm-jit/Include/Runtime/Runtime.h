@@ -214,6 +214,19 @@ namespace Runtime
 	RUNTIME_API void resetGlobalInstances(ModuleInstance* moduleInstance);
 	RUNTIME_API void resetMemory(MemoryInstance* memory, IR::MemoryType& newMemoryType);
 
+	// An immutable image of a memory's initial contents.
+	struct MemoryImage;
+
+	// Creates an image from numBytes of data. Returns null if the platform can't map memory images.
+	RUNTIME_API MemoryImage* createMemoryImage(const U8* data,Uptr numBytes);
+	RUNTIME_API void destroyMemoryImage(MemoryImage* image);
+
+	// Resets the memory to newMemoryType's minimum size holding the image's contents followed by zeroes. The image is
+	// mapped copy-on-write and only the pages written since the previous reset are discarded, so the cost scales with the
+	// pages touched rather than with the size of the memory. Returns false if the image can't be used for newMemoryType
+	// or couldn't be mapped, in which case no image is left mapped and the caller should fall back to resetMemory.
+	RUNTIME_API bool resetMemoryFromImage(MemoryInstance* memory, IR::MemoryType& newMemoryType, MemoryImage* image);
+
 	// Gets an object exported by a ModuleInstance by name.
 	RUNTIME_API ObjectInstance* getInstanceExport(ModuleInstance* moduleInstance,const std::string& name);
 }
@@ -7,6 +7,8 @@
 #include <pthread.h>
 #include <unistd.h>
 #include <sys/mman.h>
+#include <sys/syscall.h>
+#include <stdio.h>
 
 #include <errno.h>
 #include <signal.h>
@@ -107,6 +109,65 @@ namespace Platform
 		if(munmap(baseVirtualAddress,numPages << getPageSizeLog2())) { Errors::fatal("munmap failed"); }
 	}
 
+	struct PageImage
+	{
+		int fd;
+		Uptr numPages;
+	};
+
+	static int createAnonymousFile()
+	{
+		#if defined(__linux__) && defined(SYS_memfd_create)
+			int fd = syscall(SYS_memfd_create,"wavm-page-image",0);
+			if(fd != -1) { return fd; }
+		#endif
+		FILE* file = tmpfile();
+		if(!file) { return -1; }
+		int fd = dup(fileno(file));
+		fclose(file);
+		return fd;
+	}
+
+	PageImage* createPageImage(const U8* data,Uptr numBytes)
+	{
+		const Uptr numPages = (numBytes + (Uptr(1) << getPageSizeLog2()) - 1) >> getPageSizeLog2();
+		int fd = createAnonymousFile();
+		if(fd == -1) { return nullptr; }
+		if(ftruncate(fd,numPages << getPageSizeLog2())) { close(fd); return nullptr; }
+		for(Uptr offset = 0;offset < numBytes;)
+		{
+			const ssize_t written = pwrite(fd,data + offset,numBytes - offset,offset);
+			if(written <= 0) { close(fd); return nullptr; }
+			offset += written;
+		}
+		return new PageImage {fd,numPages};
+	}
+
+	void destroyPageImage(PageImage* image)
+	{
+		if(!image) { return; }
+		close(image->fd);
+		delete image;
+	}
+
+	Uptr getPageImageNumPages(PageImage* image) { return image->numPages; }
+
+	bool mapPageImage(U8* baseVirtualAddress,PageImage* image)
+	{
+		errorUnless(isPageAligned(baseVirtualAddress));
+		if(!image->numPages) { return true; }
+		auto result = mmap(baseVirtualAddress,image->numPages << getPageSizeLog2(),PROT_READ | PROT_WRITE,MAP_PRIVATE | MAP_FIXED,image->fd,0);
+		return result != MAP_FAILED;
+	}
+
+	void unmapPageImage(U8* baseVirtualAddress,Uptr numPages)
+	{
+		errorUnless(isPageAligned(baseVirtualAddress));
+		if(!numPages) { return; }
+		auto result = mmap(baseVirtualAddress,numPages << getPageSizeLog2(),PROT_NONE,MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED,-1,0);
+		if(result == MAP_FAILED) { Errors::fatal("mmap failed"); }
+	}
+
 	bool describeInstructionPointer(Uptr ip,std::string& outDescription)
 	{
 		#if defined __linux__ || defined __FreeBSD__
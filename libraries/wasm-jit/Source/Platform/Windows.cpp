@@ -85,6 +85,13 @@ namespace Platform
 		if(baseVirtualAddress && !result) { Errors::fatal("VirtualFree(MEM_RELEASE) failed"); }
 	}
 
+	// Page images are not supported on Windows; callers fall back to copying memory contents.
+	PageImage* createPageImage(const U8* data,Uptr numBytes) { return nullptr; }
+	void destroyPageImage(PageImage* image) {}
+	Uptr getPageImageNumPages(PageImage* image) { return 0; }
+	bool mapPageImage(U8* baseVirtualAddress,PageImage* image) { return false; }
+	void unmapPageImage(U8* baseVirtualAddress,Uptr numPages) {}
+
 	// The interface to the DbgHelp DLL
 	struct DbgHelp
 	{
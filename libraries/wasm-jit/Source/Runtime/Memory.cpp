@@ -88,7 +88,23 @@ namespace Runtime
 		return Uptr(memory->type.size.max);
 	}
 
+	// Replaces a memory image mapped by resetMemoryFromImage with zeroed anonymous pages. Decommitting pages of a private
+	// image mapping reverts them to the image rather than to zero, so this must happen before any other kind of reset.
+	static void unmapMemoryImage(MemoryInstance* memory)
+	{
+		if(!memory->mappedImageId) { return; }
+		Platform::unmapPageImage(memory->baseAddress,memory->mappedImageNumPlatformPages);
+		memory->mappedImageId = 0;
+		memory->mappedImageNumPlatformPages = 0;
+
+		// unmapPageImage leaves the pages inaccessible, so recommit the pages the memory currently holds.
+		if(memory->numPages > 0
+		&& !Platform::commitVirtualPages(memory->baseAddress,memory->numPages << getPlatformPagesPerWebAssemblyPageLog2()))
+		{ causeException(Exception::Cause::outOfMemory); }
+	}
+
 	void resetMemory(MemoryInstance* memory, MemoryType& newMemoryType) {
+		unmapMemoryImage(memory);
 		memory->type.size.min = 1;
 		if(shrinkMemory(memory, memory->numPages - 1) == -1)
 			causeException(Exception::Cause::outOfMemory);
@@ -98,6 +114,62 @@ namespace Runtime
 			causeException(Exception::Cause::outOfMemory);
    }
 
+	MemoryImage* createMemoryImage(const U8* data,Uptr numBytes)
+	{
+		static std::atomic<U64> nextImageId(1);
+		Platform::PageImage* pages = Platform::createPageImage(data,numBytes);
+		if(!pages) { return nullptr; }
+		return new MemoryImage {pages,nextImageId++};
+	}
+
+	void destroyMemoryImage(MemoryImage* image)
+	{
+		if(!image) { return; }
+		Platform::destroyPageImage(image->pages);
+		delete image;
+	}
+
+	bool resetMemoryFromImage(MemoryInstance* memory, MemoryType& newMemoryType, MemoryImage* image)
+	{
+		// Leave memories resetMemory can't produce, and images larger than the memory, to resetMemory. Any image mapped by an
+		// earlier reset is unmapped first so the fallback starts from zeroed pages.
+		const Uptr newNumPages = newMemoryType.size.min;
+		if(newNumPages == 0 || Platform::getPageImageNumPages(image->pages) > (newNumPages << getPlatformPagesPerWebAssemblyPageLog2()))
+		{
+			unmapMemoryImage(memory);
+			return false;
+		}
+
+		// Discard every page written since the previous reset. Anonymous pages read back as zero and pages of a mapped
+		// image revert to the image's contents, so untouched pages cost nothing.
+		if(memory->numPages > 0) { Platform::decommitVirtualPages(memory->baseAddress,memory->numPages << getPlatformPagesPerWebAssemblyPageLog2()); }
+		memory->numPages = 0;
+
+		// The memory is shared by all module instances, so switch the mapping when a different image was used last.
+		if(memory->mappedImageId != image->id)
+		{
+			Platform::unmapPageImage(memory->baseAddress,memory->mappedImageNumPlatformPages);
+			memory->mappedImageId = 0;
+			memory->mappedImageNumPlatformPages = 0;
+			if(!Platform::mapPageImage(memory->baseAddress,image->pages))
+			{
+				memory->type.size.min = 1;
+				if(!Platform::commitVirtualPages(memory->baseAddress,Uptr(1) << getPlatformPagesPerWebAssemblyPageLog2()))
+				{ causeException(Exception::Cause::outOfMemory); }
+				memory->numPages = 1;
+				return false;
+			}
+			memory->mappedImageId = image->id;
+			memory->mappedImageNumPlatformPages = Platform::getPageImageNumPages(image->pages);
+		}
+
+		memory->type = newMemoryType;
+		if(newNumPages > 0 && !Platform::commitVirtualPages(memory->baseAddress,newNumPages << getPlatformPagesPerWebAssemblyPageLog2()))
+		{ causeException(Exception::Cause::outOfMemory); }
+		memory->numPages = newNumPages;
+		return true;
+	}
+
 	Iptr growMemory(MemoryInstance* memory,Uptr numNewPages)
 	{
 		const Uptr previousNumPages = memory->numPages;
@@ -76,6 +76,13 @@ namespace Runtime
 		~TableInstance() override;
 	};
 
+	// An image of a memory's initial contents; ids are unique for the life of the process.
+	struct MemoryImage
+	{
+		Platform::PageImage* pages;
+		U64 id;
+	};
+
 	// An instance of a WebAssembly Memory.
 	struct MemoryInstance : GCObject
 	{
@@ -88,7 +95,11 @@ namespace Runtime
 		U8* reservedBaseAddress;
 		Uptr reservedNumPlatformPages;
 
-		MemoryInstance(const MemoryType& inType): GCObject(ObjectKind::memory), type(inType), baseAddress(nullptr), numPages(0), endOffset(0), reservedBaseAddress(nullptr), reservedNumPlatformPages(0) {}
+		// The MemoryImage currently mapped at baseAddress by resetMemoryFromImage, if any.
+		U64 mappedImageId;
+		Uptr mappedImageNumPlatformPages;
+
+		MemoryInstance(const MemoryType& inType): GCObject(ObjectKind::memory), type(inType), baseAddress(nullptr), numPages(0), endOffset(0), reservedBaseAddress(nullptr), reservedNumPlatformPages(0), mappedImageId(0), mappedImageNumPlatformPages(0) {}
 		~MemoryInstance() override;
 
       static MemoryInstance* theMemoryInstance;
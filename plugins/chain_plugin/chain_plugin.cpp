@@ -10,6 +10,7 @@
 #include <eosio/chain/producer_object.hpp>
 #include <eosio/chain/config.hpp>
 #include <eosio/chain/wasm_interface.hpp>
+#include <eosio/chain/wasm_hard_float.hpp>
 #include <eosio/chain/resource_limits.hpp>
 #include <eosio/chain/reversible_block_object.hpp>
 #include <eosio/chain/controller.hpp>
@@ -210,8 +211,36 @@ void chain_plugin::set_program_options(options_description& cli, options_descrip
    cfg.add_options()
          ("blocks-dir", bpo::value<bfs::path>()->default_value("blocks"),
           "the location of the blocks directory (absolute path or relative to application data dir)")
+         ("block-log-write-queue", bpo::value<uint32_t>()->default_value(config::default_block_log_write_queue_size),
+          "Number of irreversible blocks queued for the block log writer thread before block processing waits for it (0 writes blocks on the main thread)")
+         ("block-log-fsync-interval", bpo::value<uint32_t>()->default_value(0),
+          "Number of blocks written to the block log between fsyncs of the block log files (0 leaves syncing to the operating system)")
+         ("block-log-cache-size", bpo::value<uint32_t>()->default_value(config::default_block_log_cache_size),
+          "Number of most recently read blocks kept decoded in memory for requests served from the block log (0 to disable)")
+         ("blocks-log-stride", bpo::value<uint32_t>()->default_value(0),
+          "Split the block log file after every block number divisible by this value, moving it to the retained blocks directory (0 never splits)")
+         ("max-retained-block-files", bpo::value<uint32_t>()->default_value(0),
+          "Number of split block log files kept in the retained blocks directory before the oldest is archived or deleted (0 keeps all)")
+         ("blocks-retained-dir", bpo::value<bfs::path>()->default_value("retained"),
+          "the location of the split block log files (absolute path or relative to blocks dir)")
+         ("blocks-archive-dir", bpo::value<string>()->default_value("archive"),
+          "the location the oldest split block log files are moved to beyond max-retained-block-files (absolute path or relative to blocks dir). Set it to an empty value to delete them instead.")
+         ("block-log-compression", bpo::bool_switch()->default_value(false),
+          "Compress every block of block log files started by this node with zlib. An existing block log file keeps its format until it is split or replaced.")
          ("checkpoint", bpo::value<vector<string>>()->composing(), "Pairs of [BLOCK_NUM,BLOCK_ID] that should be enforced as checkpoints.")
-         ("wasm-runtime", bpo::value<eosio::chain::wasm_interface::vm_type>()->value_name("wavm/wabt"), "Override default WASM runtime")
+         ("checkpoint-light-validation", bpo::bool_switch()->default_value(false),
+          "Light validate blocks proven to be ancestors of a checkpoint by the header chain down from it, skipping their authorization checks and signature recovery")
+         ("wasm-runtime", bpo::value<eosio::chain::wasm_interface::vm_type>()->value_name("wavm/wabt/tiered"), "Override default WASM runtime")
+         ("wasm-cache-size-mb", bpo::value<uint64_t>()->default_value(config::default_wasm_cache_size / (1024  * 1024)),
+          "Maximum size (in MiB) of instantiated contracts kept in the WASM cache, measured in contract code and initial memory bytes (0 for unbounded)")
+         ("wasm-cache-max-entries", bpo::value<uint32_t>()->default_value(config::default_wasm_cache_max_entries),
+          "Maximum number of instantiated contracts kept in the WASM cache (0 for unbounded)")
+         ("wasm-tier-up-threshold", bpo::value<uint32_t>()->default_value(config::default_wasm_tier_up_threshold),
+          "Number of invocations after which the tiered WASM runtime recompiles a contract with wavm in the background")
+         ("wasm-code-cache-dir", bpo::value<bfs::path>(),
+          "Directory of the persistent cache of injected contract code reused across restarts (absolute path or relative to application data dir). Disabled when not set.")
+         ("wasm-hard-float", bpo::bool_switch()->default_value(false),
+          "Run WASM floating point add, sub, mul, div and sqrt as native instructions instead of softfloat intrinsic calls, falling back to softfloat for NaN results so results stay bit-exact (x86-64 only)")
          ("abi-serializer-max-time-ms", bpo::value<uint32_t>()->default_value(config::default_abi_serializer_max_time_ms),
           "Override default maximum ABI serialization time allowed in ms")
          ("chain-state-db-size-mb", bpo::value<uint64_t>()->default_value(config::default_state_size / (1024  * 1024)), "Maximum size (in MiB) of the chain state database")
@@ -222,8 +251,18 @@ void chain_plugin::set_program_options(options_description& cli, options_descrip
           "Percentage of actual signature recovery cpu to bill. Whole number percentages, e.g. 50 for 50%")
          ("chain-threads", bpo::value<uint16_t>()->default_value(config::default_controller_thread_pool_size),
           "Number of worker threads in controller thread pool")
+         ("block-prepare-window", bpo::value<uint32_t>()->default_value(config::default_block_prepare_window),
+          "Number of upcoming blocks whose headers and signatures are validated on the controller thread pool while earlier blocks are applied")
+         ("replay-read-ahead-blocks", bpo::value<uint32_t>()->default_value(config::default_replay_read_ahead_blocks),
+          "Number of blocks read, unpacked and validated from the block log ahead of their application during replay, 0 replays on a single thread")
          ("contracts-console", bpo::bool_switch()->default_value(false),
           "print contract's output to console")
+         ("native-token-code-hash", boost::program_options::value<vector<string>>()->composing()->multitoken(),
+          "Code hash of a verified build of the standard eosio.token contract whose transfers are applied natively instead of in WASM (may specify multiple times)")
+         ("profile-actions", bpo::bool_switch()->default_value(false),
+          "aggregate wall time, billed CPU, compile time, database calls and RAM usage per contract and action")
+         ("track-access-sets", bpo::bool_switch()->default_value(false),
+          "record the contract table keys read and written by each transaction and log the conflicts between the transactions of each block")
          ("actor-whitelist", boost::program_options::value<vector<string>>()->composing()->multitoken(),
           "Account added to actor whitelist (may specify multiple times)")
          ("actor-blacklist", boost::program_options::value<vector<string>>()->composing()->multitoken(),
@@ -399,6 +438,11 @@ void chain_plugin::plugin_initialize(const variables_map& options) {
          }
       }
 
+      if( options.at( "checkpoint-light-validation" ).as<bool>() ) {
+         for( const auto& cp : my->loaded_checkpoints )
+            my->chain_config->light_validation_checkpoints.insert( cp.second );
+      }
+
       if( options.count( "wasm-runtime" ))
          my->wasm_runtime = options.at( "wasm-runtime" ).as<vm_type>();
 
@@ -406,6 +450,14 @@ void chain_plugin::plugin_initialize(const variables_map& options) {
          my->abi_serializer_max_time_ms = fc::microseconds(options.at("abi-serializer-max-time-ms").as<uint32_t>() * 1000);
 
       my->chain_config->blocks_dir = my->blocks_dir;
+      my->chain_config->block_log_write_queue_size = options.at( "block-log-write-queue" ).as<uint32_t>();
+      my->chain_config->block_log_fsync_interval = options.at( "block-log-fsync-interval" ).as<uint32_t>();
+      my->chain_config->block_log_cache_size = options.at( "block-log-cache-size" ).as<uint32_t>();
+      my->chain_config->block_log_stride = options.at( "blocks-log-stride" ).as<uint32_t>();
+      my->chain_config->max_retained_block_files = options.at( "max-retained-block-files" ).as<uint32_t>();
+      my->chain_config->blocks_retained_dir = options.at( "blocks-retained-dir" ).as<bfs::path>();
+      my->chain_config->blocks_archive_dir = options.at( "blocks-archive-dir" ).as<string>();
+      my->chain_config->compress_block_log = options.at( "block-log-compression" ).as<bool>();
       my->chain_config->state_dir = app().data_dir() / config::default_state_dir_name;
       my->chain_config->read_only = my->readonly;
 
@@ -428,6 +480,12 @@ void chain_plugin::plugin_initialize(const variables_map& options) {
                      "chain-threads ${num} must be greater than 0", ("num", my->chain_config->thread_pool_size) );
       }
 
+      if( options.count( "block-prepare-window" ))
+         my->chain_config->block_prepare_window = options.at( "block-prepare-window" ).as<uint32_t>();
+
+      if( options.count( "replay-read-ahead-blocks" ))
+         my->chain_config->replay_read_ahead_blocks = options.at( "replay-read-ahead-blocks" ).as<uint32_t>();
+
       my->chain_config->sig_cpu_bill_pct = options.at("signature-cpu-billable-pct").as<uint32_t>();
       EOS_ASSERT( my->chain_config->sig_cpu_bill_pct >= 0 && my->chain_config->sig_cpu_bill_pct <= 100, plugin_config_exception,
                   "signature-cpu-billable-pct must be 0 - 100, ${pct}", ("pct", my->chain_config->sig_cpu_bill_pct) );
@@ -436,9 +494,32 @@ void chain_plugin::plugin_initialize(const variables_map& options) {
       if( my->wasm_runtime )
          my->chain_config->wasm_runtime = *my->wasm_runtime;
 
+      my->chain_config->wasm_cache_size = options.at( "wasm-cache-size-mb" ).as<uint64_t>() * 1024 * 1024;
+      my->chain_config->wasm_cache_max_entries = options.at( "wasm-cache-max-entries" ).as<uint32_t>();
+      my->chain_config->wasm_tier_up_threshold = options.at( "wasm-tier-up-threshold" ).as<uint32_t>();
+      if( options.count( "wasm-code-cache-dir" )) {
+         auto ccd = options.at( "wasm-code-cache-dir" ).as<bfs::path>();
+         if( ccd.is_relative())
+            my->chain_config->wasm_code_cache_dir = app().data_dir() / ccd;
+         else
+            my->chain_config->wasm_code_cache_dir = ccd;
+      }
+
+      my->chain_config->wasm_hard_float = options.at( "wasm-hard-float" ).as<bool>();
+      if( my->chain_config->wasm_hard_float && !hard_float::supported() ) {
+         wlog( "wasm-hard-float is not supported on this platform, falling back to softfloat" );
+         my->chain_config->wasm_hard_float = false;
+      }
+
       my->chain_config->force_all_checks = options.at( "force-all-checks" ).as<bool>();
       my->chain_config->disable_replay_opts = options.at( "disable-replay-opts" ).as<bool>();
       my->chain_config->contracts_console = options.at( "contracts-console" ).as<bool>();
+      my->chain_config->profile_actions = options.at( "profile-actions" ).as<bool>();
+      my->chain_config->track_access_sets = options.at( "track-access-sets" ).as<bool>();
+      if( options.count( "native-token-code-hash" )) {
+         for( const auto& h : options.at( "native-token-code-hash" ).as<vector<string>>() )
+            my->chain_config->native_token_code_hashes.insert( digest_type( h ));
+      }
       my->chain_config->allow_ram_billing_in_notify = options.at( "disable-ram-billing-notify-checks" ).as<bool>();
 
       if( options.count( "extract-genesis-json" ) || options.at( "print-genesis-json" ).as<bool>()) {
@@ -493,7 +574,8 @@ void chain_plugin::plugin_initialize(const variables_map& options) {
       } else if( options.at( "hard-replay-blockchain" ).as<bool>()) {
          ilog( "Hard replay requested: deleting state database" );
          clear_directory_contents( my->chain_config->state_dir );
-         auto backup_dir = block_log::repair_log( my->blocks_dir, options.at( "truncate-at-block" ).as<uint32_t>());
+         auto backup_dir = block_log::repair_log( my->blocks_dir, options.at( "truncate-at-block" ).as<uint32_t>(),
+                                                  my->chain_config->blocks_retained_dir, my->chain_config->blocks_archive_dir );
          if( fc::exists( backup_dir / config::reversible_blocks_dir_name ) ||
              options.at( "fix-reversible-blocks" ).as<bool>()) {
             // Do not try to recover reversible blocks if the directory does not exist, unless the option was explicitly provided.
@@ -132,6 +132,20 @@ namespace eosio {
       uint32_t end_block;
    };
 
+   /**
+    * asks for the header of a block and the headers of its ancestors, only sent to peers of proto_block_headers;
+    * a peer answers one request at a time and a request sent before its previous reply was written, or within
+    * 100 ms of the previous request, is answered without headers
+    */
+   struct block_headers_request_message {
+      block_id_type id;
+      uint32_t      count = 0;
+   };
+
+   struct block_headers_message {
+      vector<signed_block_header> headers; ///< descending from the requested block, fewer when the peer lacks blocks
+   };
+
    using net_message = static_variant<handshake_message,
                                       chain_size_message,
                                       go_away_message,
@@ -140,7 +154,9 @@ namespace eosio {
                                       request_message,
                                       sync_request_message,
                                       signed_block,         // which = 7
-                                      packed_transaction>;  // which = 8
+                                      packed_transaction,   // which = 8
+                                      block_headers_request_message,
+                                      block_headers_message>;
 
 } // namespace eosio
 
@@ -159,6 +175,8 @@ FC_REFLECT( eosio::time_message, (org)(rec)(xmt)(dst) )
 FC_REFLECT( eosio::notice_message, (known_trx)(known_blocks) )
 FC_REFLECT( eosio::request_message, (req_trx)(req_blocks) )
 FC_REFLECT( eosio::sync_request_message, (start_block)(end_block) )
+FC_REFLECT( eosio::block_headers_request_message, (id)(count) )
+FC_REFLECT( eosio::block_headers_message, (headers) )
 
 /**
  *
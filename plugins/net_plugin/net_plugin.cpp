@@ -153,6 +153,10 @@ namespace eosio {
 
       bool                          use_socket_read_watermark = false;
 
+      /// the peer asked for headers proving the next blocks to be ancestors of a checkpoint, one request at a time
+      connection_wptr               checkpoint_headers_peer;
+      std::chrono::steady_clock::time_point checkpoint_headers_requested;
+
       channels::transaction_ack::channel_type::handle  incoming_transaction_ack_subscription;
 
       void connect(const connection_ptr& c);
@@ -195,8 +199,14 @@ namespace eosio {
       void handle_message(const connection_ptr& c, const sync_request_message& msg);
       void handle_message(const connection_ptr& c, const signed_block& msg) = delete; // signed_block_ptr overload used instead
       void handle_message(const connection_ptr& c, const signed_block_ptr& msg);
+      /// starts validating the header of a block received ahead of the blocks before it being applied
+      void prepare_block(const signed_block_ptr& msg);
       void handle_message(const connection_ptr& c, const packed_transaction& msg) = delete; // packed_transaction_ptr overload used instead
       void handle_message(const connection_ptr& c, const packed_transaction_ptr& msg);
+      void handle_message(const connection_ptr& c, const block_headers_request_message& msg);
+      void handle_message(const connection_ptr& c, const block_headers_message& msg);
+      /// asks the peer for the headers proving the next blocks to be ancestors of a checkpoint, if any are needed
+      void request_checkpoint_headers(const connection_ptr& c);
 
       void start_conn_timer(boost::asio::steady_timer::duration du, std::weak_ptr<connection> from_connection);
       void start_txn_timer();
@@ -289,6 +299,8 @@ namespace eosio {
    constexpr auto     def_txn_expire_wait = std::chrono::seconds(3);
    constexpr auto     def_resp_expected_wait = std::chrono::seconds(5);
    constexpr auto     def_sync_fetch_span = 100;
+   constexpr uint32_t def_checkpoint_headers_span = 1000; ///< most headers sent in one block_headers_message
+   constexpr auto     def_headers_request_interval = std::chrono::milliseconds(100); ///< least time between block_headers_request_messages of a peer
 
    constexpr auto     message_header_size = 4;
 
@@ -312,8 +324,9 @@ namespace eosio {
     */
    constexpr uint16_t proto_base = 0;
    constexpr uint16_t proto_explicit_sync = 1;
+   constexpr uint16_t proto_block_headers = 2;  // block_headers_request_message and block_headers_message
 
-   constexpr uint16_t net_version = proto_explicit_sync;
+   constexpr uint16_t net_version = proto_block_headers;
 
    struct transaction_state {
       transaction_id_type id;
@@ -436,6 +449,10 @@ namespace eosio {
       block_id_type          fork_head;
       uint32_t               fork_head_num = 0;
       optional<request_message> last_req;
+      /// when the last block_headers_request_message of the peer was served
+      std::chrono::steady_clock::time_point last_headers_request;
+      /// the reply to it is queued and not yet written, the peer gets one reply at a time
+      bool                   headers_reply_pending = false;
 
       connection_status get_status()const {
          connection_status stat;
@@ -500,9 +517,11 @@ namespace eosio {
       void blk_send(const vector<block_id_type> &txn_lis);
       void stop_send();
 
-      void enqueue( const net_message &msg, bool trigger_send = true );
+      /// `sent` is called once the message is written
+      void enqueue( const net_message &msg, bool trigger_send = true, std::function<void()> sent = nullptr );
       void enqueue_block( const signed_block_ptr& sb, bool trigger_send = true );
-      void enqueue_buffer( const std::shared_ptr<std::vector<char>>& send_buffer, bool trigger_send, go_away_reason close_after_send );
+      void enqueue_buffer( const std::shared_ptr<std::vector<char>>& send_buffer, bool trigger_send, go_away_reason close_after_send,
+                           std::function<void()> sent = nullptr );
       void cancel_sync(go_away_reason);
       void flush_queues();
       bool enqueue_sync_block();
@@ -530,6 +549,23 @@ namespace eosio {
        */
       bool process_next_message(net_plugin_impl& impl, uint32_t message_length);
 
+      /** \brief Dispatch the messages read ahead, in the order they were received
+       *
+       * Returns false if the connection was closed while handling them, either by an
+       * exception or by a handler closing it, so the caller must not read from it again.
+       */
+      bool dispatch_read_ahead(net_plugin_impl& impl);
+
+      /// a message unpacked ahead of its dispatch, a block is moved out of the message so it can be prepared early
+      struct read_ahead_message {
+         net_message        msg;
+         signed_block_ptr   block;
+      };
+
+      /// messages of the current read, blocks among them are prepared by the controller before earlier blocks are applied
+      std::deque<read_ahead_message> read_ahead;
+      uint32_t                       read_ahead_blocks = 0;
+
       bool add_peer_block(const peer_block_state &pbs);
 
       fc::optional<fc::variant_object> _logger_variant;
@@ -615,6 +651,7 @@ namespace eosio {
       bool sync_required();
       void send_handshakes();
       bool is_active(const connection_ptr& conn);
+      bool is_sync_source(const connection_ptr& conn)const { return source && source == conn; }
       void reset_lib_num(const connection_ptr& conn);
       void request_next_chunk(const connection_ptr& conn = connection_ptr());
       void start_sync(const connection_ptr& c, uint32_t target);
@@ -713,10 +750,12 @@ namespace eosio {
       peer_requested.reset();
       blk_state.clear();
       trx_state.clear();
+      headers_reply_pending = false;
    }
 
    void connection::flush_queues() {
       write_queue.clear();
+      headers_reply_pending = false;
    }
 
    void connection::close() {
@@ -740,6 +779,8 @@ namespace eosio {
       fc_dlog(logger, "canceling wait on ${p}", ("p",peer_name()));
       cancel_wait();
       pending_message_buffer.reset();
+      read_ahead.clear();
+      read_ahead_blocks = 0;
    }
 
    void connection::txn_send_pending(const vector<transaction_id_type>& ids) {
@@ -1011,7 +1052,7 @@ namespace eosio {
       return false;
    }
 
-   void connection::enqueue( const net_message& m, bool trigger_send ) {
+   void connection::enqueue( const net_message& m, bool trigger_send, std::function<void()> sent ) {
       go_away_reason close_after_send = no_reason;
       if (m.contains<go_away_message>()) {
          close_after_send = m.get<go_away_message>().reason;
@@ -1028,7 +1069,7 @@ namespace eosio {
       ds.write( header, header_size );
       fc::raw::pack( ds, m );
 
-      enqueue_buffer( send_buffer, trigger_send, close_after_send );
+      enqueue_buffer( send_buffer, trigger_send, close_after_send, std::move( sent ) );
    }
 
    void connection::enqueue_block( const signed_block_ptr& sb, bool trigger_send ) {
@@ -1051,12 +1092,15 @@ namespace eosio {
       enqueue_buffer( send_buffer, trigger_send, no_reason );
    }
 
-   void connection::enqueue_buffer( const std::shared_ptr<std::vector<char>>& send_buffer, bool trigger_send, go_away_reason close_after_send ) {
+   void connection::enqueue_buffer( const std::shared_ptr<std::vector<char>>& send_buffer, bool trigger_send, go_away_reason close_after_send,
+                                    std::function<void()> sent ) {
       connection_wptr weak_this = shared_from_this();
       queue_write(send_buffer,trigger_send,
-                  [weak_this, close_after_send](boost::system::error_code ec, std::size_t ) {
+                  [weak_this, close_after_send, sent](boost::system::error_code ec, std::size_t ) {
                      connection_ptr conn = weak_this.lock();
                      if (conn) {
+                        if (sent)
+                           sent();
                         if (close_after_send != no_reason) {
                            elog ("sent a go away message: ${r}, closing connection to ${p}",("r", reason_str(close_after_send))("p", conn->peer_name()));
                            my_impl->close(conn);
@@ -1147,15 +1191,41 @@ namespace eosio {
    bool connection::process_next_message(net_plugin_impl& impl, uint32_t message_length) {
       try {
          auto ds = pending_message_buffer.create_datastream();
-         net_message msg;
-         fc::raw::unpack(ds, msg);
+         read_ahead.emplace_back();
+         auto& next = read_ahead.back();
+         fc::raw::unpack(ds, next.msg);
+         if( next.msg.contains<signed_block>() ) {
+            next.block = std::make_shared<signed_block>( std::move( next.msg.get<signed_block>() ) );
+            impl.prepare_block( next.block );
+            if( ++read_ahead_blocks >= impl.chain_plug->chain().get_block_prepare_window() ) {
+               return dispatch_read_ahead( impl );
+            }
+         }
+      } catch(  const fc::exception& e ) {
+         edump((e.to_detail_string() ));
+         impl.close( shared_from_this() );
+         return false;
+      }
+      return true;
+   }
+
+   bool connection::dispatch_read_ahead(net_plugin_impl& impl) {
+      try {
          msg_handler m(impl, shared_from_this() );
-         if( msg.contains<signed_block>() ) {
-            m( std::move( msg.get<signed_block>() ) );
-         } else if( msg.contains<packed_transaction>() ) {
-            m( std::move( msg.get<packed_transaction>() ) );
-         } else {
-            msg.visit( m );
+         while( !read_ahead.empty() ) {
+            // a handler closing the connection clears the remaining messages
+            auto next = std::move( read_ahead.front() );
+            read_ahead.pop_front();
+            if( next.block ) {
+               --read_ahead_blocks;
+               impl.handle_message( shared_from_this(), next.block );
+            } else if( next.msg.contains<packed_transaction>() ) {
+               m( std::move( next.msg.get<packed_transaction>() ) );
+            } else {
+               next.msg.visit( m );
+            }
+            if( !socket || !socket->is_open() )
+               return false;
          }
       } catch(  const fc::exception& e ) {
          edump((e.to_detail_string() ));
@@ -2007,6 +2077,9 @@ namespace eosio {
                            }
                         }
                      }
+                     if (!conn->dispatch_read_ahead(*this)) {
+                        return;
+                     }
                      start_read_message(conn);
                   } else {
                      auto pname = conn->peer_name();
@@ -2195,6 +2268,8 @@ namespace eosio {
       c->last_handshake_recv = msg;
       c->_logger_variant.reset();
       sync_master->recv_handshake(c,msg);
+      if( sync_master->is_sync_source(c) )
+         request_checkpoint_headers(c);
    }
 
    void net_plugin_impl::handle_message(const connection_ptr& c, const go_away_message& msg) {
@@ -2347,6 +2422,84 @@ namespace eosio {
       }
    }
 
+   void net_plugin_impl::handle_message(const connection_ptr& c, const block_headers_request_message& msg) {
+      peer_ilog(c, "received block_headers_request_message");
+      block_headers_message reply;
+      // a peer gets one reply at a time and not more often than the interval, a request beyond that gets no headers
+      auto now = std::chrono::steady_clock::now();
+      if( c->headers_reply_pending || now - c->last_headers_request < def_headers_request_interval ) {
+         peer_wlog(c, "block_headers_request_message sent too soon, replying without headers");
+         c->enqueue( reply );
+         return;
+      }
+      c->last_headers_request = now;
+
+      controller& cc = chain_plug->chain();
+      auto count = std::min( msg.count, def_checkpoint_headers_span );
+      reply.headers.reserve( count );
+      block_id_type id = msg.id;
+      try {
+         while( reply.headers.size() < count ) {
+            auto h = cc.fetch_block_header_by_id( id );
+            if( !h )
+               break;
+            id = h->previous;
+            reply.headers.emplace_back( std::move( *h ) );
+         }
+      } catch( const fc::exception& ex ) {
+         elog( "unable to read block headers requested by ${p}: ${m}", ("p", c->peer_name())("m", ex.to_string()) );
+      }
+      c->headers_reply_pending = true;
+      connection_wptr weak_c = c;
+      c->enqueue( reply, true, [weak_c]() {
+         if( auto conn = weak_c.lock() )
+            conn->headers_reply_pending = false;
+      } );
+   }
+
+   void net_plugin_impl::handle_message(const connection_ptr& c, const block_headers_message& msg) {
+      peer_ilog(c, "received block_headers_message");
+      if( checkpoint_headers_peer.lock() != c )
+         return;
+      checkpoint_headers_peer.reset();
+
+      try {
+         auto proven = chain_plug->chain().add_checkpoint_headers( msg.headers );
+         fc_dlog( logger, "${n} blocks proven to be ancestors of a checkpoint by ${p}", ("n", proven)("p", c->peer_name()) );
+         if( proven == 0 )
+            return;
+      } catch( const checkpoint_exception& ex ) {
+         peer_elog(c, "bad block headers : ${m}", ("m", ex.what()));
+         c->enqueue( go_away_message( validation ) );
+         return;
+      }
+      request_checkpoint_headers( c );
+   }
+
+   void net_plugin_impl::request_checkpoint_headers(const connection_ptr& c) {
+      if( c->protocol_version < proto_block_headers || checkpoint_headers_peer.lock() )
+         return;
+      // peers reply without headers to requests sent more often than the interval
+      if( std::chrono::steady_clock::now() - checkpoint_headers_requested < def_headers_request_interval )
+         return;
+
+      controller& cc = chain_plug->chain();
+      auto id = cc.checkpoint_headers_needed();
+      if( id == block_id_type() )
+         return;
+      auto num = block_header::num_from_id( id );
+      // the peer can only send the headers of blocks it has
+      if( c->last_handshake_recv.head_num < num )
+         return;
+
+      block_headers_request_message req;
+      req.id = id;
+      req.count = std::min( num - cc.head_block_num(), def_checkpoint_headers_span );
+      checkpoint_headers_peer = c;
+      checkpoint_headers_requested = std::chrono::steady_clock::now();
+      c->enqueue( req );
+   }
+
    void net_plugin_impl::handle_message(const connection_ptr& c, const packed_transaction_ptr& trx) {
       fc_dlog(logger, "got a packed transaction, cancel wait");
       peer_ilog(c, "received packed_transaction");
@@ -2446,12 +2599,22 @@ namespace eosio {
             }
          }
          sync_master->recv_block(c, blk_id, blk_num);
+         if( blk_num % def_sync_fetch_span == 0 && sync_master->is_sync_source(c) )
+            request_checkpoint_headers(c);
       }
       else {
          sync_master->rejected_block(c, blk_num);
       }
    }
 
+   void net_plugin_impl::prepare_block(const signed_block_ptr& msg) {
+      try {
+         chain_plug->chain().create_block_state_future( msg );
+      } catch( const fc::exception& ) {
+         // known, unlinkable and invalid blocks are reported when the block is handled
+      }
+   }
+
    void net_plugin_impl::start_conn_timer(boost::asio::steady_timer::duration du, std::weak_ptr<connection> from_connection) {
       connector_check->expires_from_now( du);
       connector_check->async_wait( [this, from_connection](boost::system::error_code ec) {
@@ -2568,6 +2731,8 @@ namespace eosio {
             --num_clients;
          }
       }
+      if( checkpoint_headers_peer.lock() == c )
+         checkpoint_headers_peer.reset();
       c->close();
    }
 
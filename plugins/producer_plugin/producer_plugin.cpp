@@ -186,11 +186,11 @@ class producer_plugin_impl : public std::enable_shared_from_this<producer_plugin
          if( bsp->header.timestamp <= _start_time ) return;
          if( bsp->block_num <= _last_signed_block_num ) return;
 
-         const auto& active_producer_to_signing_key = bsp->active_schedule.producers;
+         const auto& active_producer_to_signing_key = bsp->active_schedule->producers;
 
          flat_set<account_name> active_producers;
-         active_producers.reserve(bsp->active_schedule.producers.size());
-         for (const auto& p: bsp->active_schedule.producers) {
+         active_producers.reserve(bsp->active_schedule->producers.size());
+         for (const auto& p: bsp->active_schedule->producers) {
             active_producers.insert(p.producer_name);
          }
 
@@ -226,15 +226,15 @@ class producer_plugin_impl : public std::enable_shared_from_this<producer_plugin
          auto new_bs = bsp->generate_next(new_block_header.timestamp);
 
          // for newly installed producers we can set their watermarks to the block they became active
-         if (new_bs.maybe_promote_pending() && bsp->active_schedule.version != new_bs.active_schedule.version) {
+         if (new_bs.maybe_promote_pending() && bsp->active_schedule->version != new_bs.active_schedule->version) {
             flat_set<account_name> new_producers;
-            new_producers.reserve(new_bs.active_schedule.producers.size());
-            for( const auto& p: new_bs.active_schedule.producers) {
+            new_producers.reserve(new_bs.active_schedule->producers.size());
+            for( const auto& p: new_bs.active_schedule->producers) {
                if (_producers.count(p.producer_name) > 0)
                   new_producers.insert(p.producer_name);
             }
 
-            for( const auto& p: bsp->active_schedule.producers) {
+            for( const auto& p: bsp->active_schedule->producers) {
                new_producers.erase(p.producer_name);
             }
 
@@ -966,7 +966,7 @@ producer_plugin::snapshot_information producer_plugin::create_snapshot() const {
 optional<fc::time_point> producer_plugin_impl::calculate_next_block_time(const account_name& producer_name, const block_timestamp_type& current_block_time) const {
    chain::controller& chain = chain_plug->chain();
    const auto& hbs = chain.head_block_state();
-   const auto& active_schedule = hbs->active_schedule.producers;
+   const auto& active_schedule = hbs->active_schedule->producers;
 
    // determine if this producer is in the active schedule and if so, where
    auto itr = std::find_if(active_schedule.begin(), active_schedule.end(), [&](const auto& asp){ return asp.producer_name == producer_name; });
@@ -0,0 +1,69 @@
+/**
+ *  @file
+ *  @copyright defined in eos/LICENSE
+ */
+#pragma once
+
+#include <eosio/http_plugin/http_plugin.hpp>
+#include <eosio/chain_plugin/chain_plugin.hpp>
+#include <eosio/chain/execution_profiler.hpp>
+
+#include <appbase/application.hpp>
+
+namespace eosio {
+
+using namespace appbase;
+
+struct profiler_get_profile_params {
+   uint32_t limit = 100;
+};
+
+struct profiler_get_profile_results {
+   vector<chain::action_profile_entry> actions;
+   bool                                more = false;
+};
+
+struct profiler_get_conflict_graph_params {
+   uint32_t limit = 1000; ///< edges returned
+};
+
+struct profiler_get_conflict_graph_results {
+   chain::conflict_graph graph;
+   bool                  more = false;
+};
+
+/**
+ *  Exposes the per contract and action execution profile gathered when nodeos runs with --profile-actions,
+ *  and optionally logs the most expensive actions periodically. Also exposes the conflicts between the transactions
+ *  of the last block when nodeos runs with --track-access-sets.
+ */
+class profiler_api_plugin : public plugin<profiler_api_plugin> {
+public:
+   APPBASE_PLUGIN_REQUIRES((http_plugin) (chain_plugin))
+
+   profiler_api_plugin();
+   profiler_api_plugin(const profiler_api_plugin&) = delete;
+   profiler_api_plugin(profiler_api_plugin&&) = delete;
+   profiler_api_plugin& operator=(const profiler_api_plugin&) = delete;
+   profiler_api_plugin& operator=(profiler_api_plugin&&) = delete;
+   virtual ~profiler_api_plugin() override;
+
+   virtual void set_program_options(options_description& cli, options_description& cfg) override;
+   void plugin_initialize(const variables_map& vm);
+   void plugin_startup();
+   void plugin_shutdown();
+
+   profiler_get_profile_results get_profile( const profiler_get_profile_params& params );
+   chain_apis::empty reset( const chain_apis::empty& );
+   profiler_get_conflict_graph_results get_conflict_graph( const profiler_get_conflict_graph_params& params );
+
+private:
+   std::unique_ptr<struct profiler_api_plugin_impl> my;
+};
+
+}
+
+FC_REFLECT( eosio::profiler_get_profile_params, (limit) )
+FC_REFLECT( eosio::profiler_get_profile_results, (actions)(more) )
+FC_REFLECT( eosio::profiler_get_conflict_graph_params, (limit) )
+FC_REFLECT( eosio::profiler_get_conflict_graph_results, (graph)(more) )
@@ -0,0 +1,139 @@
+/**
+ *  @file
+ *  @copyright defined in eos/LICENSE
+ */
+#include <eosio/profiler_api_plugin/profiler_api_plugin.hpp>
+#include <eosio/chain/exceptions.hpp>
+
+#include <fc/variant.hpp>
+#include <fc/io/json.hpp>
+
+#include <boost/asio/steady_timer.hpp>
+
+namespace eosio {
+
+static appbase::abstract_plugin& _profiler_api_plugin = app().register_plugin<profiler_api_plugin>();
+
+using namespace eosio;
+
+struct profiler_api_plugin_impl {
+   chain::execution_profiler* profiler = nullptr;
+   uint32_t                   log_interval_sec = 0;
+   uint32_t                   log_limit = 10;
+   unique_ptr<boost::asio::steady_timer> log_timer;
+
+   chain::execution_profiler& get_profiler() {
+      EOS_ASSERT( profiler, chain::plugin_config_exception, "action profiling is disabled, start nodeos with --profile-actions" );
+      return *profiler;
+   }
+
+   void schedule_log() {
+      log_timer->expires_from_now( std::chrono::seconds( log_interval_sec ) );
+      log_timer->async_wait( [this]( const boost::system::error_code& ec ) {
+         if( ec ) return;
+         log_snapshot();
+         schedule_log();
+      } );
+   }
+
+   void log_snapshot() {
+      auto actions = profiler->snapshot();
+      if( actions.size() > log_limit )
+         actions.resize( log_limit );
+      for( const auto& a : actions ) {
+         ilog( "profile ${receiver}::${action} calls ${calls} failures ${failures} wall ${wall}us billed ${billed}us compile ${compile}us db ${db} ram ${ram}",
+               ("receiver", a.receiver)("action", a.action)("calls", a.profile.calls)("failures", a.profile.failures)
+               ("wall", a.profile.wall_time.count())("billed", a.profile.billed_cpu.count())
+               ("compile", a.profile.compile_time.count())("db", a.profile.db_calls)("ram", a.profile.ram_delta) );
+      }
+   }
+};
+
+profiler_api_plugin::profiler_api_plugin()
+:my(new profiler_api_plugin_impl()) {}
+
+profiler_api_plugin::~profiler_api_plugin() {}
+
+void profiler_api_plugin::set_program_options(options_description&, options_description& cfg) {
+   cfg.add_options()
+         ("profiler-log-interval-sec", boost::program_options::value<uint32_t>()->default_value(0),
+          "Interval in seconds between logs of the most expensive actions gathered by --profile-actions (0 to disable)")
+         ("profiler-log-limit", boost::program_options::value<uint32_t>()->default_value(10),
+          "Number of actions, ordered by decreasing wall time, included in each profile log")
+         ;
+}
+
+void profiler_api_plugin::plugin_initialize(const variables_map& options) {
+   try {
+      my->log_interval_sec = options.at( "profiler-log-interval-sec" ).as<uint32_t>();
+      my->log_limit = options.at( "profiler-log-limit" ).as<uint32_t>();
+   } FC_LOG_AND_RETHROW()
+}
+
+#define CALL(api_name, api_handle, call_name, params_type, http_response_code) \
+{std::string("/v1/" #api_name "/" #call_name), \
+   [api_handle](string, string body, url_response_callback cb) mutable { \
+          try { \
+             if (body.empty()) body = "{}"; \
+             auto result = api_handle->call_name(fc::json::from_string(body).as<params_type>()); \
+             cb(http_response_code, fc::json::to_string(result)); \
+          } catch (...) { \
+             http_plugin::handle_exception(#api_name, #call_name, body, cb); \
+          } \
+       }}
+
+void profiler_api_plugin::plugin_startup() {
+   my->profiler = app().get_plugin<chain_plugin>().chain().get_execution_profiler();
+   if( !my->profiler )
+      wlog( "profiler_api_plugin is enabled but action profiling is not, start nodeos with --profile-actions" );
+
+   app().get_plugin<http_plugin>().add_api({
+       CALL(profiler, this, get_profile, profiler_get_profile_params, 200),
+       CALL(profiler, this, reset, chain_apis::empty, 200),
+       CALL(profiler, this, get_conflict_graph, profiler_get_conflict_graph_params, 200)
+   });
+
+   if( my->profiler && my->log_interval_sec > 0 ) {
+      my->log_timer = std::make_unique<boost::asio::steady_timer>( app().get_io_service() );
+      my->schedule_log();
+   }
+}
+
+void profiler_api_plugin::plugin_shutdown() {
+   if( my->log_timer )
+      my->log_timer->cancel();
+}
+
+#undef CALL
+
+profiler_get_profile_results profiler_api_plugin::get_profile( const profiler_get_profile_params& params ) {
+   profiler_get_profile_results result;
+   result.actions = my->get_profiler().snapshot();
+   if( result.actions.size() > params.limit ) {
+      result.actions.resize( params.limit );
+      result.more = true;
+   }
+   return result;
+}
+
+chain_apis::empty profiler_api_plugin::reset( const chain_apis::empty& ) {
+   my->get_profiler().reset();
+   return {};
+}
+
+profiler_get_conflict_graph_results profiler_api_plugin::get_conflict_graph( const profiler_get_conflict_graph_params& params ) {
+   const auto& chain = app().get_plugin<chain_plugin>().chain();
+   EOS_ASSERT( chain.tracks_access_sets(), chain::plugin_config_exception, "access set tracking is disabled, start nodeos with --track-access-sets" );
+
+   profiler_get_conflict_graph_results result;
+   if( chain.last_conflict_graph() ) {
+      result.graph = *chain.last_conflict_graph();
+      if( result.graph.edges.size() > params.limit ) {
+         result.graph.edges.resize( params.limit );
+         result.more = true;
+      }
+   }
+   return result;
+}
+
+}
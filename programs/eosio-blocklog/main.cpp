@@ -27,15 +27,20 @@ struct blocklog {
    {}
 
    void read_log();
+   void convert_log();
    void set_program_options(options_description& cli);
    void initialize(const variables_map& options);
 
    bfs::path                        blocks_dir;
    bfs::path                        output_file;
+   bfs::path                        convert_dir;
+   block_log_compression            compression = block_log_compression::none;
    uint32_t                         first_block;
    uint32_t                         last_block;
    bool                             no_pretty_print;
    bool                             as_json_array;
+   bool                             rebuild_index;
+   uint32_t                         index_threads;
 };
 
 void blocklog::read_log() {
@@ -130,6 +135,30 @@ void blocklog::read_log() {
       *out << "]";
 }
 
+void blocklog::convert_log() {
+   EOS_ASSERT( !bfs::exists( convert_dir / "blocks.log" ), block_log_exception,
+               "Block log already exists in '${dir}'", ("dir", convert_dir.generic_string()) );
+
+   block_log in(blocks_dir);
+   const auto head = in.read_head();
+   EOS_ASSERT( head, block_log_exception, "No blocks found in block log" );
+   const uint32_t first = std::max( in.first_block_num(), first_block );
+   const uint32_t last = std::min( head->block_num(), last_block );
+   EOS_ASSERT( first <= last, block_log_exception, "No blocks in the range ${first} to ${last}", ("first", first)("last", last) );
+
+   block_log_config cfg;
+   cfg.compression = compression;
+   block_log out(convert_dir, cfg);
+   out.reset( block_log::extract_genesis_state( blocks_dir ), in.read_block_by_num( first ), first );
+   for( uint32_t block_num = first + 1; block_num <= last; ++block_num ) {
+      auto b = in.read_block_by_num( block_num );
+      EOS_ASSERT( b, block_log_exception, "Block ${n} is missing from the block log", ("n", block_num) );
+      out.append( b );
+   }
+   out.flush();
+   ilog( "wrote blocks ${first} through ${last} to ${dir}", ("first", first)("last", last)("dir", convert_dir.generic_string()) );
+}
+
 void blocklog::set_program_options(options_description& cli)
 {
    cli.add_options()
@@ -145,6 +174,14 @@ void blocklog::set_program_options(options_description& cli)
           "Do not pretty print the output.  Useful if piping to jq to improve performance.")
          ("as-json-array", bpo::bool_switch(&as_json_array)->default_value(false),
           "Print out json blocks wrapped in json array (otherwise the output is free-standing json objects).")
+         ("convert-to", bpo::value<bfs::path>(),
+          "write the blocks from first to last into a new block log in this directory instead of logging them, in the format of --compression")
+         ("compression", bpo::value<std::string>()->default_value("none"),
+          "compression of the block log written by --convert-to, either none or zlib")
+         ("rebuild-index", bpo::bool_switch(&rebuild_index)->default_value(false),
+          "rebuild blocks.index from blocks.log in the blocks directory and exit")
+         ("index-threads", bpo::value<uint32_t>(&index_threads)->default_value(0),
+          "number of threads checking the blocks of --rebuild-index (0 for one per core)")
          ("help", "Print this help message and exit.")
          ;
 
@@ -165,6 +202,20 @@ void blocklog::initialize(const variables_map& options) {
          else
             output_file = bld;
       }
+
+      if (options.count( "convert-to" )) {
+         bld = options.at( "convert-to" ).as<bfs::path>();
+         if( bld.is_relative())
+            convert_dir = bfs::current_path() / bld;
+         else
+            convert_dir = bld;
+      }
+
+      const auto c = options.at( "compression" ).as<std::string>();
+      if( c == "zlib" )
+         compression = block_log_compression::zlib;
+      else
+         EOS_ASSERT( c == "none", fc::invalid_arg_exception, "Unknown block log compression '${c}'", ("c", c) );
    } FC_LOG_AND_RETHROW()
 
 }
@@ -185,7 +236,15 @@ int main(int argc, char** argv)
         return 0;
       }
       blog.initialize(vmap);
-      blog.read_log();
+      if (blog.rebuild_index) {
+         auto start = fc::time_point::now();
+         block_log::construct_index( blog.blocks_dir / "blocks.log", blog.blocks_dir / "blocks.index", blog.index_threads );
+         ilog( "rebuilt block log index in ${t} ms", ("t", (fc::time_point::now() - start).count() / 1000) );
+      } else if (!blog.convert_dir.empty()) {
+         blog.convert_log();
+      } else {
+         blog.read_log();
+      }
    } catch( const fc::exception& e ) {
       elog( "${e}", ("e", e.to_detail_string()));
       return -1;
@@ -0,0 +1,301 @@
+/**
+ *  @file
+ *  @copyright defined in eosio/LICENSE.txt
+ */
+#include <eosio/chain/exceptions.hpp>
+#include <eosio/chain/open_address_map.hpp>
+
+#include <fc/log/logger.hpp>
+
+#include <boost/exception/diagnostic_information.hpp>
+#include <boost/program_options.hpp>
+
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <vector>
+
+using namespace eosio::chain;
+namespace bpo = boost::program_options;
+using bpo::options_description;
+using bpo::variables_map;
+
+namespace {
+
+   struct table { uint64_t id = 0; };
+   struct row   { uint64_t primary_key = 0; };
+
+   /// the lookups of apply_context::iterator_cache before it used open_address_map, built for every action
+   class map_cache {
+      public:
+         map_cache() {
+            end_iterator_to_table.reserve(8);
+            iterator_to_object.reserve(32);
+         }
+
+         int cache_table( const table& t ) {
+            auto itr = table_cache.find( t.id );
+            if( itr != table_cache.end() )
+               return itr->second.second;
+            int ei = -int(end_iterator_to_table.size() + 2);
+            end_iterator_to_table.push_back( &t );
+            table_cache.emplace( t.id, std::make_pair( &t, ei ) );
+            return ei;
+         }
+
+         int add( const row& r ) {
+            auto itr = object_to_iterator.find( &r );
+            if( itr != object_to_iterator.end() )
+               return itr->second;
+            iterator_to_object.push_back( &r );
+            object_to_iterator[&r] = iterator_to_object.size() - 1;
+            return iterator_to_object.size() - 1;
+         }
+
+         const row& get( int iterator )const { return *iterator_to_object[iterator]; }
+
+         void remove( int iterator ) {
+            auto r = iterator_to_object[iterator];
+            iterator_to_object[iterator] = nullptr;
+            object_to_iterator.erase( r );
+         }
+
+         void clear() {}
+
+      private:
+         std::map<uint64_t, std::pair<const table*, int>> table_cache;
+         std::vector<const table*>                         end_iterator_to_table;
+         std::vector<const row*>                           iterator_to_object;
+         std::map<const row*, int>                         object_to_iterator;
+   };
+
+   /// the lookups of apply_context::iterator_cache, reused by one action after another
+   class flat_cache {
+      public:
+         flat_cache() {
+            end_iterator_to_table.reserve(8);
+            iterator_to_object.reserve(32);
+         }
+
+         int cache_table( const table& t ) {
+            if( auto cached = table_cache.find( t.id ) )
+               return cached->second;
+            int ei = -int(end_iterator_to_table.size() + 2);
+            end_iterator_to_table.push_back( &t );
+            table_cache.insert( t.id, std::make_pair( &t, ei ) );
+            return ei;
+         }
+
+         int add( const row& r ) {
+            if( auto cached = object_to_iterator.find( key_of( &r ) ) )
+               return *cached;
+            iterator_to_object.push_back( &r );
+            object_to_iterator.insert( key_of( &r ), iterator_to_object.size() - 1 );
+            return iterator_to_object.size() - 1;
+         }
+
+         const row& get( int iterator )const { return *iterator_to_object[iterator]; }
+
+         void remove( int iterator ) {
+            auto r = iterator_to_object[iterator];
+            iterator_to_object[iterator] = nullptr;
+            object_to_iterator.erase( key_of( r ) );
+         }
+
+         void clear() {
+            table_cache.clear();
+            end_iterator_to_table.clear();
+            iterator_to_object.clear();
+            object_to_iterator.clear();
+         }
+
+      private:
+         static uint64_t key_of( const row* r ) { return reinterpret_cast<uintptr_t>( r ); }
+
+         open_address_map<std::pair<const table*, int>> table_cache;
+         std::vector<const table*>                       end_iterator_to_table;
+         std::vector<const row*>                         iterator_to_object;
+         open_address_map<int>                           object_to_iterator;
+   };
+
+}
+
+/**
+ *  Replays the iterator cache operations that the idx64_general action of test_api_multi_index causes through the
+ *  db_*_i64 and db_idx64_* intrinsics, comparing the std::map layout built per action with the open_address_map
+ *  layout reused across actions. Every action works on its own table, so the rows it touches lie elsewhere in memory
+ *  than those of the previous action, as the rows of different contracts do.
+ */
+struct iterbench {
+   void set_program_options(options_description& cli);
+   void initialize(const variables_map& options);
+   void run();
+
+   uint64_t    actions = 0;
+   uint32_t    rows = 0;
+   uint32_t    tables = 0;
+
+   private:
+      /// a row and its idx64 secondary row, allocated one by one like the nodes of a chainbase index
+      struct stored_row {
+         std::unique_ptr<row> primary;
+         std::unique_ptr<row> secondary;
+      };
+
+      template<typename Cache>
+      uint64_t apply( Cache& keyval, Cache& idx64, uint64_t action, uint64_t& calls );
+
+      template<typename Cache>
+      void measure( const char* name, bool reuse );
+
+      std::vector<table>                    primary_tables;
+      std::vector<table>                    secondary_tables;
+      std::vector<std::vector<stored_row>>  table_rows;
+      stored_row                            new_row;
+};
+
+void iterbench::set_program_options(options_description& cli)
+{
+   cli.add_options()
+         ("actions", bpo::value<uint64_t>(&actions)->default_value(1000*1000),
+          "number of actions replayed with each cache layout")
+         ("rows", bpo::value<uint32_t>(&rows)->default_value(9),
+          "number of rows each action stores and looks up, idx64_general stores 9")
+         ("tables", bpo::value<uint32_t>(&tables)->default_value(1000),
+          "number of distinct tables the actions cycle through")
+         ("help", "Print this help message and exit.")
+         ;
+}
+
+void iterbench::initialize(const variables_map& options) {
+   try {
+      EOS_ASSERT( actions > 0 && rows > 0 && tables > 0, fc::invalid_arg_exception,
+                  "--actions, --rows and --tables must be positive" );
+   } FC_LOG_AND_RETHROW()
+
+   primary_tables.resize( tables );
+   secondary_tables.resize( tables );
+   table_rows.resize( tables );
+   for( uint32_t t = 0; t < tables; ++t ) {
+      primary_tables[t].id = 2 * t;
+      secondary_tables[t].id = 2 * t + 1;
+      for( uint32_t i = 0; i < rows; ++i ) {
+         stored_row r;
+         r.primary.reset( new row{ i } );
+         r.secondary.reset( new row{ i } );
+         table_rows[t].push_back( std::move( r ) );
+      }
+   }
+   new_row.primary.reset( new row{ rows } );
+   new_row.secondary.reset( new row{ rows } );
+}
+
+/// every intrinsic caches its table first, then adds the row it found and the contract reads the row back
+template<typename Cache>
+uint64_t iterbench::apply( Cache& keyval, Cache& idx64, uint64_t action, uint64_t& calls ) {
+   const uint32_t t = action % tables;
+   const auto& pt = primary_tables[t];
+   const auto& st = secondary_tables[t];
+   const auto& trows = table_rows[t];
+   uint64_t checksum = 0;
+
+   auto primary = [&]( const row& r ) {
+      keyval.cache_table( pt );
+      ++calls;
+      return keyval.get( keyval.add( r ) ).primary_key;
+   };
+   auto secondary = [&]( const row& r ) {
+      idx64.cache_table( st );
+      ++calls;
+      return idx64.get( idx64.add( r ) ).primary_key;
+   };
+
+   // emplace: db_store_i64 and db_idx64_store
+   for( const auto& r : trows ) {
+      checksum += primary( *r.primary );
+      checksum += secondary( *r.secondary );
+   }
+   // find of a missing and of existing primary keys and increments to the end
+   keyval.cache_table( pt );
+   ++calls;
+   for( uint32_t i = 0; i < trows.size(); i += 2 )
+      checksum += primary( *trows[i].primary );
+   // lower_bound on the secondary index, iterating forward and backward, each row read through its primary key
+   for( uint32_t i = 0; i < trows.size(); ++i ) {
+      checksum += secondary( *trows[i].secondary );
+      checksum += primary( *trows[i].primary );
+   }
+   for( uint32_t i = trows.size(); i-- > 0; )
+      checksum += secondary( *trows[i].secondary );
+   // emplace, modify, find and erase of a new row
+   checksum += primary( *new_row.primary );
+   checksum += secondary( *new_row.secondary );
+   checksum += primary( *new_row.primary );
+   idx64.remove( idx64.add( *new_row.secondary ) );
+   keyval.remove( keyval.add( *new_row.primary ) );
+   calls += 2;
+   return checksum;
+}
+
+template<typename Cache>
+void iterbench::measure( const char* name, bool reuse ) {
+   uint64_t checksum = 0;
+   uint64_t calls = 0;
+   Cache keyval, idx64;
+   auto start = std::chrono::steady_clock::now();
+   for( uint64_t a = 0; a < actions; ++a ) {
+      if( reuse ) {
+         checksum += apply( keyval, idx64, a, calls );
+         keyval.clear();
+         idx64.clear();
+      } else {
+         Cache action_keyval, action_idx64;
+         checksum += apply( action_keyval, action_idx64, a, calls );
+      }
+   }
+   auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>( std::chrono::steady_clock::now() - start ).count();
+
+   std::cout << std::left << std::setw(24) << name << std::right
+             << "  per action " << std::setw(8) << ns / int64_t(actions) << " ns"
+             << "  per call "   << std::setw(8) << ns / int64_t(calls) << " ns"
+             << "  (checksum " << checksum << ")" << std::endl;
+}
+
+void iterbench::run() {
+   measure<map_cache>( "std::map per action", false );
+   measure<flat_cache>( "open_address_map reused", true );
+}
+
+int main(int argc, char** argv)
+{
+   options_description cli ("eosio-iterbench command line options");
+   try {
+      iterbench bench;
+      bench.set_program_options(cli);
+      variables_map vmap;
+      bpo::store(bpo::parse_command_line(argc, argv, cli), vmap);
+      bpo::notify(vmap);
+      if (vmap.count("help") > 0) {
+        cli.print(std::cerr);
+        return 0;
+      }
+      bench.initialize(vmap);
+      bench.run();
+   } catch( const fc::exception& e ) {
+      elog( "${e}", ("e", e.to_detail_string()));
+      return -1;
+   } catch( const boost::exception& e ) {
+      elog("${e}", ("e",boost::diagnostic_information(e)));
+      return -1;
+   } catch( const std::exception& e ) {
+      elog("${e}", ("e",e.what()));
+      return -1;
+   } catch( ... ) {
+      elog("unknown exception");
+      return -1;
+   }
+
+   return 0;
+}
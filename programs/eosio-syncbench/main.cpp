@@ -0,0 +1,178 @@
+/**
+ *  @file
+ *  @copyright defined in eosio/LICENSE.txt
+ */
+#include <eosio/chain/block_log.hpp>
+#include <eosio/chain/controller.hpp>
+#include <eosio/chain/exceptions.hpp>
+
+#include <fc/log/logger.hpp>
+
+#include <boost/exception/diagnostic_information.hpp>
+#include <boost/program_options.hpp>
+#include <boost/filesystem.hpp>
+
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+
+using namespace eosio::chain;
+namespace bfs = boost::filesystem;
+namespace bpo = boost::program_options;
+using bpo::options_description;
+using bpo::variables_map;
+
+/**
+ *  Measures the rate at which a fresh node applies the blocks of an existing block log, once with full validation
+ *  and once with the last applied block configured as light validation checkpoint. The checkpointed run proves the
+ *  ancestors of the checkpoint from the headers of the log the way net_plugin requests them from a peer. The headers
+ *  are taken from whole blocks read from the log and that time counts towards its sync time, so the checkpointed
+ *  rate is a lower bound.
+ */
+struct syncbench {
+   void set_program_options(options_description& cli);
+   void initialize(const variables_map& options);
+   void run();
+
+   bfs::path   blocks_dir;
+   bfs::path   data_dir;
+   uint64_t    database_size_mb = 0;
+   uint32_t    last_block = 0;
+   uint32_t    headers_span = 0;
+   bool        keep = false;
+
+   private:
+      void sync( const char* name, const block_log& source, const signed_block_ptr& checkpoint );
+};
+
+void syncbench::set_program_options(options_description& cli)
+{
+   cli.add_options()
+         ("blocks-dir", bpo::value<bfs::path>()->default_value("blocks"),
+          "the directory of the block log the blocks are read from, which must start at block 1 (absolute path or relative to the current directory)")
+         ("data-dir", bpo::value<bfs::path>()->default_value("syncbench"),
+          "the directory of the synced chains, which must not exist (absolute path or relative to the current directory)")
+         ("database-size-mb", bpo::value<uint64_t>(&database_size_mb)->default_value(config::default_state_size / (1024 * 1024)),
+          "size of the state database of each synced chain in MiB")
+         ("last-block", bpo::value<uint32_t>(&last_block)->default_value(0),
+          "the last block applied and the checkpoint of the checkpointed sync, 0 for the head of the block log")
+         ("headers-span", bpo::value<uint32_t>(&headers_span)->default_value(1000),
+          "number of headers read for each request of the checkpointed sync")
+         ("keep", bpo::bool_switch(&keep)->default_value(false),
+          "keep the synced chains rather than removing them on exit")
+         ("help", "Print this help message and exit.")
+         ;
+}
+
+void syncbench::initialize(const variables_map& options) {
+   try {
+      auto bld = options.at( "blocks-dir" ).as<bfs::path>();
+      blocks_dir = bld.is_relative() ? bfs::current_path() / bld : bld;
+      auto dir = options.at( "data-dir" ).as<bfs::path>();
+      data_dir = dir.is_relative() ? bfs::current_path() / dir : dir;
+      EOS_ASSERT( bfs::exists( blocks_dir / "blocks.log" ), fc::invalid_arg_exception,
+                  "Block log not found in '${dir}'", ("dir", blocks_dir.generic_string()) );
+      EOS_ASSERT( !bfs::exists( data_dir ), fc::invalid_arg_exception,
+                  "Data directory '${dir}' already exists", ("dir", data_dir.generic_string()) );
+      EOS_ASSERT( headers_span > 0, fc::invalid_arg_exception, "--headers-span must be positive" );
+   } FC_LOG_AND_RETHROW()
+}
+
+void syncbench::sync( const char* name, const block_log& source, const signed_block_ptr& checkpoint ) {
+   controller::config cfg;
+   cfg.blocks_dir = data_dir / name / config::default_blocks_dir_name;
+   cfg.state_dir  = data_dir / name / config::default_state_dir_name;
+   cfg.state_size = database_size_mb * 1024 * 1024;
+   cfg.genesis    = block_log::extract_genesis_state( blocks_dir );
+   if( checkpoint )
+      cfg.light_validation_checkpoints.insert( checkpoint->id() );
+
+   controller chain( cfg );
+   chain.add_indices();
+   chain.startup( []() { return false; } );
+
+   uint64_t transactions = 0;
+   uint64_t headers = 0;
+   auto start = std::chrono::steady_clock::now();
+   for( uint32_t num = chain.head_block_num() + 1; num <= last_block; ++num ) {
+      if( checkpoint ) {
+         const auto needed = chain.checkpoint_headers_needed();
+         if( needed != block_id_type() ) {
+            vector<signed_block_header> span;
+            for( uint32_t n = block_header::num_from_id( needed ); n > 0 && span.size() < headers_span; --n )
+               span.push_back( *source.read_block_by_num( n ) );
+            headers += chain.add_checkpoint_headers( span );
+         }
+      }
+
+      auto b = source.read_block_by_num( num );
+      EOS_ASSERT( b, block_log_exception, "block ${num} is missing from the block log", ("num", num) );
+      transactions += b->transactions.size();
+      auto bsf = chain.create_block_state_future( b );
+      chain.push_block( bsf );
+   }
+   auto us = std::chrono::duration_cast<std::chrono::microseconds>( std::chrono::steady_clock::now() - start ).count();
+   EOS_ASSERT( chain.head_block_num() == last_block, block_log_exception, "sync stopped at block ${num}", ("num", chain.head_block_num()) );
+
+   const double seconds = std::max<int64_t>( us, 1 ) / 1e6;
+   std::cout << std::left << std::setw(14) << name << std::right
+             << "  blocks " << std::setw(10) << last_block - 1
+             << "  " << std::setw(10) << std::fixed << std::setprecision(1) << (last_block - 1) / seconds << " blocks/s"
+             << "  " << std::setw(10) << transactions / seconds << " trxs/s"
+             << "  headers proven " << headers << std::endl;
+}
+
+void syncbench::run() {
+   block_log source( blocks_dir );
+   EOS_ASSERT( source.first_block_num() == 1, block_log_exception, "the block log must start at block 1" );
+   const auto head = source.read_head();
+   EOS_ASSERT( head && head->block_num() > 1, block_log_exception, "the block log holds no blocks after the genesis block" );
+   if( last_block == 0 || last_block > head->block_num() )
+      last_block = head->block_num();
+   EOS_ASSERT( last_block > 1, fc::invalid_arg_exception, "--last-block must be greater than 1" );
+
+   sync( "full", source, signed_block_ptr() );
+   sync( "checkpointed", source, source.read_block_by_num( last_block ) );
+}
+
+int main(int argc, char** argv)
+{
+   options_description cli ("eosio-syncbench command line options");
+   bfs::path data_dir;
+   bool keep = false;
+   int result = 0;
+   try {
+      syncbench bench;
+      bench.set_program_options(cli);
+      variables_map vmap;
+      bpo::store(bpo::parse_command_line(argc, argv, cli), vmap);
+      bpo::notify(vmap);
+      if (vmap.count("help") > 0) {
+        cli.print(std::cerr);
+        return 0;
+      }
+      bench.initialize(vmap);
+      data_dir = bench.data_dir;
+      keep = bench.keep;
+      bench.run();
+   } catch( const fc::exception& e ) {
+      elog( "${e}", ("e", e.to_detail_string()));
+      result = -1;
+   } catch( const boost::exception& e ) {
+      elog("${e}", ("e",boost::diagnostic_information(e)));
+      result = -1;
+   } catch( const std::exception& e ) {
+      elog("${e}", ("e",e.what()));
+      result = -1;
+   } catch( ... ) {
+      elog("unknown exception");
+      result = -1;
+   }
+
+   // the synced chains are removed on failure too, the data directory did not exist before
+   if( !keep && !data_dir.empty() ) {
+      boost::system::error_code ec;
+      bfs::remove_all( data_dir, ec );
+   }
+   return result;
+}
@@ -247,6 +247,7 @@ BOOST_FIXTURE_TEST_CASE(action_receipt_tests, TESTER) { try {
 	create_account( N(testapi) );
 	create_account( N(testapi2) );
 	produce_blocks(10);
+   activate_feature( config::db_scan_feature_name );
 	set_code( N(testapi), test_api_wast );
 	produce_blocks(1);
 
@@ -1290,6 +1291,42 @@ BOOST_FIXTURE_TEST_CASE(chain_tests, TESTER) { try {
    BOOST_REQUIRE_EQUAL( validate(), true );
 } FC_LOG_AND_RETHROW() }
 
+/*************************************************************************************
+ * db_scan_activation test case
+ *************************************************************************************/
+// contracts importing db_scan_i64 can only be deployed from the block after the chain activated it
+BOOST_FIXTURE_TEST_CASE(db_scan_activation, TESTER) { try {
+   produce_blocks(2);
+   create_account( N(testapi) );
+   produce_block();
+
+   BOOST_CHECK( !control->is_db_scan_active() );
+   BOOST_CHECK_EXCEPTION( set_code( N(testapi), test_api_db_wast ), wasm_exception,
+                          []( const fc::exception& e ) {
+                             return expect_assert_message( e, "db_scan_i64 is not activated on this chain" );
+                          } );
+   BOOST_CHECK_EXCEPTION( push_action( config::system_account_name, N(activate), config::system_account_name,
+                                       mutable_variant_object()("feature", "nofeature") ),
+                          unsupported_feature,
+                          []( const fc::exception& e ) {
+                             return expect_assert_message( e, "Unsupported Hardfork Detected" );
+                          } );
+
+   // the activation is in effect from the next block on
+   push_action( config::system_account_name, N(activate), config::system_account_name,
+                mutable_variant_object()("feature", name(config::db_scan_feature_name)) );
+   BOOST_CHECK( !control->is_db_scan_active() );
+   BOOST_CHECK_THROW( set_code( N(testapi), test_api_db_wast ), wasm_exception );
+   produce_block();
+
+   BOOST_CHECK( control->is_db_scan_active() );
+   BOOST_CHECK_THROW( activate_feature( config::db_scan_feature_name ), unsupported_feature );
+   set_code( N(testapi), test_api_db_wast );
+   produce_block();
+
+   BOOST_REQUIRE_EQUAL( validate(), true );
+} FC_LOG_AND_RETHROW() }
+
 /*************************************************************************************
  * db_tests test case
  *************************************************************************************/
@@ -1298,6 +1335,7 @@ BOOST_FIXTURE_TEST_CASE(db_tests, TESTER) { try {
    create_account( N(testapi) );
    create_account( N(testapi2) );
    produce_blocks(10);
+   activate_feature( config::db_scan_feature_name );
    set_code( N(testapi), test_api_db_wast );
    set_code( N(testapi2), test_api_db_wast );
    produce_blocks(1);
@@ -1305,6 +1343,7 @@ BOOST_FIXTURE_TEST_CASE(db_tests, TESTER) { try {
    CALL_TEST_FUNCTION( *this, "test_db", "primary_i64_general", {});
    CALL_TEST_FUNCTION( *this, "test_db", "primary_i64_lowerbound", {});
    CALL_TEST_FUNCTION( *this, "test_db", "primary_i64_upperbound", {});
+   CALL_TEST_FUNCTION( *this, "test_db", "primary_i64_scan", {});
    CALL_TEST_FUNCTION( *this, "test_db", "idx64_general", {});
    CALL_TEST_FUNCTION( *this, "test_db", "idx64_lowerbound", {});
    CALL_TEST_FUNCTION( *this, "test_db", "idx64_upperbound", {});
@@ -1385,6 +1424,7 @@ BOOST_FIXTURE_TEST_CASE(multi_index_tests, TESTER) { try {
    produce_blocks(1);
    create_account( N(testapi) );
    produce_blocks(1);
+   activate_feature( config::db_scan_feature_name );
    set_code( N(testapi), test_api_multi_index_wast );
    produce_blocks(1);
 
@@ -5,6 +5,12 @@
 
 #include <boost/test/unit_test.hpp>
 #include <eosio/testing/tester.hpp>
+#include <eosio/chain/account_object.hpp>
+#include <eosio/chain/block_log.hpp>
+
+#include <atomic>
+#include <fstream>
+#include <thread>
 
 using namespace eosio;
 using namespace testing;
@@ -164,4 +170,421 @@ BOOST_AUTO_TEST_CASE(untrusted_producer_test)
    }) ;
 }
 
+// signing keys of the transactions of a received block are recovered ahead of apply_block and used by it
+BOOST_AUTO_TEST_CASE(signing_keys_recovered_ahead_test)
+{
+   tester main;
+   for( auto a : { N(alice), N(bob), N(carol), N(dave) } )
+      main.create_account( a );
+   auto b = main.produce_block();
+   BOOST_REQUIRE_EQUAL( b->transactions.size(), 4 );
+
+   tester validator;
+   vector<transaction_metadata_ptr> accepted;
+   auto c = validator.control->accepted_transaction.connect( [&]( const transaction_metadata_ptr& trx ) {
+      if( !trx->implicit )
+         accepted.push_back( trx );
+   } );
+
+   auto bs = validator.control->create_block_state_future( b );
+   validator.control->abort_block();
+   validator.control->push_block( bs );
+   c.disconnect();
+
+   BOOST_REQUIRE_EQUAL( accepted.size(), b->transactions.size() );
+   const auto expected_key = main.get_public_key( config::system_account_name, "active" );
+   for( const auto& trx : accepted ) {
+      BOOST_REQUIRE( trx->signing_keys.valid() );
+      BOOST_CHECK( trx->signing_keys->first == validator.control->get_chain_id() );
+      BOOST_CHECK( trx->signing_keys->second == flat_set<public_key_type>{ expected_key } );
+   }
+   BOOST_CHECK_EQUAL( validator.control->head_block_id(), b->id() );
+}
+
+// upcoming blocks are prepared before the blocks they build on are applied, and a failed block fails those built on it
+BOOST_AUTO_TEST_CASE(block_prepare_window_test)
+{
+   tester main;
+   vector<signed_block_ptr> blocks;
+   for( auto a : { N(alice), N(bob), N(carol), N(dave) } ) {
+      main.create_account( a );
+      blocks.push_back( main.produce_block() );
+   }
+
+   tester validator;
+   validator.control->abort_block();
+
+   // the signature is not part of the block id, so the corrupted block is the previous block of blocks[2]
+   auto bad = std::make_shared<signed_block>( *blocks[1] );
+   bad->producer_signature = main.get_private_key( N(alice), "active" ).sign( bad->digest() );
+   BOOST_REQUIRE( bad->id() == blocks[1]->id() );
+
+   auto first = validator.control->create_block_state_future( blocks[0] );
+   auto bad_bs = validator.control->create_block_state_future( bad );
+   // the block built on the corrupted block fails as well, already when it is prepared if the corrupted block failed
+   std::future<block_state_ptr> third;
+   try {
+      third = validator.control->create_block_state_future( blocks[2] );
+   } catch( const unlinkable_block_exception& ) {
+   }
+   validator.control->push_block( first );
+   BOOST_CHECK_THROW( validator.control->push_block( bad_bs ), fc::exception );
+   if( third.valid() )
+      BOOST_CHECK_THROW( validator.control->push_block( third ), unlinkable_block_exception );
+   BOOST_CHECK_EQUAL( validator.control->head_block_id(), blocks[0]->id() );
+
+   vector<std::future<block_state_ptr>> prepared;
+   for( size_t i = 1; i < blocks.size(); ++i )
+      prepared.push_back( validator.control->create_block_state_future( blocks[i] ) );
+   // a block being prepared is handed out again rather than validated twice
+   auto again = validator.control->create_block_state_future( blocks.back() );
+
+   for( auto& bs : prepared )
+      validator.control->push_block( bs );
+   BOOST_CHECK_EQUAL( validator.control->head_block_id(), blocks.back()->id() );
+   BOOST_CHECK_EQUAL( again.get()->id, blocks.back()->id() );
+
+   main.produce_block();
+   auto orphan = main.produce_block();
+   BOOST_CHECK_THROW( validator.control->create_block_state_future( orphan ), unlinkable_block_exception );
+}
+
+// blocks that failed or are already prepared do not count against the window, only blocks being prepared do
+BOOST_AUTO_TEST_CASE(block_prepare_window_in_flight_test)
+{
+   tester main;
+   vector<signed_block_ptr> blocks;
+   for( auto a : { N(alice), N(bob), N(carol) } ) {
+      main.create_account( a );
+      blocks.push_back( main.produce_block() );
+   }
+
+   fc::temp_directory tempdir;
+   auto cfg = tester::default_config( tempdir );
+   cfg.block_prepare_window = 1;
+   tester validator( cfg, true );
+   validator.control->abort_block();
+
+   auto bad = std::make_shared<signed_block>( *blocks[0] );
+   bad->producer_signature = main.get_private_key( N(alice), "active" ).sign( bad->digest() );
+   BOOST_REQUIRE( bad->id() == blocks[0]->id() );
+   BOOST_CHECK_THROW( validator.control->create_block_state_future( bad ).get(), fc::exception );
+
+   // the failed block is dropped rather than handed out for the valid block with its id
+   vector<std::future<block_state_ptr>> prepared;
+   for( const auto& b : blocks ) {
+      prepared.push_back( validator.control->create_block_state_future( b ) );
+      // waits for the block to be prepared, its future stays with the controller
+      BOOST_CHECK_EQUAL( validator.control->create_block_state_future( b ).get()->id, b->id() );
+   }
+
+   for( auto& bs : prepared )
+      validator.control->push_block( bs );
+   BOOST_CHECK_EQUAL( validator.control->head_block_id(), blocks.back()->id() );
+}
+
+// blocks proven to be ancestors of a checkpoint by their headers are light validated, the blocks above it are not
+BOOST_AUTO_TEST_CASE(checkpoint_light_validation_test)
+{
+   tester main;
+   vector<signed_block_ptr> blocks;
+   for( auto a : { N(alice), N(bob), N(carol), N(dave) } ) {
+      main.create_account( a );
+      blocks.push_back( main.produce_block() );
+   }
+   const auto checkpoint = blocks[2]->id();
+
+   fc::temp_directory tempdir;
+   auto cfg = tester::default_config( tempdir );
+   cfg.light_validation_checkpoints.insert( checkpoint );
+   tester validator( cfg, true );
+
+   BOOST_CHECK( validator.control->is_checkpoint_ancestor( checkpoint ) );
+   BOOST_CHECK( !validator.control->is_checkpoint_ancestor( blocks[1]->id() ) );
+   BOOST_CHECK_EQUAL( validator.control->checkpoint_headers_needed(), checkpoint );
+
+   vector<signed_block_header> headers{ *blocks[1], *blocks[0] };
+   BOOST_CHECK_THROW( validator.control->add_checkpoint_headers( headers ), checkpoint_exception );
+   headers = { *blocks[2], *blocks[0] };
+   BOOST_CHECK_THROW( validator.control->add_checkpoint_headers( headers ), checkpoint_exception );
+   BOOST_CHECK( !validator.control->is_checkpoint_ancestor( blocks[0]->id() ) );
+
+   headers = { *blocks[2], *blocks[1], *blocks[0] };
+   BOOST_CHECK_EQUAL( validator.control->add_checkpoint_headers( headers ), 3 );
+   BOOST_CHECK( validator.control->is_checkpoint_ancestor( blocks[0]->id() ) );
+   BOOST_CHECK( !validator.control->is_checkpoint_ancestor( blocks[3]->id() ) );
+   BOOST_CHECK_EQUAL( validator.control->checkpoint_headers_needed(), block_id_type() );
+
+   map<uint32_t, vector<transaction_metadata_ptr>> accepted;
+   auto c = validator.control->accepted_transaction.connect( [&]( const transaction_metadata_ptr& trx ) {
+      if( !trx->implicit )
+         accepted[validator.control->pending_block_state()->block_num].push_back( trx );
+   } );
+   for( const auto& b : blocks )
+      validator.push_block( b );
+   c.disconnect();
+   BOOST_CHECK_EQUAL( validator.control->head_block_id(), blocks.back()->id() );
+
+   // signing keys are only recovered for the authorization checks of the block above the checkpoint
+   for( const auto& b : blocks ) {
+      const auto& trxs = accepted[b->block_num()];
+      BOOST_REQUIRE_EQUAL( trxs.size(), 1 );
+      BOOST_CHECK_EQUAL( trxs.front()->signing_keys.valid(), b->block_num() > blocks[2]->block_num() );
+   }
+}
+
+// a replay reading ahead of the applied blocks reaches the same head and state as a replay on the main thread only
+BOOST_AUTO_TEST_CASE(replay_read_ahead_test)
+{
+   tester chain;
+   for( auto a : { N(alice), N(bob), N(carol), N(dave) } ) {
+      chain.create_account( a );
+      chain.produce_blocks( 3 );
+   }
+   chain.produce_blocks( 20 );
+   const auto head_id = chain.control->head_block_id();
+   BOOST_REQUIRE_GT( chain.control->last_irreversible_block_num(), 10 );
+   chain.close();
+
+   for( uint32_t read_ahead : { 0, 4 } ) {
+      auto cfg = chain.get_config();
+      cfg.replay_read_ahead_blocks = read_ahead;
+      cfg.force_all_checks = true;
+      fc::remove_all( cfg.state_dir );
+      chain.init( cfg );
+      BOOST_CHECK_EQUAL( chain.control->head_block_id(), head_id );
+      for( auto a : { N(alice), N(bob), N(carol), N(dave) } )
+         BOOST_CHECK( chain.control->db().find<account_object, by_name>( a ) );
+      chain.close();
+   }
+}
+
+// irreversible blocks queued for the block log writer are readable right away and all written on shutdown
+BOOST_AUTO_TEST_CASE(block_log_write_queue_test)
+{
+   fc::temp_directory tempdir;
+   auto cfg = tester::default_config( tempdir );
+   cfg.block_log_write_queue_size = 4;
+   cfg.block_log_fsync_interval = 3;
+   tester chain( cfg, true );
+
+   vector<block_id_type> ids;
+   for( int i = 0; i < 50; ++i )
+      ids.push_back( chain.produce_block()->id() );
+
+   const auto lib = chain.control->last_irreversible_block_num();
+   BOOST_REQUIRE_GT( lib, block_header::num_from_id( ids.front() ) );
+   for( uint32_t n = 1; n <= lib; ++n ) {
+      auto b = chain.control->fetch_block_by_number( n );
+      BOOST_REQUIRE( b );
+      BOOST_CHECK_EQUAL( b->block_num(), n );
+   }
+   chain.close();
+
+   block_log blog( cfg.blocks_dir );
+   BOOST_REQUIRE( blog.head() );
+   BOOST_CHECK_EQUAL( blog.head()->block_num(), lib );
+   for( const auto& id : ids ) {
+      if( block_header::num_from_id( id ) <= lib )
+         BOOST_CHECK_EQUAL( blog.read_block_by_id( id )->id(), id );
+   }
+}
+
+// blocks are read from the mapped block log and its cache by many threads at once
+BOOST_AUTO_TEST_CASE(block_log_concurrent_reads_test)
+{
+   tester chain;
+   vector<block_id_type> ids;
+   for( int i = 0; i < 40; ++i )
+      ids.push_back( chain.produce_block()->id() );
+   const auto lib = chain.control->last_irreversible_block_num();
+   auto blocks_dir = chain.get_config().blocks_dir;
+   chain.close();
+
+   block_log_config cfg;
+   cfg.cache_size = 8;
+   block_log blog( blocks_dir, cfg );
+   BOOST_REQUIRE_EQUAL( blog.read_head()->block_num(), lib );
+
+   std::atomic<uint32_t> mismatches{0};
+   vector<std::thread> readers;
+   for( uint32_t t = 0; t < 4; ++t ) {
+      readers.emplace_back( [&]() {
+         for( uint32_t round = 0; round < 20; ++round ) {
+            for( const auto& id : ids ) {
+               auto num = block_header::num_from_id( id );
+               auto b = blog.read_block_by_num( num );
+               if( num <= lib ? !b || b->id() != id : !!b )
+                  ++mismatches;
+            }
+         }
+      } );
+   }
+   for( auto& r : readers )
+      r.join();
+   BOOST_CHECK_EQUAL( mismatches.load(), 0 );
+   BOOST_CHECK( !blog.read_block_by_num( lib + 1 ) );
+}
+
+// headers are served from the block states of reversible blocks and read on their own from the block log
+BOOST_AUTO_TEST_CASE(fetch_block_header_test)
+{
+   tester chain;
+   chain.create_account( N(alice) );
+   vector<block_id_type> ids;
+   for( int i = 0; i < 30; ++i )
+      ids.push_back( chain.produce_block()->id() );
+   const auto lib = chain.control->last_irreversible_block_num();
+   BOOST_REQUIRE( lib > block_header::num_from_id( ids.front() ) && lib < block_header::num_from_id( ids.back() ) );
+
+   for( const auto& id : ids ) {
+      auto h = chain.control->fetch_block_header_by_id( id );
+      BOOST_REQUIRE( h );
+      BOOST_CHECK_EQUAL( h->id(), id );
+      BOOST_CHECK_EQUAL( h->id(), chain.control->fetch_block_by_id( id )->id() );
+   }
+
+   // an id of another block with the number of a block in the log is not found
+   auto other = ids.front();
+   other._hash[3] ^= 1;
+   BOOST_CHECK( !chain.control->fetch_block_header_by_id( other ) );
+   BOOST_CHECK( !chain.control->fetch_block_header_by_id( block_id_type() ) );
+
+   auto blocks_dir = chain.get_config().blocks_dir;
+   chain.close();
+   block_log blog( blocks_dir );
+   BOOST_CHECK( !blog.read_block_header_by_num( lib + 1 ) );
+   for( const auto& id : ids ) {
+      if( block_header::num_from_id( id ) <= lib )
+         BOOST_CHECK_EQUAL( blog.read_block_header_by_num( block_header::num_from_id( id ) )->id(), id );
+   }
+}
+
+// the block log is split every stride blocks, old segments are archived and all retained blocks stay readable
+BOOST_AUTO_TEST_CASE(block_log_split_test)
+{
+   fc::temp_directory tempdir;
+   auto cfg = tester::default_config( tempdir );
+   cfg.block_log_stride = 10;
+   cfg.max_retained_block_files = 2;
+   cfg.blocks_retained_dir = "retained";
+   cfg.blocks_archive_dir = "archive";
+   tester chain( cfg, true );
+
+   while( chain.control->last_irreversible_block_num() < 55 )
+      chain.produce_block();
+   const auto lib = chain.control->last_irreversible_block_num();
+
+   const auto retained = cfg.blocks_dir / "retained";
+   const auto archive = cfg.blocks_dir / "archive";
+   BOOST_CHECK( fc::exists( retained / "blocks-31-40.log" ) && fc::exists( retained / "blocks-31-40.index" ) );
+   BOOST_CHECK( fc::exists( retained / "blocks-41-50.log" ) && fc::exists( retained / "blocks-41-50.index" ) );
+   for( auto name : { "blocks-1-10", "blocks-11-20", "blocks-21-30" } ) {
+      BOOST_CHECK( !fc::exists( retained / (std::string(name) + ".log") ) );
+      BOOST_CHECK( fc::exists( archive / (std::string(name) + ".log") ) );
+   }
+
+   vector<block_id_type> ids;
+   for( uint32_t n = 31; n <= lib; ++n ) {
+      auto b = chain.control->fetch_block_by_number( n );
+      BOOST_REQUIRE( b );
+      ids.push_back( b->id() );
+   }
+   BOOST_CHECK( !chain.control->fetch_block_by_number( 30 ) );
+   chain.close();
+
+   // a lost index of a retained segment is rebuilt on open, files whose names are no block range are skipped
+   fc::remove_all( retained / "blocks-31-40.index" );
+   const std::vector<std::string> junk = { "blocks-abc-40.log", "blocks-31-4x.log", "blocks-31.log", "blocks-0-5.log",
+                                           "blocks-40-31.log", "blocks-99999999999-99999999999.log" };
+   for( const auto& name : junk ) {
+      std::ofstream out( (retained / name).generic_string() );
+      out << "not a block log";
+   }
+   block_log_config log_cfg;
+   log_cfg.stride = 10;
+   {
+      block_log blog( cfg.blocks_dir, log_cfg );
+      BOOST_CHECK_EQUAL( blog.first_block_num(), 31 );
+      BOOST_CHECK_EQUAL( blog.read_head()->block_num(), lib );
+      for( const auto& id : ids )
+         BOOST_CHECK_EQUAL( blog.read_block_by_id( id )->id(), id );
+   }
+   for( const auto& name : junk ) {
+      BOOST_CHECK( fc::exists( retained / name ) );
+      fc::remove( retained / name );
+   }
+
+   // repairing the log rebuilds blocks.log next to the split segments instead of backing them up with it
+   block_log::repair_log( cfg.blocks_dir, 0, cfg.blocks_retained_dir, cfg.blocks_archive_dir );
+   BOOST_CHECK( fc::exists( archive / "blocks-1-10.log" ) );
+   block_log repaired( cfg.blocks_dir, log_cfg );
+   BOOST_CHECK_EQUAL( repaired.first_block_num(), 31 );
+   BOOST_CHECK_EQUAL( repaired.read_head()->block_num(), lib );
+   for( const auto& id : ids )
+      BOOST_CHECK_EQUAL( repaired.read_block_by_id( id )->id(), id );
+}
+
+BOOST_AUTO_TEST_CASE(block_log_compression_test)
+{
+   fc::temp_directory tempdir;
+   auto cfg = tester::default_config( tempdir );
+   cfg.compress_block_log = true;
+   tester chain( cfg, true );
+
+   chain.create_account( N(alice) );
+   while( chain.control->last_irreversible_block_num() < 20 )
+      chain.produce_block();
+   const auto lib = chain.control->last_irreversible_block_num();
+
+   vector<block_id_type> ids;
+   for( uint32_t n = 1; n <= lib; ++n )
+      ids.push_back( chain.control->fetch_block_by_number( n )->id() );
+   chain.close();
+
+   {
+      std::ifstream log( (cfg.blocks_dir / "blocks.log").generic_string(), std::ios::binary );
+      uint32_t version = 0;
+      log.read( (char*)&version, sizeof(version) );
+      BOOST_CHECK_EQUAL( version, 3 );
+   }
+
+   // the index of a compressed log is rebuilt from the sizes of the entries
+   fc::remove_all( cfg.blocks_dir / "blocks.index" );
+   block_log blog( cfg.blocks_dir );
+   BOOST_CHECK_EQUAL( blog.read_head()->block_num(), lib );
+   for( uint32_t n = lib; n >= 1; --n ) {
+      BOOST_REQUIRE( blog.get_block_pos( n ) != block_log::npos );
+      BOOST_CHECK_EQUAL( blog.read_block_by_num( n )->id(), ids[n - 1] );
+      auto h = blog.read_block_header_by_num( n );
+      BOOST_REQUIRE( h );
+      BOOST_CHECK_EQUAL( h->id(), ids[n - 1] );
+   }
+}
+
+BOOST_AUTO_TEST_CASE(block_log_rebuild_index_test)
+{
+   tester chain;
+   chain.create_account( N(alice) );
+   while( chain.control->last_irreversible_block_num() < 30 )
+      chain.produce_block();
+   auto cfg = chain.get_config();
+   chain.close();
+
+   auto read_file = []( const fc::path& p ) {
+      std::ifstream f( p.generic_string(), std::ios::binary );
+      return std::string( std::istreambuf_iterator<char>( f ), std::istreambuf_iterator<char>() );
+   };
+   const auto log_file = cfg.blocks_dir / "blocks.log";
+   const auto index_file = cfg.blocks_dir / "blocks.index";
+   const auto expected = read_file( index_file );
+   BOOST_REQUIRE( !expected.empty() );
+
+   for( uint32_t threads : { 1, 3, 64 } ) {
+      fc::remove_all( index_file );
+      block_log::construct_index( log_file, index_file, threads );
+      BOOST_CHECK( read_file( index_file ) == expected );
+   }
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -222,6 +222,172 @@ static const char mutable_global_wast[] = R"=====(
 )
 )=====";
 
+static const char instance_reset_wast[] = R"=====(
+(module
+ (import "env" "require_auth" (func $require_auth (param i64)))
+ (import "env" "eosio_assert" (func $eosio_assert (param i32 i32)))
+ (import "env" "db_store_i64" (func $db_store_i64 (param i64 i64 i64 i64 i32 i32) (result i32)))
+ (import "env" "db_lowerbound_i64" (func $db_lowerbound_i64 (param i64 i64 i64 i64) (result i32)))
+ (type $SIG$j (func (result i64)))
+ (table 1 anyfunc)
+ (elem (i32.const 0) $get_g0)
+ (memory $0 1)
+ (export "memory" (memory $0))
+ (export "apply" (func $apply))
+ (func $get_g0 (type $SIG$j) (result i64)
+  (get_global $g0)
+ )
+ (func $apply (param $0 i64) (param $1 i64) (param $2 i64)
+  (call $require_auth (get_local $0))
+  (if (i64.eq (get_local $2) (i64.const 0)) (then
+    (set_global $g0 (i64.const 444))
+    (i64.store (i32.const 8) (i64.const 444))
+    (drop (call $db_store_i64 (get_local $0) (i64.const 1) (get_local $0) (i64.const 1) (i32.const 8) (i32.const 8)))
+    (return)
+  ))
+  (if (i64.eq (get_local $2) (i64.const 1)) (then
+    (call $eosio_assert (i64.eq (call_indirect (type $SIG$j) (i32.const 0)) (i64.const 2)) (i32.const 0))
+    (call $eosio_assert (i64.eq (i64.load (i32.const 8)) (i64.const 0)) (i32.const 0))
+    (return)
+  ))
+  (if (i64.eq (get_local $2) (i64.const 2)) (then
+    (call $eosio_assert (i32.lt_s (call $db_lowerbound_i64 (get_local $0) (get_local $0) (i64.const 1) (i64.const 0)) (i32.const 0)) (i32.const 0))
+    (return)
+  ))
+  (call $eosio_assert (i32.const 0) (i32.const 0))
+ )
+ (global $g0 (mut i64) (i64.const 2))
+)
+)=====";
+
+static const char memory_image_wast[] = R"=====(
+(module
+ (import "env" "eosio_assert" (func $eosio_assert (param i32 i32)))
+ (memory $0 1)
+ (data (i32.const 16) "\01\02\03\04\05\06\07\08")
+ (export "memory" (memory $0))
+ (export "apply" (func $apply))
+ (func $or_range (param $p i32) (param $end i32) (result i64)
+  (local $acc i64)
+  (loop $scan
+   (set_local $acc (i64.or (get_local $acc) (i64.load (get_local $p))))
+   (set_local $p (i32.add (get_local $p) (i32.const 8)))
+   (br_if $scan (i32.lt_u (get_local $p) (get_local $end)))
+  )
+  (get_local $acc)
+ )
+ (func $apply (param $0 i64) (param $1 i64) (param $2 i64)
+  (if (i64.eq (get_local $2) (i64.const 0)) (then
+   (i64.store (i32.const 16) (i64.const -1))
+   (i64.store (i32.const 32768) (i64.const -1))
+   (call $eosio_assert (i32.eq (grow_memory (i32.const 1)) (i32.const 1)) (i32.const 0))
+   (i64.store (i32.const 65544) (i64.const -1))
+   (return)
+  ))
+  (call $eosio_assert (i32.eq (current_memory) (i32.const 1)) (i32.const 0))
+  (call $eosio_assert (i64.eq (i64.load (i32.const 16)) (i64.const 578437695752307201)) (i32.const 0))
+  (call $eosio_assert (i64.eqz (call $or_range (i32.const 0) (i32.const 16))) (i32.const 0))
+  (call $eosio_assert (i64.eqz (call $or_range (i32.const 24) (i32.const 65536))) (i32.const 0))
+ )
+)
+)=====";
+
+static const char memory_image_other_wast[] = R"=====(
+(module
+ (import "env" "eosio_assert" (func $eosio_assert (param i32 i32)))
+ (memory $0 1)
+ (data (i32.const 8) "B")
+ (export "memory" (memory $0))
+ (export "apply" (func $apply))
+ (func $or_range (param $p i32) (param $end i32) (result i64)
+  (local $acc i64)
+  (loop $scan
+   (set_local $acc (i64.or (get_local $acc) (i64.load (get_local $p))))
+   (set_local $p (i32.add (get_local $p) (i32.const 8)))
+   (br_if $scan (i32.lt_u (get_local $p) (get_local $end)))
+  )
+  (get_local $acc)
+ )
+ (func $apply (param $0 i64) (param $1 i64) (param $2 i64)
+  (call $eosio_assert (i64.eq (i64.load (i32.const 8)) (i64.const 66)) (i32.const 0))
+  (call $eosio_assert (i64.eqz (i64.load (i32.const 0))) (i32.const 0))
+  (call $eosio_assert (i64.eqz (call $or_range (i32.const 16) (i32.const 65536))) (i32.const 0))
+ )
+)
+)=====";
+
+static const char memory_image_none_wast[] = R"=====(
+(module
+ (import "env" "eosio_assert" (func $eosio_assert (param i32 i32)))
+ (memory $0 0)
+ (export "memory" (memory $0))
+ (export "apply" (func $apply))
+ (func $or_range (param $p i32) (param $end i32) (result i64)
+  (local $acc i64)
+  (loop $scan
+   (set_local $acc (i64.or (get_local $acc) (i64.load (get_local $p))))
+   (set_local $p (i32.add (get_local $p) (i32.const 8)))
+   (br_if $scan (i32.lt_u (get_local $p) (get_local $end)))
+  )
+  (get_local $acc)
+ )
+ (func $apply (param $0 i64) (param $1 i64) (param $2 i64)
+  (call $eosio_assert (i32.eqz (grow_memory (i32.const 1))) (i32.const 0))
+  (call $eosio_assert (i64.eqz (call $or_range (i32.const 0) (i32.const 65536))) (i32.const 0))
+  (i64.store (i32.const 16) (i64.const -1))
+  (i64.store (i32.const 32768) (i64.const -1))
+ )
+)
+)=====";
+
+static const char float_bits_wast[] = R"=====(
+(module
+ (import "env" "printi" (func $printi (param i64)))
+ (import "env" "prints_l" (func $prints_l (param i32 i32)))
+ (memory $0 1)
+ (data (i32.const 0) " ")
+ (export "memory" (memory $0))
+ (export "apply" (func $apply))
+ (func $p32 (param $0 f32)
+  (call $printi (i64.extend_u/i32 (i32.reinterpret/f32 (get_local $0))))
+  (call $prints_l (i32.const 0) (i32.const 1))
+ )
+ (func $p64 (param $0 f64)
+  (call $printi (i64.reinterpret/f64 (get_local $0)))
+  (call $prints_l (i32.const 0) (i32.const 1))
+ )
+ (func $apply (param $0 i64) (param $1 i64) (param $2 i64)
+  (local $snan32 f32) (local $qnan32 f32) (local $snan64 f64) (local $qnan64 f64)
+  (set_local $snan32 (f32.reinterpret/i32 (i32.const 2141192192)))
+  (set_local $qnan32 (f32.reinterpret/i32 (i32.const -4194048)))
+  (set_local $snan64 (f64.reinterpret/i64 (i64.const 9219994337134247936)))
+  (set_local $qnan64 (f64.reinterpret/i64 (i64.const -2251799813684992)))
+  (call $p32 (f32.add (f32.const 1.5) (f32.const 2.25)))
+  (call $p32 (f32.div (f32.const 1) (f32.const 3)))
+  (call $p32 (f32.div (f32.const 0) (f32.const 0)))
+  (call $p32 (f32.sub (f32.const inf) (f32.const inf)))
+  (call $p32 (f32.mul (f32.const 0) (f32.const -inf)))
+  (call $p32 (f32.add (get_local $snan32) (f32.const 1)))
+  (call $p32 (f32.sub (f32.const 1) (get_local $qnan32)))
+  (call $p32 (f32.mul (get_local $qnan32) (get_local $snan32)))
+  (call $p32 (f32.div (get_local $snan32) (get_local $qnan32)))
+  (call $p32 (f32.sqrt (f32.const -1)))
+  (call $p32 (f32.sqrt (get_local $qnan32)))
+  (call $p64 (f64.add (f64.const 1.5) (f64.const 2.25)))
+  (call $p64 (f64.div (f64.const 1) (f64.const 3)))
+  (call $p64 (f64.div (f64.const 0) (f64.const 0)))
+  (call $p64 (f64.sub (f64.const inf) (f64.const inf)))
+  (call $p64 (f64.mul (f64.const 0) (f64.const -inf)))
+  (call $p64 (f64.add (get_local $snan64) (f64.const 1)))
+  (call $p64 (f64.sub (f64.const 1) (get_local $qnan64)))
+  (call $p64 (f64.mul (get_local $qnan64) (get_local $snan64)))
+  (call $p64 (f64.div (get_local $snan64) (get_local $qnan64)))
+  (call $p64 (f64.sqrt (f64.const -1)))
+  (call $p64 (f64.sqrt (get_local $qnan64)))
+ )
+)
+)=====";
+
 static const char biggest_memory_wast[] = R"=====(
 (module
  (import "env" "eosio_assert" (func $$eosio_assert (param i32 i32)))
@@ -6,6 +6,9 @@
 #include <eosio/testing/tester.hpp>
 #include <eosio/chain/abi_serializer.hpp>
 #include <eosio/chain/generated_transaction_object.hpp>
+#include <eosio/chain/contract_table_objects.hpp>
+#include <eosio/chain/resource_limits.hpp>
+#include <eosio/chain/wast_to_wasm.hpp>
 
 #include <eosio.token/eosio.token.wast.hpp>
 #include <eosio.token/eosio.token.abi.hpp>
@@ -598,4 +601,125 @@ BOOST_FIXTURE_TEST_CASE( test_input_quantity, currency_tester ) try {
 
 } FC_LOG_AND_RETHROW() /// test_currency
 
+// transfers applied natively must produce the same blocks, state and failures as the WASM contract
+BOOST_AUTO_TEST_CASE( native_token_transfer_equivalence ) try {
+   tester wasm_chain;
+   fc::temp_directory tempdir;
+   auto cfg = tester::default_config( tempdir );
+   auto token_wasm = wast_to_wasm( eosio_token_wast );
+   cfg.native_token_code_hashes.insert( fc::sha256::hash( (const char*)token_wasm.data(), token_wasm.size() ) );
+   tester native_chain( cfg, true );
+   BOOST_REQUIRE( native_chain.is_same_chain( wasm_chain ) );
+
+   abi_serializer abi_ser( json::from_string(eosio_token_abi).as<abi_def>(), base_tester::abi_serializer_max_time );
+   vector<tester*> chains = { &wasm_chain, &native_chain };
+
+   // the tester bills a fixed cpu time, so equal receipts and state changes produce equal block ids
+   auto produce_block = [&]() {
+      for( auto c : chains )
+         c->produce_block();
+      BOOST_REQUIRE( native_chain.is_same_chain( wasm_chain ) );
+   };
+
+   // pushes the same signed transaction to both chains and requires the same outcome
+   auto push = [&]( const account_name& signer, const action_name& name, const variant_object& data,
+                    const account_name& actor ) {
+      action act;
+      act.account = N(eosio.token);
+      act.name = name;
+      act.authorization = vector<permission_level>{{actor, config::active_name}};
+      act.data = abi_ser.variant_to_binary( abi_ser.get_action_type(name), data, base_tester::abi_serializer_max_time );
+
+      signed_transaction trx;
+      trx.actions.emplace_back( std::move(act) );
+      wasm_chain.set_transaction_headers( trx );
+      trx.sign( wasm_chain.get_private_key( signer, "active" ), wasm_chain.control->get_chain_id() );
+
+      vector<optional<fc::exception>> outcomes;
+      for( auto c : chains ) {
+         try {
+            c->push_transaction( trx );
+            outcomes.emplace_back();
+         } catch( const fc::exception& e ) {
+            outcomes.emplace_back( e );
+         }
+      }
+      BOOST_REQUIRE_EQUAL( bool(outcomes[0]), bool(outcomes[1]) );
+      if( outcomes[0] ) {
+         BOOST_CHECK_EQUAL( outcomes[0]->code(), outcomes[1]->code() );
+         BOOST_CHECK_EQUAL( outcomes[0]->top_message(), outcomes[1]->top_message() );
+      }
+      return !outcomes[0];
+   };
+
+   auto transfer = [&]( const account_name& from, const account_name& to, const string& quantity,
+                        const string& memo = "", optional<account_name> actor = optional<account_name>() ) {
+      return push( actor ? *actor : from, N(transfer), mutable_variant_object()
+                   ("from", from)("to", to)("quantity", quantity)("memo", memo), actor ? *actor : from );
+   };
+
+   auto token_state = []( tester& c ) {
+      const auto& db = c.control->db();
+      vector<string> rows;
+      for( const auto& obj : db.get_index<key_value_index, by_id>() ) {
+         const auto& t = db.get<table_id_object>( obj.t_id );
+         rows.emplace_back( fc::json::to_string( fc::mutable_variant_object()
+            ("code", t.code)("scope", t.scope)("table", t.table)("count", t.count)("primary_key", obj.primary_key)
+            ("payer", obj.payer)("value", fc::to_hex( obj.value.data(), obj.value.size() )) ) );
+      }
+      for( auto a : { N(eosio.token), N(alice), N(bob), N(carol) } )
+         rows.emplace_back( std::to_string( c.control->get_resource_limits_manager().get_account_ram_usage( a ) ) );
+      return rows;
+   };
+
+   for( auto c : chains ) {
+      c->create_accounts( {N(eosio.token), N(alice), N(bob), N(carol)} );
+      c->set_code( N(eosio.token), eosio_token_wast );
+      c->set_abi( N(eosio.token), eosio_token_abi );
+   }
+   produce_block();
+
+   BOOST_REQUIRE( push( N(eosio.token), N(create), mutable_variant_object()
+                        ("issuer", "eosio.token")("maximum_supply", "1000000.0000 CUR"), N(eosio.token) ) );
+   BOOST_REQUIRE( push( N(eosio.token), N(issue), mutable_variant_object()
+                        ("to", "eosio.token")("quantity", "1000.0000 CUR")("memo", ""), N(eosio.token) ) );
+   // the issue to alice sends an inline transfer from the issuer
+   BOOST_REQUIRE( push( N(eosio.token), N(issue), mutable_variant_object()
+                        ("to", "alice")("quantity", "100.0000 CUR")("memo", "issue"), N(eosio.token) ) );
+   produce_block();
+
+   // every apply of a contract is either a hit or a miss of the instantiation cache
+   auto wasm_runs = []( tester& c ) {
+      auto stats = c.control->get_wasm_interface().get_cache_stats();
+      return stats.hits + stats.misses;
+   };
+   auto wasm_runs_before = wasm_runs( wasm_chain );
+   auto native_runs_before = wasm_runs( native_chain );
+
+   BOOST_REQUIRE( transfer( N(alice), N(bob), "10.0000 CUR", "new balance paid by alice" ) );
+   BOOST_REQUIRE( transfer( N(alice), N(bob), "5.0000 CUR", "existing balance" ) );
+   produce_block();
+   BOOST_REQUIRE( transfer( N(bob), N(carol), "15.0000 CUR", "bob's balance is erased" ) );
+   BOOST_REQUIRE( transfer( N(carol), N(alice), "1.0000 CUR" ) );
+   produce_block();
+   BOOST_CHECK( token_state( native_chain ) == token_state( wasm_chain ) );
+
+   // none of the four successful transfers ran the contract on the native chain, onblock runs on both
+   BOOST_CHECK_EQUAL( wasm_runs( wasm_chain ) - wasm_runs_before, wasm_runs( native_chain ) - native_runs_before + 4 );
+
+   // failing transfers fall back to the contract and report identical errors
+   BOOST_CHECK( !transfer( N(alice), N(bob), "1000.0000 CUR", "overdrawn" ) );
+   BOOST_CHECK( !transfer( N(alice), N(nobody), "1.0000 CUR", "unknown account" ) );
+   BOOST_CHECK( !transfer( N(alice), N(bob), "1.000 CUR", "precision mismatch" ) );
+   BOOST_CHECK( !transfer( N(alice), N(bob), "1.0000 USD", "unknown symbol" ) );
+   BOOST_CHECK( !transfer( N(alice), N(bob), "0.0000 CUR", "zero" ) );
+   BOOST_CHECK( !transfer( N(alice), N(bob), "-1.0000 CUR", "negative" ) );
+   BOOST_CHECK( !transfer( N(alice), N(alice), "1.0000 CUR", "self" ) );
+   BOOST_CHECK( !transfer( N(alice), N(bob), "1.0000 CUR", string(257, 'm') ) );
+   BOOST_CHECK( !transfer( N(bob), N(carol), "1.0000 CUR", "no balance" ) );
+   BOOST_CHECK( !transfer( N(carol), N(bob), "1.0000 CUR", "authorized by another account", N(alice) ) );
+   produce_block();
+   BOOST_CHECK( token_state( native_chain ) == token_state( wasm_chain ) );
+} FC_LOG_AND_RETHROW()
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -67,7 +67,7 @@ BOOST_AUTO_TEST_SUITE(database_tests)
 
          // Utility function to check expected irreversible block
          auto calc_exp_last_irr_block_num = [&](uint32_t head_block_num) -> uint32_t {
-            const auto producers_size = test.control->head_block_state()->active_schedule.producers.size();
+            const auto producers_size = test.control->head_block_state()->active_schedule->producers.size();
             const auto max_reversible_rounds = EOS_PERCENT(producers_size, config::percent_100 - config::irreversible_threshold_percent);
             if( max_reversible_rounds == 0) {
                return head_block_num;
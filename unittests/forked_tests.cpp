@@ -10,6 +10,8 @@
 
 #include <fc/variant_object.hpp>
 
+#include <fstream>
+
 using namespace eosio::chain;
 using namespace eosio::testing;
 
@@ -374,4 +376,119 @@ BOOST_AUTO_TEST_CASE( read_modes ) try {
 
 } FC_LOG_AND_RETHROW()
 
+BOOST_AUTO_TEST_CASE( fork_database_journal ) try {
+   tester c;
+   c.create_accounts( {N(dan),N(sam)} );
+   c.set_producers( {N(dan),N(sam)} );
+   c.produce_blocks( 30 );
+   const auto head_id = c.control->fork_db_head_block_id();
+   const auto lib = c.control->last_irreversible_block_num();
+   BOOST_REQUIRE( c.control->fork_db_head_block_num() > lib + 1 );
+
+   const auto state_dir = c.get_config().state_dir;
+   const auto journal_file = c.get_config().blocks_dir / config::forkdb_journal_filename;
+   c.close();
+   BOOST_CHECK( !fc::exists( state_dir / config::forkdb_filename ) );
+   BOOST_CHECK( !fc::exists( state_dir / config::forkdb_journal_filename ) );
+   BOOST_REQUIRE( fc::exists( journal_file ) );
+
+   // a record cut off by a crash is discarded
+   const auto journal_size = fc::file_size( journal_file );
+   {
+      std::ofstream journal( journal_file.generic_string(), std::ios::binary | std::ios::app );
+      const uint32_t size = 1000;
+      journal.write( (const char*)&size, sizeof(size) );
+      journal.write( "\0\0", 2 );
+   }
+   {
+      fork_database fork_db( state_dir, journal_file.parent_path() );
+      BOOST_REQUIRE( fork_db.head() );
+      BOOST_CHECK_EQUAL( fork_db.head()->id, head_id );
+      for( uint32_t n = lib + 1; n <= fork_db.head()->block_num; ++n )
+         BOOST_CHECK( fork_db.get_block_in_current_chain_by_num( n ) );
+   }
+   BOOST_CHECK_EQUAL( fc::file_size( journal_file ), journal_size );
+
+   // a damaged record followed by more data is not a cut off end, so it fails instead of dropping the rest
+   {
+      std::ofstream journal( journal_file.generic_string(), std::ios::binary | std::ios::app );
+      const uint32_t size = 1;
+      journal.write( (const char*)&size, sizeof(size) );
+      journal.write( "\xff", 1 );
+      journal.write( (const char*)&size, sizeof(size) );
+   }
+   BOOST_CHECK_THROW( fork_database fork_db( state_dir, journal_file.parent_path() ), fork_database_exception );
+   boost::filesystem::resize_file( journal_file.generic_string(), journal_size );
+
+   c.open( nullptr );
+   BOOST_CHECK_EQUAL( c.control->fork_db_head_block_id(), head_id );
+   c.produce_blocks( 2 );
+   BOOST_CHECK_EQUAL( c.control->fork_db_head_block_num(), block_header::num_from_id( head_id ) + 2 );
+
+} FC_LOG_AND_RETHROW()
+
+BOOST_AUTO_TEST_CASE( fork_database_journal_torn_record ) try {
+   tester c;
+   c.create_accounts( {N(dan),N(sam)} );
+   c.set_producers( {N(dan),N(sam)} );
+   c.produce_blocks( 30 );
+   const auto lib = c.control->last_irreversible_block_num();
+   const auto head_num = c.control->fork_db_head_block_num();
+
+   const auto state_dir = c.get_config().state_dir;
+   const auto journal_file = c.get_config().blocks_dir / config::forkdb_journal_filename;
+   c.close();
+
+   // tear the last record of the journal as a crash in the middle of its write would
+   string content;
+   fc::read_file_contents( journal_file, content );
+   uint64_t last_record = 0;
+   for( uint64_t pos = 0; pos < content.size(); ) {
+      uint32_t size = 0;
+      memcpy( &size, content.data() + pos, sizeof(size) );
+      last_record = pos;
+      pos += sizeof(size) + size;
+      BOOST_REQUIRE( pos <= content.size() );
+   }
+   BOOST_REQUIRE( last_record > 0 );
+   const uint32_t last_size = content.size() - last_record;
+   boost::filesystem::resize_file( journal_file.generic_string(), last_record + last_size / 2 );
+
+   {
+      fork_database fork_db( state_dir, journal_file.parent_path() );
+      BOOST_REQUIRE( fork_db.head() );
+      for( uint32_t n = lib + 1; n < head_num; ++n )
+         BOOST_CHECK( fork_db.get_block_in_current_chain_by_num( n ) );
+   }
+   BOOST_CHECK_EQUAL( fc::file_size( journal_file ), last_record );
+
+   c.open( nullptr );
+   BOOST_CHECK( c.control->fork_db_head_block_num() >= head_num - 1 );
+   c.produce_blocks( 2 );
+
+} FC_LOG_AND_RETHROW()
+
+BOOST_AUTO_TEST_CASE( fork_database_journal_outlives_state ) try {
+   tester c;
+   c.create_accounts( {N(dan),N(sam)} );
+   c.set_producers( {N(dan),N(sam)} );
+   c.produce_blocks( 30 );
+   const auto head_id = c.control->fork_db_head_block_id();
+
+   const auto state_dir = c.get_config().state_dir;
+   const auto journal_file = c.get_config().blocks_dir / config::forkdb_journal_filename;
+   c.close();
+
+   // a replay clears the state directory, the journal in the blocks directory is kept and rebuilt from the blocks
+   fc::remove_all( state_dir );
+   BOOST_REQUIRE( fc::exists( journal_file ) );
+
+   c.open( nullptr );
+   BOOST_CHECK_EQUAL( c.control->head_block_id(), head_id );
+   BOOST_CHECK_EQUAL( c.control->fork_db_head_block_id(), head_id );
+   c.produce_blocks( 2 );
+   BOOST_CHECK_EQUAL( c.control->fork_db_head_block_num(), block_header::num_from_id( head_id ) + 2 );
+
+} FC_LOG_AND_RETHROW()
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -7,6 +7,8 @@
 #include <eosio/chain/authority.hpp>
 #include <eosio/chain/types.hpp>
 #include <eosio/chain/asset.hpp>
+#include <eosio/chain/open_address_map.hpp>
+#include <eosio/chain/access_set.hpp>
 #include <eosio/testing/tester.hpp>
 
 #include <fc/io/json.hpp>
@@ -606,6 +608,91 @@ BOOST_AUTO_TEST_CASE(transaction_test) { try {
 
 } FC_LOG_AND_RETHROW() }
 
+// the map of the iterator caches agrees with std::map through growth, collisions, erasures and reuse after clear
+BOOST_AUTO_TEST_CASE(open_address_map_test) { try {
+   boost::random::mt19937 gen;
+   // few distinct keys, spaced like object addresses, so probe runs are long and erasures shift entries back
+   boost::random::uniform_int_distribution<uint64_t> key_dist( 0, 300 );
+   boost::random::uniform_int_distribution<int> op_dist( 0, 2 );
+
+   open_address_map<int> m;
+   std::map<uint64_t, int> expected;
+   for( int round = 0; round < 3; ++round ) {
+      for( int i = 0; i < 20000; ++i ) {
+         uint64_t key = 0x7f0000001000ull + key_dist( gen ) * 64;
+         switch( op_dist( gen ) ) {
+         case 0:
+            if( !expected.count( key ) ) {
+               m.insert( key, i );
+               expected[key] = i;
+            }
+            break;
+         case 1:
+            m.erase( key );
+            expected.erase( key );
+            break;
+         default:
+            break;
+         }
+         auto found = m.find( key );
+         auto itr = expected.find( key );
+         BOOST_REQUIRE_EQUAL( !!found, itr != expected.end() );
+         if( found )
+            BOOST_REQUIRE_EQUAL( *found, itr->second );
+         BOOST_REQUIRE_EQUAL( m.size(), expected.size() );
+      }
+      for( const auto& e : expected ) {
+         BOOST_REQUIRE( m.find( e.first ) );
+         BOOST_CHECK_EQUAL( *m.find( e.first ), e.second );
+      }
+      m.clear();
+      expected.clear();
+      BOOST_CHECK( m.empty() );
+      BOOST_CHECK( !m.find( 0x7f0000001000ull ) );
+   }
+} FC_LOG_AND_RETHROW() }
+
+// transactions conflict when one writes a key range the other accesses, or when both update a resource row
+BOOST_AUTO_TEST_CASE(conflict_graph_test) { try {
+   const auto token = N(eosio.token);
+   const auto primary = table_key_range::primary_index;
+   const auto max_key = table_key_range::max_key;
+   const uint64_t cur = 0x52554300;
+
+   auto transfer = [&]( access_set& s, account_name from, account_name to ) {
+      s.read( token, cur, N(stat), primary, cur, cur );
+      s.write( token, from, N(accounts), primary, cur, cur );
+      s.write( token, to, N(accounts), primary, cur, cur );
+      s.resource_accounts.insert( from );
+   };
+
+   vector<access_set> sets(5);
+   transfer( sets[0], N(alice), N(bob) );
+   transfer( sets[1], N(carol), N(dave) );
+   transfer( sets[2], N(alice), N(carol) );
+   // a scan through the balances of bob, one lookup after another
+   sets[3].read( token, N(bob), N(accounts), primary, 0, 5 );
+   sets[3].read( token, N(bob), N(accounts), primary, 6, cur );
+   sets[3].read( token, N(bob), N(accounts), primary, cur, max_key );
+   sets[4].resource_accounts.insert( N(alice) );
+
+   BOOST_CHECK_EQUAL( sets[3].reads.size(), 1u );
+
+   auto g = conflict_graph::build( 7, sets );
+   BOOST_CHECK_EQUAL( g.block_num, 7u );
+   BOOST_CHECK_EQUAL( g.transactions, 5u );
+   vector<std::pair<uint32_t,uint32_t>> expected = { {0,2}, {0,3}, {0,4}, {1,2}, {2,4} };
+   BOOST_CHECK( g.edges == expected );
+   BOOST_CHECK_EQUAL( g.resource_edges, 2u );
+   BOOST_CHECK_EQUAL( g.critical_path, 3u );
+
+   for( const auto& e : g.edges )
+      BOOST_CHECK( sets[e.first].conflicts_with( sets[e.second] ) );
+   BOOST_CHECK( !sets[0].conflicts_with( sets[1] ) );
+   BOOST_CHECK( !sets[1].conflicts_with( sets[3] ) );
+   BOOST_CHECK( !sets[3].conflicts_with( sets[4] ) );
+} FC_LOG_AND_RETHROW() }
+
 BOOST_AUTO_TEST_SUITE_END()
 
 } // namespace eosio
@@ -35,7 +35,7 @@ BOOST_AUTO_TEST_SUITE(producer_schedule_tests)
    // However, it won't be applied until the effective block num is deemed irreversible
    uint64_t calc_block_num_of_next_round_first_block(const controller& control){
       auto res = control.head_block_num() + 1;
-      const auto blocks_per_round = control.head_block_state()->active_schedule.producers.size() * config::producer_repetitions;
+      const auto blocks_per_round = control.head_block_state()->active_schedule->producers.size() * config::producer_repetitions;
       while((res % blocks_per_round) != 0) {
          res++;
       }
@@ -48,7 +48,7 @@ BOOST_AUTO_TEST_SUITE(producer_schedule_tests)
       const auto& confirm_schedule_correctness = [&](const vector<producer_key>& new_prod_schd, const uint64_t eff_new_prod_schd_block_num)  {
          const uint32_t check_duration = 1000; // number of blocks
          for (uint32_t i = 0; i < check_duration; ++i) {
-            const auto current_schedule = control->head_block_state()->active_schedule.producers;
+            const auto current_schedule = control->head_block_state()->active_schedule->producers;
             const auto& current_absolute_slot = control->get_global_properties().proposed_schedule_block_num;
             // Determine expected producer
             const auto& expected_producer = get_expected_producer(current_schedule, *current_absolute_slot + 1);
@@ -260,6 +260,31 @@ BOOST_FIXTURE_TEST_CASE( producer_schedule_promotion_test, TESTER ) try {
    BOOST_REQUIRE_EQUAL( validate(), true );
 } FC_LOG_AND_RETHROW()
 
+BOOST_FIXTURE_TEST_CASE( producer_schedule_shared_between_states, tester ) try {
+   create_accounts( {N(alice),N(bob)} );
+   set_producers( {N(alice),N(bob)} );
+   while( control->head_block_state()->active_schedule->version == 0 )
+      produce_block();
+   produce_blocks( 3 );
+
+   const auto head = control->head_block_state();
+   const auto prev = control->fetch_block_state_by_id( head->header.previous );
+   BOOST_REQUIRE( prev );
+   BOOST_CHECK( head->active_schedule.shares( prev->active_schedule ) );
+   BOOST_CHECK( head->pending_schedule.shares( prev->pending_schedule ) );
+   // a promoted pending schedule keeps its version without producers
+   BOOST_CHECK_EQUAL( head->pending_schedule->version, 1 );
+   BOOST_CHECK( head->pending_schedule->producers.empty() );
+
+   // equal schedules are interned, also when unpacked
+   producer_schedule_type copy = *head->active_schedule;
+   BOOST_CHECK( producer_schedule_ref( copy ).shares( head->active_schedule ) );
+   auto unpacked = fc::raw::unpack<block_header_state>( fc::raw::pack( static_cast<const block_header_state&>( *head ) ) );
+   BOOST_CHECK_EQUAL( unpacked.id, head->id );
+   BOOST_CHECK( unpacked.active_schedule.shares( head->active_schedule ) );
+   BOOST_CHECK( *unpacked.active_schedule == *head->active_schedule );
+} FC_LOG_AND_RETHROW()
+
 BOOST_FIXTURE_TEST_CASE( producer_schedule_reduction, tester ) try {
    create_accounts( {N(alice),N(bob),N(carol)} );
    produce_block();
@@ -7,6 +7,9 @@
 #include <eosio/chain/resource_limits.hpp>
 #include <eosio/chain/exceptions.hpp>
 #include <eosio/chain/wast_to_wasm.hpp>
+#include <eosio/chain/wasm_hard_float.hpp>
+#include <eosio/chain/wasm_code_cache.hpp>
+#include <softfloat.hpp>
 #include <asserter/asserter.wast.hpp>
 #include <asserter/asserter.abi.hpp>
 
@@ -27,6 +30,8 @@
 #include "test_softfloat_wasts.hpp"
 
 #include <array>
+#include <fstream>
+#include <random>
 #include <utility>
 
 #include "incbin.h"
@@ -356,6 +361,131 @@ BOOST_FIXTURE_TEST_CASE( f64_test_cmp, TESTER ) try {
    }
 } FC_LOG_AND_RETHROW()
 
+// the hardware fast path must produce the same bits as softfloat for every non-NaN result
+BOOST_AUTO_TEST_CASE( hard_float_differential ) try {
+   if( !hard_float::supported() ) {
+      BOOST_TEST_MESSAGE( "hardware floating point fast path not supported, skipping" );
+      return;
+   }
+
+   auto bits32 = []( float f ) { uint32_t u; memcpy( &u, &f, sizeof(u) ); return u; };
+   auto bits64 = []( double d ) { uint64_t u; memcpy( &u, &d, sizeof(u) ); return u; };
+   auto as32 = []( uint32_t u ) { float f; memcpy( &f, &u, sizeof(f) ); return f; };
+   auto as64 = []( uint64_t u ) { double d; memcpy( &d, &u, sizeof(d) ); return d; };
+
+   auto check32 = [&]( float hard, float32_t soft ) {
+      if( hard_float::is_nan( hard ) )
+         BOOST_REQUIRE( f32_is_nan( soft ) );
+      else
+         BOOST_REQUIRE_EQUAL( bits32( hard ), soft.v );
+   };
+   auto check64 = [&]( double hard, float64_t soft ) {
+      if( hard_float::is_nan( hard ) )
+         BOOST_REQUIRE( f64_is_nan( soft ) );
+      else
+         BOOST_REQUIRE_EQUAL( bits64( hard ), soft.v );
+   };
+
+   auto diff32 = [&]( float a, float b ) {
+      float32_t sa = to_softfloat32( a ), sb = to_softfloat32( b );
+      check32( hard_float::add( a, b ), ::f32_add( sa, sb ) );
+      check32( hard_float::sub( a, b ), ::f32_sub( sa, sb ) );
+      check32( hard_float::mul( a, b ), ::f32_mul( sa, sb ) );
+      check32( hard_float::div( a, b ), ::f32_div( sa, sb ) );
+      check32( hard_float::sqrt( a ), ::f32_sqrt( sa ) );
+   };
+   auto diff64 = [&]( double a, double b ) {
+      float64_t sa = to_softfloat64( a ), sb = to_softfloat64( b );
+      check64( hard_float::add( a, b ), ::f64_add( sa, sb ) );
+      check64( hard_float::sub( a, b ), ::f64_sub( sa, sb ) );
+      check64( hard_float::mul( a, b ), ::f64_mul( sa, sb ) );
+      check64( hard_float::div( a, b ), ::f64_div( sa, sb ) );
+      check64( hard_float::sqrt( a ), ::f64_sqrt( sa ) );
+   };
+
+   // zeros, subnormals, normal boundaries, infinities and NaNs of both signs
+   const std::vector<uint32_t> edges32 = {
+      0x00000000, 0x80000000, 0x00000001, 0x80000001, 0x007FFFFF, 0x807FFFFF, 0x00800000, 0x80800000,
+      0x3F800000, 0xBF800000, 0x3EAAAAAB, 0x7F7FFFFF, 0xFF7FFFFF, 0x7F800000, 0xFF800000,
+      0x7FC00000, 0xFFC00000, 0x7F800001, 0x7FA00000
+   };
+   const std::vector<uint64_t> edges64 = {
+      0x0000000000000000, 0x8000000000000000, 0x0000000000000001, 0x8000000000000001,
+      0x000FFFFFFFFFFFFF, 0x800FFFFFFFFFFFFF, 0x0010000000000000, 0x8010000000000000,
+      0x3FF0000000000000, 0xBFF0000000000000, 0x3FD5555555555555, 0x7FEFFFFFFFFFFFFF, 0xFFEFFFFFFFFFFFFF,
+      0x7FF0000000000000, 0xFFF0000000000000, 0x7FF8000000000000, 0xFFF8000000000000,
+      0x7FF0000000000001, 0x7FF4000000000000
+   };
+   for( auto a : edges32 )
+      for( auto b : edges32 )
+         diff32( as32(a), as32(b) );
+   for( auto a : edges64 )
+      for( auto b : edges64 )
+         diff64( as64(a), as64(b) );
+
+   std::mt19937_64 rng( 0x5eed );
+   for( int i = 0; i < 1000000; ++i ) {
+      uint64_t r = rng();
+      diff32( as32( uint32_t(r) ), as32( uint32_t(r >> 32) ) );
+      diff64( as64( r ), as64( rng() ) );
+   }
+} FC_LOG_AND_RETHROW()
+
+// the softfloat test contracts must pass unchanged with native float injection enabled
+BOOST_AUTO_TEST_CASE( hard_float_wasts ) try {
+   fc::temp_directory tempdir;
+   auto cfg = tester::default_config(tempdir);
+   cfg.wasm_hard_float = true;
+   tester chain(cfg, true);
+
+   chain.produce_blocks(2);
+   chain.create_accounts( {N(f32_tests), N(f64_tests)} );
+   for( const auto& test : { std::make_pair(N(f32_tests), f32_test_wast), std::make_pair(N(f64_tests), f64_test_wast) } ) {
+      chain.set_code(test.first, test.second);
+      chain.produce_block();
+
+      signed_transaction trx;
+      action act;
+      act.account = test.first;
+      act.name = N();
+      act.authorization = vector<permission_level>{{test.first,config::active_name}};
+      trx.actions.push_back(act);
+
+      chain.set_transaction_headers(trx);
+      trx.sign(chain.get_private_key( test.first, "active" ), chain.control->get_chain_id());
+      chain.push_transaction(trx);
+      chain.produce_block();
+      BOOST_REQUIRE_EQUAL(true, chain.chain_has_transaction(trx.id()));
+   }
+} FC_LOG_AND_RETHROW()
+
+// native float injection computes the same bits as the softfloat intrinsics, NaN payloads and signs included
+BOOST_AUTO_TEST_CASE( hard_float_nan_results ) try {
+   auto run = []( bool hard ) {
+      fc::temp_directory tempdir;
+      auto cfg = tester::default_config(tempdir);
+      cfg.wasm_hard_float = hard;
+      tester chain(cfg, true);
+
+      chain.produce_blocks(2);
+      chain.create_accounts( {N(floatbits)} );
+      chain.set_code(N(floatbits), float_bits_wast);
+      chain.produce_block();
+
+      signed_transaction trx;
+      trx.actions.emplace_back( vector<permission_level>{{N(floatbits), config::active_name}}, N(floatbits), N(), bytes() );
+      chain.set_transaction_headers(trx);
+      trx.sign( chain.get_private_key( N(floatbits), "active" ), chain.control->get_chain_id() );
+      auto trace = chain.push_transaction(trx);
+      chain.produce_block();
+      return trace->action_traces.at(0).console;
+   };
+
+   const auto soft = run( false );
+   BOOST_CHECK( !soft.empty() );
+   BOOST_CHECK_EQUAL( run( true ), soft );
+} FC_LOG_AND_RETHROW()
+
 // test softfloat conversion operations
 BOOST_FIXTURE_TEST_CASE( f32_f64_conversion_tests, tester ) try {
    produce_blocks(2);
@@ -689,6 +819,83 @@ BOOST_FIXTURE_TEST_CASE( check_global_reset, TESTER ) try {
    BOOST_CHECK_EQUAL(transaction_receipt::executed, receipt.status);
 } FC_LOG_AND_RETHROW()
 
+// a cached module reused by later actions and by other accounts with the same code starts from a pristine instance
+BOOST_FIXTURE_TEST_CASE( check_instance_reuse_reset, TESTER ) try {
+   produce_blocks(2);
+
+   create_accounts( {N(reusea), N(reuseb)} );
+   produce_block();
+
+   set_code(N(reusea), instance_reset_wast);
+   set_code(N(reuseb), instance_reset_wast);
+   produce_blocks(1);
+   control->get_wasm_interface().wait_for_background_compiles();
+
+   // action 0 sets a global, writes linear memory and stores a row, 1 checks the instance, 2 checks the table is empty
+   auto call = [&]( account_name account, std::initializer_list<uint64_t> action_names ) {
+      signed_transaction trx;
+      for( auto n : action_names )
+         trx.actions.emplace_back( vector<permission_level>{{account, config::active_name}}, account, name(n), bytes() );
+      set_transaction_headers(trx);
+      trx.sign( get_private_key( account, "active" ), control->get_chain_id() );
+      push_transaction( trx );
+   };
+
+   const auto before = control->get_wasm_interface().get_cache_stats();
+   call( N(reusea), {0, 1} );
+   call( N(reusea), {1} );
+   call( N(reuseb), {1, 2} );
+   call( N(reuseb), {0, 1} );
+   call( N(reusea), {1, 1} );
+   BOOST_CHECK_EQUAL( control->get_wasm_interface().get_cache_stats().misses, before.misses );
+
+   // the row written by reusea is still there for reusea itself
+   BOOST_CHECK_THROW( call( N(reusea), {2} ), eosio_assert_message_exception );
+   produce_blocks(1);
+} FC_LOG_AND_RETHROW()
+
+// every action starts from the initial memory of its own module, whichever images and resets came before it
+BOOST_FIXTURE_TEST_CASE( memory_image_reset, TESTER ) try {
+   produce_blocks(2);
+
+   create_accounts( {N(memimage), N(memother), N(memnone)} );
+   produce_block();
+
+   set_code(N(memimage), memory_image_wast);
+   set_code(N(memother), memory_image_other_wast);
+   set_code(N(memnone), memory_image_none_wast);
+   produce_blocks(1);
+
+   // memimage action 0 dirties its data segment and another page and grows memory, any other action checks it is
+   // pristine; the action names of the checks differ so repeated sequences are not rejected as duplicate transactions
+   auto call = [&]( account_name account, std::initializer_list<uint64_t> action_names ) {
+      signed_transaction trx;
+      for( auto n : action_names )
+         trx.actions.emplace_back( vector<permission_level>{{account, config::active_name}}, account, name(n), bytes() );
+      set_transaction_headers(trx);
+      trx.sign( get_private_key( account, "active" ), control->get_chain_id() );
+      push_transaction( trx );
+   };
+
+   // the next action of the same contract sees its data segment and zeroes, within and after the dirtying transaction
+   call( N(memimage), {0, 1} );
+   call( N(memimage), {2} );
+
+   // another contract used after memimage's image was mapped sees none of its bytes, before or after memimage dirtied it
+   call( N(memother), {1} );
+   call( N(memimage), {0} );
+   call( N(memother), {2} );
+   call( N(memimage), {3} );
+
+   // a memory without initial pages is reset without an image, which must not leave memimage's image behind
+   call( N(memimage), {0, 4} );
+   call( N(memnone), {1, 2} );
+   call( N(memimage), {0, 5} );
+   call( N(memnone), {3} );
+   call( N(memimage), {6} );
+   produce_blocks(1);
+} FC_LOG_AND_RETHROW()
+
 BOOST_FIXTURE_TEST_CASE( stl_test, TESTER ) try {
     produce_blocks(2);
 
@@ -1107,6 +1314,295 @@ BOOST_FIXTURE_TEST_CASE(eosio_abi, TESTER) try {
    produce_block();
 } FC_LOG_AND_RETHROW()
 
+// the instantiation cache must evict once its entry budget is exhausted and count hits/misses
+BOOST_AUTO_TEST_CASE( instantiation_cache_eviction ) try {
+   fc::temp_directory tempdir;
+   auto cfg = tester::default_config(tempdir);
+   cfg.wasm_cache_max_entries = 1;
+   tester chain(cfg, true);
+
+   chain.produce_blocks(2);
+   chain.create_accounts( {N(asserter), N(noop)} );
+   chain.set_code(N(asserter), asserter_wast);
+   chain.set_abi(N(asserter), asserter_abi);
+   chain.set_code(N(noop), noop_wast);
+   chain.set_abi(N(noop), noop_abi);
+   chain.produce_block();
+
+   // vary the message so repeated calls are not rejected as duplicate transactions
+   uint32_t calls = 0;
+   auto call_asserter = [&]() {
+      chain.push_action( N(asserter), N(procassert), N(asserter), mutable_variant_object()
+                         ("condition", 1)
+                         ("message", std::to_string(++calls)) );
+   };
+   auto call_noop = [&]() {
+      chain.push_action( N(noop), N(anyaction), N(noop), mutable_variant_object()
+                         ("from", "noop")
+                         ("type", "some type")
+                         ("data", "some data") );
+   };
+
+   auto before = chain.control->get_wasm_interface().get_cache_stats();
+   call_asserter();
+   call_asserter();
+   auto after = chain.control->get_wasm_interface().get_cache_stats();
+   BOOST_CHECK_EQUAL( after.entries, 1 );
+   BOOST_CHECK_GE( after.hits, before.hits + 1 );
+
+   call_noop();
+   after = chain.control->get_wasm_interface().get_cache_stats();
+   BOOST_CHECK_EQUAL( after.entries, 1 );
+   BOOST_CHECK_GE( after.evictions, before.evictions + 1 );
+
+   // evicted module is instantiated again on next use
+   call_asserter();
+   chain.produce_block();
+   after = chain.control->get_wasm_interface().get_cache_stats();
+   BOOST_CHECK_EQUAL( after.entries, 1 );
+   BOOST_CHECK_GE( after.misses, before.misses + 3 );
+} FC_LOG_AND_RETHROW()
+
+// a contract called right after its setcode waits for the background compile and behaves as if it was compiled on the spot
+BOOST_AUTO_TEST_CASE( async_compile_same_block ) try {
+   auto set_and_call = []( bool wait_for_compile ) {
+      fc::temp_directory tempdir;
+      tester chain(tester::default_config(tempdir), true);
+
+      chain.produce_blocks(2);
+      chain.create_accounts( {N(asserter)} );
+      chain.set_abi(N(asserter), asserter_abi);
+      chain.produce_block();
+
+      const auto before = chain.control->get_wasm_interface().get_cache_stats();
+      chain.set_code(N(asserter), asserter_wast);
+      BOOST_CHECK_EQUAL( chain.control->get_wasm_interface().get_cache_stats().async_compiles, before.async_compiles + 1 );
+      if( wait_for_compile ) {
+         chain.produce_block();
+         chain.control->get_wasm_interface().wait_for_background_compiles();
+      }
+
+      auto trace = chain.push_action( N(asserter), N(procassert), N(asserter), mutable_variant_object()
+                                      ("condition", 1)
+                                      ("message", "same block") );
+      BOOST_CHECK_EXCEPTION( chain.push_action( N(asserter), N(procassert), N(asserter), mutable_variant_object()
+                                                ("condition", 0)
+                                                ("message", "async assert") ), eosio_assert_message_exception,
+                             eosio_assert_message_is("async assert") );
+      chain.produce_block();
+      BOOST_REQUIRE( trace->receipt );
+      BOOST_REQUIRE_EQUAL( trace->action_traces.size(), 1 );
+      return std::make_tuple( trace->receipt->status, trace->receipt->net_usage_words.value,
+                              trace->action_traces[0].receipt.act_digest,
+                              chain.control->get_resource_limits_manager().get_account_ram_usage( N(asserter) ) );
+   };
+
+   // cpu is billed by wall clock, the wait for the compile is excluded by pausing the billing timer
+   BOOST_CHECK( set_and_call( false ) == set_and_call( true ) );
+} FC_LOG_AND_RETHROW()
+
+// setting the same code on two accounts before the first compile is used compiles it once
+BOOST_AUTO_TEST_CASE( async_compile_shared_code ) try {
+   fc::temp_directory tempdir;
+   tester chain(tester::default_config(tempdir), true);
+
+   chain.produce_blocks(2);
+   chain.create_accounts( {N(asserter), N(asserter2)} );
+   chain.produce_block();
+
+   const auto before = chain.control->get_wasm_interface().get_cache_stats();
+   chain.set_code(N(asserter), asserter_wast);
+   chain.set_code(N(asserter2), asserter_wast);
+   chain.set_abi(N(asserter), asserter_abi);
+   chain.set_abi(N(asserter2), asserter_abi);
+   chain.produce_block();
+   chain.control->get_wasm_interface().wait_for_background_compiles();
+
+   for( auto account : {N(asserter), N(asserter2)} )
+      chain.push_action( account, N(procassert), account, mutable_variant_object()
+                         ("condition", 1)
+                         ("message", "shared code") );
+   const auto after = chain.control->get_wasm_interface().get_cache_stats();
+   BOOST_CHECK_EQUAL( after.async_compiles, before.async_compiles + 1 );
+   BOOST_CHECK_EQUAL( after.entries, before.entries + 1 );
+   BOOST_CHECK_EQUAL( after.misses, before.misses );
+} FC_LOG_AND_RETHROW()
+
+// code that passes validation but cannot be instantiated fails the transactions that use it, never block production
+BOOST_AUTO_TEST_CASE( async_compile_failure ) try {
+   // the data segment does not fit the zero pages of initial memory, which only instantiation checks
+   static const char* data_without_memory_wast = R"=====(
+(module
+ (memory 0)
+ (data (i32.const 0) "x")
+ (export "apply" (func $apply))
+ (func $apply (param $0 i64) (param $1 i64) (param $2 i64))
+)
+)=====";
+
+   fc::temp_directory tempdir;
+   tester chain(tester::default_config(tempdir), true);
+
+   chain.produce_blocks(2);
+   chain.create_accounts( {N(badinit), N(badinit2)} );
+   chain.produce_block();
+
+   auto call = [&]( account_name account ) {
+      signed_transaction trx;
+      trx.actions.emplace_back( vector<permission_level>{{account, config::active_name}}, account, N(), bytes() );
+      chain.set_transaction_headers(trx);
+      trx.sign( chain.get_private_key( account, "active" ), chain.control->get_chain_id() );
+      chain.push_transaction( trx );
+   };
+
+   // used in the block that set it, before the background compile was harvested
+   chain.set_code(N(badinit), data_without_memory_wast);
+   BOOST_CHECK_THROW( call( N(badinit) ), wasm_execution_error );
+
+   // used after the failed compile was harvested by block production, which does not report it
+   chain.set_code(N(badinit2), data_without_memory_wast);
+   chain.control->get_wasm_interface().wait_for_background_compiles();
+   BOOST_CHECK_NO_THROW( chain.produce_block() );
+   BOOST_CHECK_THROW( call( N(badinit2) ), wasm_execution_error );
+
+   // a failed compile is not cached, every use reports it
+   BOOST_CHECK_THROW( call( N(badinit) ), wasm_execution_error );
+   BOOST_CHECK_NO_THROW( chain.produce_block() );
+} FC_LOG_AND_RETHROW()
+
+// injected code survives a restart in the persistent code cache, damaged or foreign files are never instantiated
+BOOST_AUTO_TEST_CASE( persistent_code_cache ) try {
+   fc::temp_directory tempdir;
+   fc::temp_directory cachedir;
+   auto cfg = tester::default_config(tempdir);
+   cfg.wasm_code_cache_dir = cachedir.path();
+   tester chain(cfg, true);
+
+   chain.produce_blocks(2);
+   chain.create_accounts( {N(asserter)} );
+   chain.set_code(N(asserter), asserter_wast);
+   chain.set_abi(N(asserter), asserter_abi);
+   chain.produce_block();
+
+   uint32_t calls = 0;
+   auto call_asserter = [&]() {
+      chain.push_action( N(asserter), N(procassert), N(asserter), mutable_variant_object()
+                         ("condition", 1)
+                         ("message", std::to_string(++calls)) );
+   };
+   call_asserter();
+   chain.produce_block();
+
+   const auto code_id = chain.control->db().get<account_object,by_name>( N(asserter) ).code_version;
+   const auto suffix = "-" + fc::reflector<wasm_interface::vm_type>::to_string( cfg.wasm_runtime ) + "-v";
+   const auto file = cachedir.path() / (code_id.str() + suffix + std::to_string( wasm_code_cache::version ) + ".wasm");
+   BOOST_REQUIRE( fc::exists( file ) );
+
+   // the produced block starts the next one, so the system contract is instantiated before the call is counted
+   auto restart_and_call = [&]() {
+      chain.close();
+      chain.open( nullptr );
+      chain.produce_block();
+      const auto before = chain.control->get_wasm_interface().get_cache_stats();
+      call_asserter();
+      return chain.control->get_wasm_interface().get_cache_stats().persistent_hits - before.persistent_hits;
+   };
+
+   // a restarted node instantiates the cached module instead of injecting the code again
+   BOOST_CHECK_EQUAL( restart_and_call(), 1 );
+
+   // an entry whose checksum does not match is discarded and written again by the compile that replaces it
+   std::string content;
+   fc::read_file_contents( file, content );
+   content[content.size() / 2] ^= 0x5a;
+   {
+      std::ofstream out( file.generic_string(), std::ios::binary | std::ios::trunc );
+      out.write( content.data(), content.size() );
+   }
+   BOOST_CHECK_EQUAL( restart_and_call(), 0 );
+   BOOST_CHECK_EQUAL( restart_and_call(), 1 );
+
+   // entries of another cache version are never read, the current version is compiled and cached next to them
+   const auto old_file = cachedir.path() / (code_id.str() + suffix + std::to_string( wasm_code_cache::version - 1 ) + ".wasm");
+   fc::rename( file, old_file );
+   BOOST_CHECK_EQUAL( restart_and_call(), 0 );
+   BOOST_CHECK( fc::exists( old_file ) );
+   BOOST_CHECK( fc::exists( file ) );
+} FC_LOG_AND_RETHROW()
+
+// action profiling aggregates executions per receiver and action, including failed ones
+BOOST_AUTO_TEST_CASE( action_profiler ) try {
+   fc::temp_directory tempdir;
+   auto cfg = tester::default_config(tempdir);
+   cfg.profile_actions = true;
+   tester chain(cfg, true);
+
+   chain.produce_blocks(2);
+   chain.create_accounts( {N(asserter)} );
+   chain.set_code(N(asserter), asserter_wast);
+   chain.set_abi(N(asserter), asserter_abi);
+   chain.produce_block();
+
+   auto profiler = chain.control->get_execution_profiler();
+   BOOST_REQUIRE( profiler != nullptr );
+   profiler->reset();
+
+   chain.push_action( N(asserter), N(procassert), N(asserter), mutable_variant_object()
+                      ("condition", 1)
+                      ("message", "pass") );
+   BOOST_CHECK_THROW( chain.push_action( N(asserter), N(procassert), N(asserter), mutable_variant_object()
+                                         ("condition", 0)
+                                         ("message", "fail") ), eosio_assert_message_exception );
+
+   auto actions = profiler->snapshot();
+   auto itr = std::find_if( actions.begin(), actions.end(), []( const action_profile_entry& e ) {
+      return e.receiver == N(asserter) && e.action == N(procassert);
+   } );
+   BOOST_REQUIRE( itr != actions.end() );
+   BOOST_CHECK_EQUAL( itr->profile.calls, 2 );
+   BOOST_CHECK_EQUAL( itr->profile.failures, 1 );
+   BOOST_CHECK_EQUAL( itr->profile.db_calls, 0 );
+   BOOST_CHECK( itr->profile.billed_cpu <= itr->profile.wall_time );
+   BOOST_CHECK( itr->profile.compile_time <= itr->profile.wall_time );
+
+   profiler->reset();
+   BOOST_CHECK( profiler->snapshot().empty() );
+} FC_LOG_AND_RETHROW()
+
+// a hot contract interpreted by wabt is promoted to wavm in the background and keeps working afterwards
+BOOST_AUTO_TEST_CASE( tiered_promotion ) try {
+   fc::temp_directory tempdir;
+   auto cfg = tester::default_config(tempdir);
+   cfg.wasm_runtime = wasm_interface::vm_type::tiered;
+   cfg.wasm_tier_up_threshold = 2;
+   tester chain(cfg, true);
+
+   chain.produce_blocks(2);
+   chain.create_accounts( {N(asserter)} );
+   chain.set_code(N(asserter), asserter_wast);
+   chain.set_abi(N(asserter), asserter_abi);
+   chain.produce_block();
+
+   auto call_asserter = [&]( int8_t condition, const string& message ) {
+      chain.push_action( N(asserter), N(procassert), N(asserter), mutable_variant_object()
+                         ("condition", condition)
+                         ("message", message) );
+   };
+
+   // the first call instantiates the contract, the following calls count towards the threshold
+   for( uint32_t i = 0; i <= cfg.wasm_tier_up_threshold && chain.control->get_wasm_interface().get_cache_stats().promotions == 0; ++i ) {
+      call_asserter( 1, std::to_string(i) );
+      chain.control->get_wasm_interface().wait_for_background_compiles();
+   }
+   BOOST_REQUIRE_EQUAL( chain.control->get_wasm_interface().get_cache_stats().promotions, 1 );
+
+   call_asserter( 1, "promoted" );
+   BOOST_CHECK_EXCEPTION( call_asserter( 0, "tiered assert" ), eosio_assert_message_exception,
+                          eosio_assert_message_is("tiered assert") );
+   chain.produce_block();
+   BOOST_CHECK_EQUAL( chain.control->get_wasm_interface().get_cache_stats().promotions, 1 );
+} FC_LOG_AND_RETHROW()
+
 BOOST_FIXTURE_TEST_CASE( check_big_deserialization, TESTER ) try {
    produce_blocks(2);
    create_accounts( {N(cbd)} );